@@ -0,0 +1,179 @@
+// =================================================================
+//   File      : AttachmentPool.cpp
+//   Desc	   : Process-wide pool of released textures and
+//				 renderbuffers. FrameBufferObjects that enable pooling
+//				 take their attachments from here and give them back
+//				 when they are deleted, so short-lived render targets
+//				 stop paying for driver allocations. All pooled objects
+//				 must belong to the same context share group. Every
+//				 method may be called from any thread of that group.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "AttachmentPool.h"
+#include "BindingCache.h"
+
+bool AttachmentKey::operator<(const AttachmentKey& rhs)const
+{
+	if(type!=rhs.type) return type<rhs.type;
+	if(intFormat!=rhs.intFormat) return intFormat<rhs.intFormat;
+	if(width!=rhs.width) return width<rhs.width;
+	if(height!=rhs.height) return height<rhs.height;
+	if(depth!=rhs.depth) return depth<rhs.depth;
+	if(samples!=rhs.samples) return samples<rhs.samples;
+	return levels<rhs.levels;
+}
+
+
+AttachmentPool::AttachmentPool() : m_frame(0), m_trimInterval(60), m_maxIdleFrames(120), m_numIdle(0), m_numHits(0), m_numMisses(0)
+{
+}
+
+
+AttachmentPool::~AttachmentPool()
+{
+	// the context is usually gone at exit, idle objects die with it
+}
+
+
+AttachmentPool& AttachmentPool::getInstance()
+{
+	static AttachmentPool pool;
+	return pool;
+}
+
+
+GLuint AttachmentPool::acquire(const AttachmentKey& key)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::map<AttachmentKey, std::vector<IdleEntry> >::iterator it = m_idle.find(key);
+	if(it==m_idle.end() || it->second.empty())
+	{
+		++m_numMisses;
+		return 0;
+	}
+
+	// most recently released first, it is the most likely to be resident
+	GLuint id = it->second.back().id;
+	it->second.pop_back();
+	--m_numIdle;
+	++m_numHits;
+	return id;
+}
+
+
+void AttachmentPool::release(const AttachmentKey& key, GLuint id)
+{
+	if(id==0) return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	IdleEntry entry;
+	entry.id = id;
+	entry.releaseFrame = m_frame;
+	m_idle[key].push_back(entry);
+	++m_numIdle;
+}
+
+
+void AttachmentPool::nextFrame()
+{
+	unsigned maxIdleFrames;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_frame;
+		if(m_trimInterval==0 || m_frame%m_trimInterval!=0)
+			return;
+		maxIdleFrames = m_maxIdleFrames;
+	}
+	trim(maxIdleFrames);
+}
+
+
+void AttachmentPool::setTrimSchedule(unsigned intervalFrames, unsigned maxIdleFrames)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_trimInterval = intervalFrames;
+	m_maxIdleFrames = maxIdleFrames;
+}
+
+
+void AttachmentPool::trim(unsigned maxIdleFrames)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::map<AttachmentKey, std::vector<IdleEntry> >::iterator it = m_idle.begin();
+	while(it!=m_idle.end())
+	{
+		// entries are ordered by release frame, the stale ones come first
+		std::vector<IdleEntry>& entries = it->second;
+		unsigned numStale = 0;
+		while(numStale<entries.size() && m_frame-entries[numStale].releaseFrame>=maxIdleFrames)
+			deleteObject(it->first.type, entries[numStale++].id);
+
+		entries.erase(entries.begin(), entries.begin()+numStale);
+		m_numIdle -= numStale;
+
+		if(entries.empty())
+			m_idle.erase(it++);
+		else
+			++it;
+	}
+}
+
+
+void AttachmentPool::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for(std::map<AttachmentKey, std::vector<IdleEntry> >::iterator it = m_idle.begin(); it != m_idle.end(); ++it)
+	{
+		for(unsigned i=0; i<it->second.size(); ++i)
+			deleteObject(it->first.type, it->second[i].id);
+	}
+	m_idle.clear();
+	m_numIdle = 0;
+}
+
+
+unsigned long AttachmentPool::getNumHits()const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numHits;
+}
+
+
+unsigned long AttachmentPool::getNumMisses()const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numMisses;
+}
+
+
+unsigned AttachmentPool::getNumIdle()const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numIdle;
+}
+
+
+void AttachmentPool::resetStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_numHits = 0;
+	m_numMisses = 0;
+}
+
+
+void AttachmentPool::deleteObject(POOL_OBJECT_TYPE type, GLuint id)
+{
+	if(type==POT_RENDERBUFFER)
+	{
+		glDeleteRenderbuffers(1, &id);
+		BindingCache::current().onRenderbufferDeleted(id);
+	}
+	else
+	{
+		glDeleteTextures(1, &id);
+		BindingCache::current().onTextureDeleted(id);
+	}
+}
@@ -0,0 +1,91 @@
+// =================================================================
+//   File      : AttachmentPool.h
+//   Desc	   : Process-wide pool of released textures and
+//				 renderbuffers. FrameBufferObjects that enable pooling
+//				 take their attachments from here and give them back
+//				 when they are deleted, so short-lived render targets
+//				 stop paying for driver allocations. All pooled objects
+//				 must belong to the same context share group. Every
+//				 method may be called from any thread of that group.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef ATTACHMENTPOOL_H
+#define ATTACHMENTPOOL_H
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <GL/glew.h>
+
+// kind of GL object held by the pool
+enum POOL_OBJECT_TYPE {POT_RENDERBUFFER=0, POT_TEXTURE_1D, POT_TEXTURE_2D, POT_TEXTURE_3D, POT_TEXTURE_2D_MULTISAMPLE, POT_TEXTURE_2D_ARRAY, POT_TEXTURE_CUBE_MAP};
+
+// objects are only interchangeable if every field matches
+struct AttachmentKey {
+	POOL_OBJECT_TYPE type;
+	GLenum intFormat;
+	GLsizei width;
+	GLsizei height;
+	GLsizei depth;
+	GLsizei samples;
+	GLsizei levels; // mip levels
+
+	bool operator<(const AttachmentKey& rhs)const;
+};
+
+
+class AttachmentPool
+{
+public:
+
+	static AttachmentPool& getInstance();
+
+	// returns an idle object matching the key, or 0 on a miss in which
+	// case the caller allocates the object itself
+	GLuint acquire(const AttachmentKey& key);
+	void release(const AttachmentKey& key, GLuint id);
+
+	// call once per frame, idle objects are trimmed on the set schedule
+	void nextFrame();
+	void setTrimSchedule(unsigned intervalFrames, unsigned maxIdleFrames);
+	void trim(unsigned maxIdleFrames);
+	void clear();
+
+	// Accessors
+	unsigned long	getNumHits()const;
+	unsigned long	getNumMisses()const;
+	unsigned		getNumIdle()const;
+	void			resetStatistics();
+
+private:
+
+	AttachmentPool();
+	~AttachmentPool();
+	AttachmentPool(const AttachmentPool&);
+	AttachmentPool& operator=(const AttachmentPool&);
+
+	static void deleteObject(POOL_OBJECT_TYPE type, GLuint id);
+
+	// released object waiting for reuse
+	struct IdleEntry {
+		GLuint id;
+		unsigned long releaseFrame;
+	};
+
+	// fbos built on worker contexts acquire and release concurrently
+	mutable std::mutex	m_mutex;
+	std::map<AttachmentKey, std::vector<IdleEntry> > m_idle;
+
+	unsigned long	m_frame;
+	unsigned		m_trimInterval; // frames between two trims, 0 disables
+	unsigned		m_maxIdleFrames;
+	unsigned		m_numIdle;
+	unsigned long	m_numHits;
+	unsigned long	m_numMisses;
+
+};
+
+#endif
@@ -0,0 +1,245 @@
+// =================================================================
+//   File      : BindingCache.cpp
+//   Desc	   : Per-context shadow of the framebuffer, renderbuffer
+//				 and texture bindings. Binds that would not change
+//				 the current state are skipped, and the number of
+//				 issued and elided binds is counted. Code that binds
+//				 objects behind the cache's back must call
+//				 invalidate() afterwards.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "BindingCache.h"
+
+#include <map>
+#include <mutex>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <OpenGL/OpenGL.h>
+#else
+#include <GL/glxew.h>
+#endif
+
+// binding value that never matches, forces the next bind to be issued
+static const GLuint UNKNOWN_BINDING = 0xFFFFFFFF;
+
+static const void* queryCurrentContext()
+{
+#if defined(_WIN32)
+	return wglGetCurrentContext();
+#elif defined(__APPLE__)
+	return CGLGetCurrentContext();
+#else
+	return glXGetCurrentContext();
+#endif
+}
+
+ContextQueryFunc BindingCache::s_contextQuery = queryCurrentContext;
+
+// one cache per context, the last lookup is remembered per thread
+static std::mutex s_cacheMutex;
+static std::map<const void*, BindingCache*> s_caches;
+static thread_local const void* t_lastContext = NULL;
+static thread_local BindingCache* t_lastCache = NULL;
+
+
+BindingCache::BindingCache() : m_numIssued(0), m_numElided(0)
+{
+	invalidate();
+}
+
+
+BindingCache& BindingCache::current()
+{
+	const void* context = s_contextQuery();
+	if(t_lastCache && t_lastContext==context)
+		return *t_lastCache;
+
+	std::lock_guard<std::mutex> lock(s_cacheMutex);
+	BindingCache*& cache = s_caches[context];
+	if(cache==NULL)
+		cache = new BindingCache();
+
+	t_lastContext = context;
+	t_lastCache = cache;
+	return *cache;
+}
+
+
+void BindingCache::setContextQuery(ContextQueryFunc func)
+{
+	s_contextQuery = func ? func : queryCurrentContext;
+	t_lastCache = NULL;
+}
+
+
+const void* BindingCache::currentContext()
+{
+	return s_contextQuery();
+}
+
+
+void BindingCache::bindFramebuffer(GLenum target, GLuint id)
+{
+	switch(target)
+	{
+		case GL_READ_FRAMEBUFFER:
+			if(m_readFramebuffer==id) { ++m_numElided; return; }
+			m_readFramebuffer = id;
+			break;
+		case GL_DRAW_FRAMEBUFFER:
+			if(m_drawFramebuffer==id) { ++m_numElided; return; }
+			m_drawFramebuffer = id;
+			break;
+		default:
+			if(m_readFramebuffer==id && m_drawFramebuffer==id) { ++m_numElided; return; }
+			m_readFramebuffer = m_drawFramebuffer = id;
+			break;
+	}
+
+	glBindFramebuffer(target, id);
+	++m_numIssued;
+}
+
+
+void BindingCache::bindRenderbuffer(GLuint id)
+{
+	if(m_renderbuffer==id) { ++m_numElided; return; }
+
+	glBindRenderbuffer(GL_RENDERBUFFER, id);
+	m_renderbuffer = id;
+	++m_numIssued;
+}
+
+
+void BindingCache::activeTexture(GLuint unit)
+{
+	if(m_activeUnit==unit) { ++m_numElided; return; }
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	m_activeUnit = unit;
+	++m_numIssued;
+}
+
+
+void BindingCache::bindTexture(GLenum target, GLuint id)
+{
+	// an unknown active unit is made known first
+	if(m_activeUnit==UNKNOWN_BINDING)
+		activeTexture(0);
+
+	int index = getTextureTargetIndex(target);
+	if(index<0)
+	{
+		// targets the cache does not track are passed through
+		glBindTexture(target, id);
+		++m_numIssued;
+		return;
+	}
+
+	if(m_units.size()<=m_activeUnit)
+	{
+		TextureUnit unknown;
+		for(int i=0; i<NUM_TEXTURE_TARGETS; ++i) unknown.textures[i] = UNKNOWN_BINDING;
+		m_units.resize(m_activeUnit+1, unknown);
+	}
+
+	GLuint& bound = m_units[m_activeUnit].textures[index];
+	if(bound==id) { ++m_numElided; return; }
+
+	glBindTexture(target, id);
+	bound = id;
+	++m_numIssued;
+}
+
+
+void BindingCache::bindTexture(GLuint unit, GLenum target, GLuint id)
+{
+	activeTexture(unit);
+	bindTexture(target, id);
+}
+
+
+void BindingCache::onFramebufferDeleted(GLuint id)
+{
+	if(m_readFramebuffer==id) m_readFramebuffer = 0;
+	if(m_drawFramebuffer==id) m_drawFramebuffer = 0;
+}
+
+
+void BindingCache::onRenderbufferDeleted(GLuint id)
+{
+	if(m_renderbuffer==id) m_renderbuffer = 0;
+}
+
+
+void BindingCache::onTextureDeleted(GLuint id)
+{
+	for(unsigned u=0; u<m_units.size(); ++u)
+	{
+		for(int i=0; i<NUM_TEXTURE_TARGETS; ++i)
+		{
+			if(m_units[u].textures[i]==id)
+				m_units[u].textures[i] = 0;
+		}
+	}
+}
+
+
+void BindingCache::invalidate()
+{
+	m_readFramebuffer = UNKNOWN_BINDING;
+	m_drawFramebuffer = UNKNOWN_BINDING;
+	m_renderbuffer = UNKNOWN_BINDING;
+	m_activeUnit = UNKNOWN_BINDING;
+	m_units.clear();
+}
+
+
+GLuint BindingCache::getFramebuffer(GLenum target)const
+{
+	return target==GL_READ_FRAMEBUFFER ? m_readFramebuffer : m_drawFramebuffer;
+}
+
+
+unsigned long BindingCache::getNumIssued()const
+{
+	return m_numIssued;
+}
+
+
+unsigned long BindingCache::getNumElided()const
+{
+	return m_numElided;
+}
+
+
+void BindingCache::resetStatistics()
+{
+	m_numIssued = 0;
+	m_numElided = 0;
+}
+
+
+int BindingCache::getTextureTargetIndex(GLenum target)
+{
+	switch(target)
+	{
+		case GL_TEXTURE_1D:						return 0;
+		case GL_TEXTURE_2D:						return 1;
+		case GL_TEXTURE_3D:						return 2;
+		case GL_TEXTURE_1D_ARRAY:				return 3;
+		case GL_TEXTURE_2D_ARRAY:				return 4;
+		case GL_TEXTURE_RECTANGLE:				return 5;
+		case GL_TEXTURE_CUBE_MAP:				return 6;
+		case GL_TEXTURE_CUBE_MAP_ARRAY:			return 7;
+		case GL_TEXTURE_BUFFER:					return 8;
+		case GL_TEXTURE_2D_MULTISAMPLE:			return 9;
+		case GL_TEXTURE_2D_MULTISAMPLE_ARRAY:	return 10;
+		default:								return -1;
+	}
+}
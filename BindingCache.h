@@ -0,0 +1,82 @@
+// =================================================================
+//   File      : BindingCache.h
+//   Desc	   : Per-context shadow of the framebuffer, renderbuffer
+//				 and texture bindings. Binds that would not change
+//				 the current state are skipped, and the number of
+//				 issued and elided binds is counted. Code that binds
+//				 objects behind the cache's back must call
+//				 invalidate() afterwards.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef BINDINGCACHE_H
+#define BINDINGCACHE_H
+
+#include <vector>
+#include <GL/glew.h>
+
+// returns an opaque handle of the context current on the calling thread
+typedef const void* (*ContextQueryFunc)();
+
+
+class BindingCache
+{
+public:
+
+	// cache of the context current on the calling thread
+	static BindingCache& current();
+
+	// the default query uses wgl/cgl/glx, EGL clients install their own
+	static void setContextQuery(ContextQueryFunc func);
+	static const void* currentContext();
+
+	// binding methods
+	void bindFramebuffer(GLenum target, GLuint id);
+	void bindRenderbuffer(GLuint id);
+	void activeTexture(GLuint unit); // unit index, not GL_TEXTUREi
+	void bindTexture(GLenum target, GLuint id); // on the active unit
+	void bindTexture(GLuint unit, GLenum target, GLuint id);
+
+	// deleting a bound object reverts the binding to 0 in GL
+	void onFramebufferDeleted(GLuint id);
+	void onRenderbufferDeleted(GLuint id);
+	void onTextureDeleted(GLuint id);
+
+	// forget everything, the next bind of each kind is always issued
+	void invalidate();
+
+	// Accessors
+	GLuint			getFramebuffer(GLenum target)const;
+	unsigned long	getNumIssued()const;
+	unsigned long	getNumElided()const;
+	void			resetStatistics();
+
+private:
+
+	BindingCache();
+
+	static int getTextureTargetIndex(GLenum target);
+
+	enum {NUM_TEXTURE_TARGETS = 11};
+
+	// texture bindings of one texture unit, indexed by getTextureTargetIndex
+	struct TextureUnit {
+		GLuint textures[NUM_TEXTURE_TARGETS];
+	};
+
+	GLuint					m_readFramebuffer;
+	GLuint					m_drawFramebuffer;
+	GLuint					m_renderbuffer;
+	GLuint					m_activeUnit;
+	std::vector<TextureUnit> m_units;
+
+	unsigned long			m_numIssued;
+	unsigned long			m_numElided;
+
+	static ContextQueryFunc	s_contextQuery;
+
+};
+
+#endif
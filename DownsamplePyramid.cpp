@@ -0,0 +1,151 @@
+// =================================================================
+//   File      : DownsamplePyramid.cpp
+//   Desc	   : Successive half size copies of a color attachment
+//				 in the mip levels of one texture, as used by bloom
+//				 and auto exposure. Two fbos with one level each take
+//				 turns, each step re-targets only the fbo it writes
+//				 and blits the level of the other one into it.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "DownsamplePyramid.h"
+
+#include <algorithm>
+
+DownsamplePyramid::DownsamplePyramid() : m_texture(0), m_width(0), m_height(0), m_intFormat(GL_NONE), m_numLevels(0)
+{
+	m_fbos[0] = m_fbos[1] = NULL;
+}
+
+
+DownsamplePyramid::~DownsamplePyramid()
+{
+	release();
+}
+
+
+FBO_RESULT DownsamplePyramid::build(FrameBufferObject& source, AttachmentHandle attachment, GLsizei numLevels, GLenum filter)
+{
+	GLsizei sourceWidth, sourceHeight;
+	if(source.getAttachmentSize(attachment, sourceWidth, sourceHeight)!=FR_OK) return FR_INVALID_HANDLE;
+
+	GLsizei width = std::max(sourceWidth / 2, 1);
+	GLsizei height = std::max(sourceHeight / 2, 1);
+
+	// levels down to 1x1
+	GLsizei maxLevels = 1;
+	while((std::max(width, height) >> maxLevels)>0)
+		++maxLevels;
+	if(numLevels<=0 || numLevels>maxLevels) numLevels = maxLevels;
+
+	GLenum intFormat = source.getAttachmentFormat(attachment);
+	if(width!=m_width || height!=m_height || intFormat!=m_intFormat || numLevels!=m_numLevels)
+	{
+		if(!allocate(width, height, intFormat, numLevels)) return FR_UNSUPPORTED;
+	}
+
+	// the source is scaled into level 0
+	m_fbos[0]->selectLevel(m_levels[0], 0);
+	FBO_RESULT result = source.copy(*m_fbos[0], attachment, m_levels[0], filter);
+	if(result!=FR_OK) return result;
+
+	// the fbo written last is the next source, only the other one moves
+	for(GLint level=1; level<numLevels; ++level)
+	{
+		unsigned read = (level-1) % 2;
+		unsigned draw = level % 2;
+		m_fbos[draw]->selectLevel(m_levels[draw], level);
+		m_fbos[read]->copy(*m_fbos[draw], m_levels[read], m_levels[draw], filter);
+	}
+	return FR_OK;
+}
+
+
+void DownsamplePyramid::release()
+{
+	// the fbos only detach the texture they did not create
+	delete m_fbos[0];
+	delete m_fbos[1];
+	m_fbos[0] = m_fbos[1] = NULL;
+	if(m_texture)
+	{
+		glDeleteTextures(1, &m_texture);
+		BindingCache::current().onTextureDeleted(m_texture);
+	}
+	m_texture = 0;
+	m_width = m_height = 0;
+	m_intFormat = GL_NONE;
+	m_numLevels = 0;
+}
+
+
+GLuint DownsamplePyramid::getTextureID()const
+{
+	return m_texture;
+}
+
+
+GLsizei DownsamplePyramid::getNumLevels()const
+{
+	return m_numLevels;
+}
+
+
+void DownsamplePyramid::getLevelSize(GLint level, GLsizei& width, GLsizei& height)const
+{
+	width = std::max(m_width >> level, 1);
+	height = std::max(m_height >> level, 1);
+}
+
+
+bool DownsamplePyramid::allocate(GLsizei width, GLsizei height, GLenum internalFormat, GLsizei numLevels)
+{
+	release();
+
+	if(!(GLEW_VERSION_4_2 || GLEW_ARB_texture_storage))
+	{
+		std::cerr << "Error: downsample pyramid requires immutable texture storage...\n";
+		return false;
+	}
+
+	// every level filtered from the one above, sampled per level with textureLod
+	if(FrameBufferObject::isDirectStateAccessEnabled())
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+		glTextureStorage2D(m_texture, numLevels, internalFormat, width, height);
+		glTextureParameteri(m_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+		glTextureParameteri(m_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(m_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	else
+	{
+		glGenTextures(1, &m_texture);
+		BindingCache::current().bindTexture(GL_TEXTURE_2D, m_texture);
+		glTexStorage2D(GL_TEXTURE_2D, numLevels, internalFormat, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	m_width = width;
+	m_height = height;
+	m_intFormat = internalFormat;
+	m_numLevels = numLevels;
+
+	// even levels are written through the first fbo, odd ones through the second
+	for(unsigned i=0; i<2; ++i)
+	{
+		m_fbos[i] = new FrameBufferObject(BTM_READ_WRITE);
+		m_levels[i] = m_fbos[i]->attachExternalTexture("level", TBT_COLOR, m_texture, internalFormat, width, height, std::min((GLsizei)i, numLevels-1), 0, numLevels);
+		if(!m_levels[i].isValid())
+		{
+			release();
+			return false;
+		}
+	}
+	return true;
+}
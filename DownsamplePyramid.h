@@ -0,0 +1,57 @@
+// =================================================================
+//   File      : DownsamplePyramid.h
+//   Desc	   : Successive half size copies of a color attachment
+//				 in the mip levels of one texture, as used by bloom
+//				 and auto exposure. Two fbos with one level each take
+//				 turns, each step re-targets only the fbo it writes
+//				 and blits the level of the other one into it.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef DOWNSAMPLEPYRAMID_H
+#define DOWNSAMPLEPYRAMID_H
+
+#include "FrameBufferObject.h"
+
+class DownsamplePyramid
+{
+public:
+
+	 // Constructor/Destructor
+	 DownsamplePyramid();
+	~DownsamplePyramid();
+
+	// level 0 is half the size of the source attachment, every further
+	// level halves the one before, down to 1x1 if numLevels is 0. the
+	// storage is kept while size, format and level count stay the same.
+	// requires GL 4.2 or ARB_texture_storage.
+	FBO_RESULT build(FrameBufferObject& source, AttachmentHandle attachment, GLsizei numLevels=0, GLenum filter=GL_LINEAR);
+	void release();
+
+	// Accessors
+	GLuint	getTextureID()const; // 0 before the first build()
+	GLsizei	getNumLevels()const;
+	void	getLevelSize(GLint level, GLsizei& width, GLsizei& height)const;
+
+private:
+
+	DownsamplePyramid(const DownsamplePyramid&);
+	DownsamplePyramid& operator=(const DownsamplePyramid&);
+
+	bool allocate(GLsizei width, GLsizei height, GLenum internalFormat, GLsizei numLevels);
+
+	// a single fbo cannot hold both levels, its bounds would shrink to
+	// the smaller one and clip the read side of the blit
+	FrameBufferObject*	m_fbos[2]; // reused for every level
+	AttachmentHandle	m_levels[2]; // the texture attached to each of them
+	GLuint				m_texture;
+	GLsizei				m_width; // of level 0
+	GLsizei				m_height;
+	GLenum				m_intFormat;
+	GLsizei				m_numLevels;
+
+};
+
+#endif
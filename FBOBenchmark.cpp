@@ -0,0 +1,734 @@
+// ===========================================================
+//   File      : FBOBenchmark.cpp
+//   Desc	   : Headless Frame Buffer Object benchmark. Creates
+//				 its context through EGL without a window surface
+//				 (Mesa llvmpipe works) and writes the results as JSON.
+//				 GLEW has to be built with GLEW_EGL.
+//
+//				 --software runs only the software framebuffer,
+//				 without creating a context.
+//
+//				 usage: FBOBenchmark [-o results.json] [--quick] [--software]
+//   Author    : Berk Atabek - Copyright 2012
+//
+//============================================================
+
+#define _CRT_SECURE_NO_DEPRECATE // disable VS deprecation warnings
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#include <GL/glew.h>     // for GLEW
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "FrameBufferObject.h"
+#include "DownsamplePyramid.h"
+#include "RenderTargetSet.h"
+#include "StaticFramebuffer.h"
+#include "SoftwareFramebuffer.h"
+#include "SoftwareKernels.h"
+#include "TileWorkerPool.h"
+
+//=========================================
+// Benchmark grid
+//=========================================
+struct FormatInfo {
+	GLenum intFormat;
+	const char* name;
+	unsigned bytesPerPixel;
+};
+
+static const FormatInfo g_colorFormats[] = {
+	{GL_RGBA8,			"RGBA8",			4},
+	{GL_R11F_G11F_B10F,	"R11F_G11F_B10F",	4},
+	{GL_RGBA16F,		"RGBA16F",			8},
+	{GL_RGBA32F,		"RGBA32F",			16},
+};
+static const unsigned g_numColorFormats = sizeof(g_colorFormats)/sizeof(g_colorFormats[0]);
+
+// formats moved by the blit and readback runs, with the client format
+// and type of the synchronous read
+struct TransferFormat {
+	GLenum intFormat;
+	const char* name;
+	unsigned bytesPerPixel;
+	TEXTURE_BUFFER_TYPE textureType;
+	RBUFFER_TYPE renderBufferType;
+	GLenum clientFormat;
+	GLenum clientType;
+};
+
+static const TransferFormat g_transferFormats[] = {
+	{GL_RGBA8,				"RGBA8",	4,	TBT_COLOR,	RBT_COLOR,	GL_RGBA,			GL_UNSIGNED_BYTE},
+	{GL_RGBA32F,			"RGBA32F",	16,	TBT_COLOR,	RBT_COLOR,	GL_RGBA,			GL_FLOAT},
+	{GL_DEPTH_COMPONENT32F,	"DEPTH32F",	4,	TBT_DEPTH,	RBT_DEPTH,	GL_DEPTH_COMPONENT,	GL_FLOAT},
+};
+static const unsigned g_numTransferFormats = sizeof(g_transferFormats)/sizeof(g_transferFormats[0]);
+
+static const GLsizei g_sizes[] = {256, 512, 1024, 2048};
+static const unsigned g_numSizes = sizeof(g_sizes)/sizeof(g_sizes[0]);
+
+static unsigned g_iterations = 100; // per measurement, divided by 10 with --quick
+static bool g_software = false; // no context, software framebuffer only
+
+//=========================================
+// Timing and output
+//=========================================
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedMs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// one json object per measurement, joined when the file is written
+static std::vector<std::string> g_results;
+
+// quotes, backslashes and control characters are escaped, the driver
+// strings are not under our control
+static std::string escapeJSON(const std::string& text)
+{
+	std::string escaped;
+	for(std::string::const_iterator it = text.begin(); it != text.end(); ++it)
+	{
+		unsigned char c = (unsigned char)*it;
+		if(c=='"' || c=='\\')
+		{
+			escaped += '\\';
+			escaped += (char)c;
+		}
+		else if(c<0x20)
+		{
+			char code[8];
+			snprintf(code, sizeof(code), "\\u%04x", c);
+			escaped += code;
+		}
+		else
+			escaped += (char)c;
+	}
+	return escaped;
+}
+
+static void addResult(const std::string& benchmark, const std::string& variant, GLsizei width, GLsizei height, unsigned iterations, double totalMs, double bytesPerIteration)
+{
+	std::ostringstream out;
+	out << "    {\"benchmark\": \"" << escapeJSON(benchmark) << "\", \"variant\": \"" << escapeJSON(variant) << "\""
+		<< ", \"width\": " << width << ", \"height\": " << height
+		<< ", \"iterations\": " << iterations
+		<< ", \"ms_per_iteration\": " << totalMs / iterations;
+	if(bytesPerIteration>0.0)
+		out << ", \"gb_per_second\": " << bytesPerIteration * iterations / (totalMs * 1.0e6);
+	out << "}";
+	g_results.push_back(out.str());
+
+	fprintf(stderr, "%-16s %-24s %5dx%-5d %10.4f ms\n", benchmark.c_str(), variant.c_str(), width, height, totalMs / iterations);
+}
+
+static void writeResults(std::ostream& out)
+{
+	out << "{\n";
+	if(g_software)
+	{
+		out << "  \"renderer\": \"software\",\n";
+		out << "  \"version\": \"" << SoftwareKernels::getLevelName(SoftwareKernels::getSupportedLevel()) << ", " << TileWorkerPool::getInstance().getNumThreads() << " threads\",\n";
+	}
+	else
+	{
+		out << "  \"renderer\": \"" << escapeJSON((const char*)glGetString(GL_RENDERER)) << "\",\n";
+		out << "  \"version\": \"" << escapeJSON((const char*)glGetString(GL_VERSION)) << "\",\n";
+	}
+	out << "  \"direct_state_access\": " << (!g_software && FrameBufferObject::isDirectStateAccessEnabled() ? "true" : "false") << ",\n";
+	out << "  \"results\": [\n";
+	for(unsigned i=0; i<g_results.size(); ++i)
+		out << g_results[i] << (i+1<g_results.size() ? ",\n" : "\n");
+	out << "  ]\n}\n";
+}
+
+//=========================================
+// Context
+//=========================================
+static const void* currentEGLContext()
+{
+	return eglGetCurrentContext();
+}
+
+static bool createContext()
+{
+	// surfaceless platform first, the default display needs a window system
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if(getPlatformDisplay)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if(display==EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if(!eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+	{
+		fprintf(stderr, "Error: EGL initialization failed\n");
+		return false;
+	}
+
+	// newest context first, without a config since nothing is presented
+	const EGLint versions[][2] = {{4, 5}, {4, 3}, {3, 3}};
+	EGLContext context = EGL_NO_CONTEXT;
+	for(unsigned i=0; i<3 && context==EGL_NO_CONTEXT; ++i)
+	{
+		const EGLint attributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, versions[i][0],
+			EGL_CONTEXT_MINOR_VERSION, versions[i][1],
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+			EGL_NONE};
+		context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+	}
+
+	if(context==EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		fprintf(stderr, "Error: no surfaceless OpenGL context\n");
+		return false;
+	}
+
+	// init GLEW
+	glewExperimental=GL_TRUE;
+	GLenum err = glewInit();
+	if(GLEW_OK != err)
+	{
+		fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
+		return false;
+	}
+
+	// the binding cache cannot see EGL contexts by itself
+	BindingCache::setContextQuery(currentEGLContext);
+	return true;
+}
+
+//=========================================
+// Benchmarks
+//=========================================
+static void benchCreateDestroy()
+{
+	unsigned iterations = g_iterations * 10;
+
+	Clock::time_point start = Clock::now();
+	for(unsigned i=0; i<iterations; ++i)
+	{
+		FrameBufferObject fbo(BTM_WRITE);
+	}
+	glFinish();
+	addResult("create_destroy", "empty", 0, 0, iterations, elapsedMs(start), 0.0);
+
+	start = Clock::now();
+	for(unsigned i=0; i<iterations; ++i)
+	{
+		FrameBufferObject fbo(BTM_WRITE);
+		fbo.attach2DTexture("color", TBT_COLOR, 256, 256, 0);
+		fbo.createRenderBufferAndAttach("depth", RBT_DEPTH, GL_DEPTH_COMPONENT24, 256, 256);
+	}
+	glFinish();
+	addResult("create_destroy", "color_texture+depth_rb", 256, 256, iterations, elapsedMs(start), 0.0);
+}
+
+
+// the attachment types timed by benchAttachDetach
+enum ATTACHMENT_KIND {AK_COLOR_TEXTURE=0, AK_DEPTH_TEXTURE, AK_DEPTH_STENCIL_TEXTURE, AK_COLOR_RENDERBUFFER, AK_DEPTH_RENDERBUFFER, AK_MSAA_RENDERBUFFER};
+
+static AttachmentHandle attachKind(FrameBufferObject& fbo, ATTACHMENT_KIND kind, GLsizei size)
+{
+	switch(kind)
+	{
+		case AK_COLOR_TEXTURE:			return fbo.attach2DTexture("a", TBT_COLOR, size, size, 0);
+		case AK_DEPTH_TEXTURE:			return fbo.attach2DTexture("a", TBT_DEPTH, size, size, 0);
+		case AK_DEPTH_STENCIL_TEXTURE:	return fbo.attach2DTexture("a", TBT_DEPTH_AND_STENCIL, size, size, 0);
+		case AK_COLOR_RENDERBUFFER:		return fbo.createRenderBufferAndAttach("a", RBT_COLOR, GL_RGBA8, size, size);
+		case AK_DEPTH_RENDERBUFFER:		return fbo.createRenderBufferAndAttach("a", RBT_DEPTH, GL_DEPTH_COMPONENT24, size, size);
+		default:						return fbo.createMultisampleRenderBufferAndAttach("a", RBT_COLOR, GL_RGBA8, 4, size, size);
+	}
+}
+
+static void benchAttachDetach()
+{
+	const char* names[] = {"color_texture", "depth_texture", "depth_stencil_texture", "color_renderbuffer", "depth_renderbuffer", "msaa4_renderbuffer"};
+	const GLsizei size = 512;
+
+	for(int pooled=0; pooled<2; ++pooled)
+	{
+		for(int kind=AK_COLOR_TEXTURE; kind<=AK_MSAA_RENDERBUFFER; ++kind)
+		{
+			FrameBufferObject fbo(BTM_WRITE);
+			fbo.setAttachmentPooling(pooled!=0);
+
+			double attachMs = 0.0, detachMs = 0.0;
+			for(unsigned i=0; i<g_iterations; ++i)
+			{
+				Clock::time_point start = Clock::now();
+				AttachmentHandle handle = attachKind(fbo, (ATTACHMENT_KIND)kind, size);
+				glFinish();
+				attachMs += elapsedMs(start);
+
+				start = Clock::now();
+				if(kind>=AK_COLOR_RENDERBUFFER)
+				{
+					fbo.detachRenderBuffer(handle);
+					fbo.deleteRenderBuffer(handle);
+				}
+				else
+				{
+					fbo.detachTexture(handle);
+					fbo.deleteTexture(handle);
+				}
+				glFinish();
+				detachMs += elapsedMs(start);
+			}
+
+			std::string variant = std::string(names[kind]) + (pooled ? "_pooled" : "");
+			addResult("attach", variant, size, size, g_iterations, attachMs, 0.0);
+			addResult("detach", variant, size, size, g_iterations, detachMs, 0.0);
+		}
+		AttachmentPool::getInstance().clear();
+	}
+}
+
+
+static void benchClearAndFill()
+{
+	for(unsigned f=0; f<g_numColorFormats; ++f)
+	{
+		for(unsigned s=0; s<g_numSizes; ++s)
+		{
+			const FormatInfo& format = g_colorFormats[f];
+			GLsizei size = g_sizes[s];
+			double bytes = (double)size * size * format.bytesPerPixel;
+
+			FrameBufferObject fbo(BTM_WRITE);
+			fbo.attach2DTexture("color", TBT_COLOR, size, size, 0, 0, format.intFormat);
+			fbo.bind();
+			glViewport(0, 0, size, size);
+
+			glFinish();
+			Clock::time_point start = Clock::now();
+			for(unsigned i=0; i<g_iterations; ++i)
+			{
+				glClearColor(i&1 ? 1.0f : 0.0f, 0.5f, 0.25f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT);
+			}
+			glFinish();
+			addResult("clear", format.name, size, size, g_iterations, elapsedMs(start), bytes);
+
+			// a full viewport rectangle with identity transforms, fixed function
+			glMatrixMode(GL_PROJECTION);
+			glLoadIdentity();
+			glMatrixMode(GL_MODELVIEW);
+			glLoadIdentity();
+			glDisable(GL_DEPTH_TEST);
+
+			glFinish();
+			start = Clock::now();
+			for(unsigned i=0; i<g_iterations; ++i)
+			{
+				glColor4f(i&1 ? 1.0f : 0.0f, 0.5f, 0.25f, 1.0f);
+				glRectf(-1.0f, -1.0f, 1.0f, 1.0f);
+			}
+			glFinish();
+			addResult("fill", format.name, size, size, g_iterations, elapsedMs(start), bytes);
+
+			fbo.switchToDefaultSystemBuffers();
+		}
+	}
+}
+
+
+// level 0 of the pyramid texture has to be half the source, anything
+// else means the storage went to another texture
+static bool checkPyramid(const DownsamplePyramid& pyramid, GLsizei sourceSize)
+{
+	GLint width = 0, height = 0;
+	if(FrameBufferObject::isDirectStateAccessEnabled())
+	{
+		glGetTextureLevelParameteriv(pyramid.getTextureID(), 0, GL_TEXTURE_WIDTH, &width);
+		glGetTextureLevelParameteriv(pyramid.getTextureID(), 0, GL_TEXTURE_HEIGHT, &height);
+	}
+	else
+	{
+		BindingCache::current().bindTexture(GL_TEXTURE_2D, pyramid.getTextureID());
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	}
+	if(width!=sourceSize/2 || height!=sourceSize/2)
+	{
+		fprintf(stderr, "Error: pyramid of a %dx%d source has a %dx%d level 0\n", sourceSize, sourceSize, width, height);
+		return false;
+	}
+	return true;
+}
+
+
+static void benchBlit()
+{
+	// kept across formats and sizes, every run rebuilds its storage
+	DownsamplePyramid pyramid;
+	for(unsigned f=0; f<g_numTransferFormats; ++f)
+	{
+		for(unsigned s=0; s<g_numSizes; ++s)
+		{
+			const TransferFormat& format = g_transferFormats[f];
+			GLsizei size = g_sizes[s];
+			double bytes = (double)size * size * format.bytesPerPixel;
+			std::string name = format.name;
+
+			FrameBufferObject source(BTM_READ_WRITE), target(BTM_READ_WRITE), msaa(BTM_READ_WRITE);
+			AttachmentHandle src = source.attach2DTexture("buffer", format.textureType, size, size, 0, 0, format.intFormat);
+			AttachmentHandle dst = target.attach2DTexture("buffer", format.textureType, size, size, 0, 0, format.intFormat);
+			AttachmentHandle ms = msaa.createMultisampleRenderBufferAndAttach("buffer", format.renderBufferType, format.intFormat, 4, size, size);
+
+			glFinish();
+			Clock::time_point start = Clock::now();
+			for(unsigned i=0; i<g_iterations; ++i)
+				source.resolve(target, src, dst);
+			glFinish();
+			addResult("blit", name, size, size, g_iterations, elapsedMs(start), bytes);
+
+			start = Clock::now();
+			for(unsigned i=0; i<g_iterations; ++i)
+				msaa.resolve(target, ms, dst);
+			glFinish();
+			addResult("blit", name + "_msaa4_resolve", size, size, g_iterations, elapsedMs(start), bytes * 4);
+
+			// same format and size, copy() takes glCopyImageSubData where available
+			start = Clock::now();
+			for(unsigned i=0; i<g_iterations; ++i)
+				source.copy(target, src, dst);
+			glFinish();
+			addResult("copy", name + (FrameBufferObject::isCopyImageSupported() ? "_copy_image" : "_blit"), size, size, g_iterations, elapsedMs(start), bytes);
+
+			// every level of the pyramid adds a quarter of the one before,
+			// depth cannot be filtered
+			if(format.textureType!=TBT_COLOR) continue;
+			pyramid.build(source, src);
+			if(!checkPyramid(pyramid, size))
+				continue;
+			glFinish();
+			start = Clock::now();
+			for(unsigned i=0; i<g_iterations; ++i)
+				pyramid.build(source, src);
+			glFinish();
+			addResult("pyramid", name, size, size, g_iterations, elapsedMs(start), bytes / 3);
+		}
+	}
+}
+
+
+static void benchReadback()
+{
+	for(unsigned f=0; f<g_numTransferFormats; ++f)
+	{
+		for(unsigned s=0; s<g_numSizes; ++s)
+		{
+			const TransferFormat& format = g_transferFormats[f];
+			GLsizei size = g_sizes[s];
+			double bytes = (double)size * size * format.bytesPerPixel;
+			std::string name = format.name;
+			GLbitfield clearMask = format.textureType==TBT_COLOR ? GL_COLOR_BUFFER_BIT : GL_DEPTH_BUFFER_BIT;
+
+			FrameBufferObject fbo(BTM_READ_WRITE);
+			AttachmentHandle buffer = fbo.attach2DTexture("buffer", format.textureType, size, size, 0, 0, format.intFormat);
+			fbo.createReadbackRing(3);
+
+			// synchronous baseline, every read waits for the GPU
+			std::vector<unsigned char> pixels((size_t)size * size * format.bytesPerPixel);
+			glFinish();
+			Clock::time_point start = Clock::now();
+			for(unsigned i=0; i<g_iterations; ++i)
+			{
+				fbo.bind();
+				glClear(clearMask);
+				glReadPixels(0, 0, size, size, format.clientFormat, format.clientType, &pixels[0]);
+			}
+			addResult("readback", name + "_glReadPixels", size, size, g_iterations, elapsedMs(start), bytes);
+
+			// asynchronous ring in the same client format, frames are
+			// consumed once the ring is full
+			unsigned consumed = 0;
+			start = Clock::now();
+			for(unsigned i=0; i<g_iterations; ++i)
+			{
+				fbo.bind();
+				glClear(clearMask);
+				while(fbo.queueReadback(buffer, format.clientFormat, format.clientType)==FR_BUSY)
+				{
+					ReadbackFrame frame;
+					if(fbo.mapReadback(frame, true))
+					{
+						memcpy(&pixels[0], frame.data, pixels.size());
+						fbo.unmapReadback();
+						++consumed;
+					}
+				}
+			}
+			ReadbackFrame frame;
+			while(fbo.mapReadback(frame, true))
+			{
+				memcpy(&pixels[0], frame.data, pixels.size());
+				fbo.unmapReadback();
+				++consumed;
+			}
+			addResult("readback", name + "_ring3", size, size, consumed, elapsedMs(start), bytes);
+		}
+	}
+}
+
+
+static void benchUpload()
+{
+	for(unsigned s=0; s<g_numSizes; ++s)
+	{
+		GLsizei size = g_sizes[s];
+		double bytes = (double)size * size * 4;
+
+		FrameBufferObject fbo(BTM_READ_WRITE);
+		AttachmentHandle color = fbo.attach2DTexture("color", TBT_COLOR, size, size, 0);
+		GLuint texture = fbo.getAttachmentID(color);
+
+		// client memory baseline, the driver copies every frame
+		std::vector<unsigned char> pixels(size * size * 4, 0x80);
+		glFinish();
+		Clock::time_point start = Clock::now();
+		for(unsigned i=0; i<g_iterations; ++i)
+		{
+			BindingCache::current().bindTexture(GL_TEXTURE_2D, texture);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+			fbo.bind();
+			glClear(GL_COLOR_BUFFER_BIT);
+		}
+		glFinish();
+		addResult("upload", "glTexSubImage2D", size, size, g_iterations, elapsedMs(start), bytes);
+
+		// the same pixels written into the mapped slices of the stream
+		UploadRing* stream = fbo.createUploadStream(color, 3);
+		start = Clock::now();
+		for(unsigned i=0; i<g_iterations; ++i)
+		{
+			UploadSlice slice;
+			while(!stream->acquire(slice))
+				stream->retire();
+			memcpy(slice.data, &pixels[0], pixels.size());
+			stream->commit(slice, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE);
+			fbo.flushUploads(color);
+			fbo.bind();
+			glClear(GL_COLOR_BUFFER_BIT);
+		}
+		glFinish();
+		addResult("upload", stream->isPersistent() ? "stream3_persistent" : "stream3_client", size, size, g_iterations, elapsedMs(start), bytes);
+	}
+}
+
+
+static void benchPrewarm()
+{
+	unsigned iterations = std::max(g_iterations / 10, 1u);
+	for(unsigned s=0; s<g_numSizes; ++s)
+	{
+		GLsizei size = g_sizes[s];
+		std::ostringstream description;
+		description << "fbo scene write\n"
+			<< "texture color color0 RGBA16F " << size << "x" << size << "\n"
+			<< "renderbuffer depth depthstencil DEPTH24_STENCIL8 " << size << "x" << size << "\n"
+			<< "fbo bloom write\n"
+			<< "texture color color0 RGBA16F " << size/2 << "x" << size/2 << " levels=full\n";
+
+		// targets built on first use, the first frame pays for the allocation
+		double lazyMs = 0.0;
+		for(unsigned i=0; i<iterations; ++i)
+		{
+			Clock::time_point start = Clock::now();
+			FrameBufferObject scene(BTM_WRITE), bloom(BTM_WRITE);
+			scene.attach2DTexture("color", TBT_COLOR, size, size, 0, 0, GL_RGBA16F);
+			scene.createRenderBufferAndAttach("depth", RBT_DEPTH_AND_STENCIL, GL_DEPTH24_STENCIL8, size, size);
+			bloom.attach2DTexture("color", TBT_COLOR, size/2, size/2, 0, 0, GL_RGBA16F, FrameBufferObject::FULL_MIP_CHAIN);
+			scene.bind();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+			bloom.bind();
+			glClear(GL_COLOR_BUFFER_BIT);
+			glFinish();
+			lazyMs += elapsedMs(start);
+		}
+		addResult("first_frame", "lazy", size, size, iterations, lazyMs, 0.0);
+
+		// the same targets pre-warmed from the description, only the frame is timed
+		double prewarmMs = 0.0, warmMs = 0.0;
+		for(unsigned i=0; i<iterations; ++i)
+		{
+			RenderTargetSet targets;
+			std::istringstream in(description.str());
+			targets.load(in);
+			targets.prewarm(size, size);
+			prewarmMs += targets.getPrewarmTime();
+
+			Clock::time_point start = Clock::now();
+			targets.getFramebuffer("scene")->bind();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+			targets.getFramebuffer("bloom")->bind();
+			glClear(GL_COLOR_BUFFER_BIT);
+			glFinish();
+			warmMs += elapsedMs(start);
+		}
+		addResult("first_frame", "prewarmed", size, size, iterations, warmMs, 0.0);
+		addResult("prewarm", "render_target_set", size, size, iterations, prewarmMs, 0.0);
+	}
+}
+
+
+static void benchBind()
+{
+	// two fbos in turn, so no bind is elided by the cache
+	unsigned iterations = g_iterations * 100;
+	GLsizei size = 256;
+
+	FrameBufferObject dynamicFirst(BTM_WRITE), dynamicSecond(BTM_WRITE);
+	FrameBufferObject* dynamic[2] = {&dynamicFirst, &dynamicSecond};
+	for(unsigned i=0; i<2; ++i)
+	{
+		dynamic[i]->attach2DTexture("color", TBT_COLOR, size, size, 0, 0, GL_RGBA8);
+		dynamic[i]->createRenderBufferAndAttach("depth", RBT_DEPTH_AND_STENCIL, GL_DEPTH24_STENCIL8, size, size);
+		dynamic[i]->isComplete();
+	}
+	glFinish();
+	Clock::time_point start = Clock::now();
+	for(unsigned i=0; i<iterations; ++i)
+		dynamic[i%2]->bind();
+	glFinish();
+	addResult("bind", "FrameBufferObject", size, size, iterations, elapsedMs(start), 0.0);
+
+	typedef StaticFramebuffer<BTM_WRITE, TextureLayout<TBT_COLOR, GL_RGBA8>, RenderBufferLayout<RBT_DEPTH_AND_STENCIL, GL_DEPTH24_STENCIL8> > Target;
+	Target first(size, size), second(size, size);
+	BindingCache& cache = BindingCache::current();
+	glFinish();
+	start = Clock::now();
+	for(unsigned i=0; i<iterations; ++i)
+		(i%2 ? second : first).bind(cache);
+	glFinish();
+	addResult("bind", "StaticFramebuffer", size, size, iterations, elapsedMs(start), 0.0);
+	BindingCache::current().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+static void benchSoftware()
+{
+	// every kernel level the cpu has, on one thread and on all of them
+	TileWorkerPool& pool = TileWorkerPool::getInstance();
+	unsigned maxThreads = pool.getNumThreads();
+	const unsigned threadCounts[] = {1, maxThreads};
+	unsigned numThreadCounts = maxThreads>1 ? 2 : 1;
+	SOFTWARE_KERNEL_LEVEL supported = SoftwareKernels::getSupportedLevel();
+
+	for(unsigned s=0; s<g_numSizes; ++s)
+	{
+		GLsizei size = g_sizes[s];
+		double pixels = (double)size * size;
+
+		SoftwareFramebuffer source, target, half;
+		AttachmentHandle color = source.attach2DTexture("color", TBT_COLOR, size, size, 0, 0, GL_RGBA8);
+		AttachmentHandle color32f = source.attach2DTexture("color32f", TBT_COLOR, size, size, 0, 1, GL_RGBA32F);
+		AttachmentHandle copied = target.attach2DTexture("color", TBT_COLOR, size, size, 0, 0, GL_RGBA8);
+		AttachmentHandle converted = target.attach2DTexture("color32f", TBT_COLOR, size, size, 0, 1, GL_RGBA32F);
+		AttachmentHandle halved = half.attach2DTexture("color", TBT_COLOR, size/2, size/2, 0, 0, GL_RGBA8);
+
+		for(int level=SKL_SCALAR; level<=supported; ++level)
+		{
+			SoftwareKernels::setLevel((SOFTWARE_KERNEL_LEVEL)level);
+			for(unsigned t=0; t<numThreadCounts; ++t)
+			{
+				unsigned threads = threadCounts[t];
+				pool.setNumThreads(threads);
+				std::ostringstream suffix;
+				suffix << "_" << SoftwareKernels::getLevelName((SOFTWARE_KERNEL_LEVEL)level) << "_t" << threads;
+
+				Clock::time_point start = Clock::now();
+				for(unsigned i=0; i<g_iterations; ++i)
+					source.clearColor(color, i&1 ? 1.0f : 0.0f, 0.5f, 0.25f, 1.0f);
+				addResult("software_clear", "RGBA8" + suffix.str(), size, size, g_iterations, elapsedMs(start), pixels * 4);
+
+				start = Clock::now();
+				for(unsigned i=0; i<g_iterations; ++i)
+					source.clearColor(color32f, i&1 ? 1.0f : 0.0f, 0.5f, 0.25f, 1.0f);
+				addResult("software_clear", "RGBA32F" + suffix.str(), size, size, g_iterations, elapsedMs(start), pixels * 16);
+
+				start = Clock::now();
+				for(unsigned i=0; i<g_iterations; ++i)
+					source.copy(target, color, copied);
+				addResult("software_copy", "RGBA8" + suffix.str(), size, size, g_iterations, elapsedMs(start), pixels * 4);
+
+				start = Clock::now();
+				for(unsigned i=0; i<g_iterations; ++i)
+					source.copy(target, color, converted);
+				addResult("software_convert", "RGBA8_to_RGBA32F" + suffix.str(), size, size, g_iterations, elapsedMs(start), pixels * 4);
+
+				start = Clock::now();
+				for(unsigned i=0; i<g_iterations; ++i)
+					source.copy(target, color32f, copied);
+				addResult("software_convert", "RGBA32F_to_RGBA8" + suffix.str(), size, size, g_iterations, elapsedMs(start), pixels * 16);
+
+				start = Clock::now();
+				for(unsigned i=0; i<g_iterations; ++i)
+					source.copy(half, color, halved);
+				addResult("software_downsample", "RGBA8" + suffix.str(), size, size, g_iterations, elapsedMs(start), pixels * 4);
+			}
+		}
+	}
+
+	SoftwareKernels::setLevel(supported);
+	pool.setNumThreads(maxThreads);
+}
+
+
+int main(int argc, char **argv)
+{
+	const char* outputPath = NULL;
+	for(int i=1; i<argc; ++i)
+	{
+		if(strcmp(argv[i], "-o")==0 && i+1<argc)
+			outputPath = argv[++i];
+		else if(strcmp(argv[i], "--quick")==0)
+			g_iterations /= 10;
+		else if(strcmp(argv[i], "--software")==0)
+			g_software = true;
+		else
+		{
+			fprintf(stderr, "usage: %s [-o results.json] [--quick] [--software]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if(g_software)
+		benchSoftware();
+	else
+	{
+		if(!createContext()) return 1;
+		fprintf(stderr, "Renderer: %s\n", glGetString(GL_RENDERER));
+
+		benchCreateDestroy();
+		benchAttachDetach();
+		benchClearAndFill();
+		benchBlit();
+		benchReadback();
+		benchUpload();
+		benchPrewarm();
+		benchBind();
+	}
+
+	if(outputPath)
+	{
+		std::ofstream file(outputPath);
+		writeResults(file);
+	}
+	else
+		writeResults(std::cout);
+
+	return 0;
+}
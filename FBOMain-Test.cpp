@@ -10,6 +10,7 @@
 #define _CRT_SECURE_NO_DEPRECATE // disable VS deprecation warnings
 
 #include <iostream>
+#include <sstream>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -19,6 +20,7 @@
 #include <GL/glew.h>     // for GLEW
 #include <GL/glut.h>     // for GLUT
 #include "FrameBufferObject.h"
+#include "RenderTargetSet.h"
 
 //=========================================
 // Window size
@@ -37,7 +39,15 @@
 #define TEXTURE_BUFFER_W 512
 #define TEXTURE_BUFFER_W 512
 
+// render targets, built in one pass at startup
+static const char* g_targetDescription =
+	"fbo teapot write\n"
+	"renderbuffer DepthBuffer1 depth DEPTH_COMPONENT24 512x512\n"
+	"texture 2DTextureBuffer1 color0 RGBA8 512x512\n";
+
+RenderTargetSet* g_targets = NULL;
 FrameBufferObject* g_fbo = NULL;
+AttachmentHandle g_colorTexture;
 GLfloat angle = 0.0f;
 
 
@@ -65,7 +75,9 @@ void DrawQuad()
 
 static void release(void)
 {
-	delete g_fbo;
+	TimerQueryRing::writeCSVHeader(std::cout);
+	g_fbo->writeTimingCSV(std::cout, "teapot");
+	delete g_targets;
 }
 
 
@@ -130,14 +142,15 @@ void display(void)
 {
 	
 	// prepare to render onto the texture
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, g_fbo->getID());
+	g_fbo->bind();
+	g_fbo->beginTiming();
 	
 	// Do not forget to set viewport, it must be same size with the FBO
 	glViewport(0, 0, 512, 512);
 	
 	// clear renderbuffers.
-	glClearColor(0.0, 0.0, 0.0, 1.0);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	const GLfloat black[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+	g_fbo->clear(black);
 	
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
@@ -155,6 +168,7 @@ void display(void)
 	glColor3f(1.0f, 1.0f, 0.0f);
 	glutSolidTeapot(0.6);
 	glPopMatrix();
+	g_fbo->endTiming();
 		
 	// now switch back to the window system provided buffer to display the texture
 	g_fbo->switchToDefaultSystemBuffers();
@@ -185,21 +199,27 @@ void display(void)
 
 void initFBO()
 {
-	// create a fbo
-	g_fbo = new FrameBufferObject(BTM_WRITE);
-	if(g_fbo)
+	// describe the fbos and allocate them before the first frame
+	g_targets = new RenderTargetSet();
+	std::istringstream description(g_targetDescription);
+	if(!g_targets->load(description) || !g_targets->prewarm(WINDOW_WIDTH, WINDOW_HEIGHT))
 	{
-		std::cerr << "Success: FBO is created with the GL id: " << g_fbo->getID() << std::endl; 
+		// nothing to render into, the demo cannot run
+		std::cerr << "Error: render targets could not be created" << std::endl;
+		delete g_targets;
+		exit(1);
 	}
+	g_targets->printReport(std::cerr);
 
-	const std::string db1 = "DepthBuffer1";
-	const std::string tb1 = "2DTextureBuffer1";
-	const GLsizei w=1<<9, h=w;
-
-	// create a texture buffer and a depth buffer
-	g_fbo->createRenderBuffer(db1, RBT_DEPTH, GL_DEPTH_COMPONENT24, w, h);
-	g_fbo->attachRenderBuffer(db1);
-	g_fbo->attach2DTexture(tb1, TBT_COLOR, w, h, 0);
+	g_fbo = g_targets->getFramebuffer("teapot");
+	g_colorTexture = g_targets->getAttachment("teapot", "2DTextureBuffer1");
+	if(g_fbo==NULL || !g_colorTexture.isValid())
+	{
+		std::cerr << "Error: render target set has no teapot color texture" << std::endl;
+		delete g_targets;
+		exit(1);
+	}
+	std::cerr << "Success: FBO is created with the GL id: " << g_fbo->getID() << std::endl; 
 
 }
 
@@ -234,7 +254,7 @@ void init()
 	initFBO();
 
 	// set texture parameters
-	glBindTexture(GL_TEXTURE_2D, g_fbo->getTextureBufferID("2DTextureBuffer1"));
+	BindingCache::current().bindTexture(GL_TEXTURE_2D, g_fbo->getAttachmentID(g_colorTexture));
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
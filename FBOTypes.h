@@ -0,0 +1,36 @@
+// =================================================================
+//   File      : FBOTypes.h
+//   Desc	   : Handle, result and buffer type definitions shared by
+//				 FrameBufferObject and SoftwareFramebuffer. Includes
+//				 nothing from GL so the software framebuffer builds
+//				 on machines without GL headers.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef FBOTYPES_H
+#define FBOTYPES_H
+
+// Buffer's target mode parameter
+enum BUFFER_TARGET_MODE {BTM_READ=0, BTM_WRITE, BTM_READ_WRITE };
+// Render buffer type
+enum RBUFFER_TYPE {RBT_COLOR=0, RBT_DEPTH, RBT_STENCIL, RBT_DEPTH_AND_STENCIL};
+// texture buffer
+enum TEXTURE_BUFFER_TYPE {TBT_COLOR=0,TBT_DEPTH,TBT_STENCIL,TBT_DEPTH_AND_STENCIL};
+enum TEXTURE_TYPE {TT_1D=0, TT_2D, TT_3D, TT_2D_MULTISAMPLE, TT_2D_ARRAY, TT_CUBE_MAP};
+// result of lookups and operations on attachments
+enum FBO_RESULT {FR_OK=0, FR_NOT_FOUND, FR_INVALID_HANDLE, FR_BUSY, FR_UNSUPPORTED};
+
+// compact reference to an attachment, returned when the attachment is
+// created and valid until it is deleted. resolves in O(1) without any
+// string handling.
+struct AttachmentHandle {
+	unsigned short index; // entry of the fbo's attachment table
+	unsigned short generation; // 0 marks an invalid handle
+
+	AttachmentHandle() : index(0), generation(0) {}
+	bool isValid()const { return generation!=0; }
+};
+
+#endif
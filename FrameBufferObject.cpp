@@ -11,406 +11,2572 @@
 
 #include "FrameBufferObject.h"
 
-FrameBufferObject::FrameBufferObject(): m_BufferTargetMode(BTM_WRITE)
+#include <algorithm>
+
+// -1 until the first fbo decides which backend the context supports
+int FrameBufferObject::s_directStateAccess = -1;
+
+std::map<const void*, std::vector<GLuint> > FrameBufferObject::s_orphanedFramebuffers;
+std::mutex FrameBufferObject::s_orphanMutex;
+
+FrameBufferObject::FrameBufferObject(): m_numRenderbuffers(0), m_numTexturebuffers(0), m_explicitDrawBuffers(false), m_readbackRing(NULL), m_timerQueryRing(NULL), m_usePool(false), m_invalidateOnUnbind(false), m_numAutoMipmaps(0), m_numCleared(0), m_drawing(false), m_BufferTargetMode(BTM_WRITE),
+	m_context(BindingCache::currentContext()), m_serial(0), m_ownerSerial(0), m_ownerFenceSerial(0), m_publishFence(NULL), m_publishContext(NULL), m_publishSerial(0)
 {
+	releaseOrphanedFramebuffers();
+	
+	if(isDirectStateAccessEnabled())
+	{
+		// named objects exist as soon as they are created, nothing to bind
+		glCreateFramebuffers(1, &m_Id);
+		return;
+	}
 	
 	glGenFramebuffers(1, &m_Id);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_Id); // set default target mode to write
+	BindingCache::current().bindFramebuffer(GL_FRAMEBUFFER, m_Id); // set default target mode to write
 
 }
 
-FrameBufferObject::FrameBufferObject(BUFFER_TARGET_MODE mode) : m_BufferTargetMode(mode)
+FrameBufferObject::FrameBufferObject(BUFFER_TARGET_MODE mode) : m_numRenderbuffers(0), m_numTexturebuffers(0), m_explicitDrawBuffers(false), m_readbackRing(NULL), m_timerQueryRing(NULL), m_usePool(false), m_invalidateOnUnbind(false), m_numAutoMipmaps(0), m_numCleared(0), m_drawing(false), m_BufferTargetMode(mode),
+	m_context(BindingCache::currentContext()), m_serial(0), m_ownerSerial(0), m_ownerFenceSerial(0), m_publishFence(NULL), m_publishContext(NULL), m_publishSerial(0)
 {
-	glGenFramebuffers(1, &m_Id);
+	releaseOrphanedFramebuffers();
 
-	GLenum target;
-	switch(m_BufferTargetMode)
+	if(isDirectStateAccessEnabled())
 	{
-		case 0:  target = GL_READ_FRAMEBUFFER; break;
-		case 1:  target = GL_DRAW_FRAMEBUFFER; break;
-		case 2:  target = GL_FRAMEBUFFER; break;
-		default: target = GL_FRAMEBUFFER; break;
+		glCreateFramebuffers(1, &m_Id);
+		return;
 	}
 
-	glBindFramebuffer(target, m_Id); //allocate storage for the generated FBO
+	glGenFramebuffers(1, &m_Id);
+	BindingCache::current().bindFramebuffer(getTarget(), m_Id); //allocate storage for the generated FBO
 
 }
 
 
 FrameBufferObject::~FrameBufferObject()
 {
-	// To Do: delete textures
-	for(std::map<std::string, GLuint>::iterator it = m_renderBufferNames.begin(); it != m_renderBufferNames.end(); ++it) 
+	// delete or pool every buffer this fbo created
+	for(std::vector<Attachment>::iterator it = m_attachments.begin(); it != m_attachments.end(); ++it)
 	{
-		std::string rbname = it->first;
-		GLuint rbid = it->second;
-		if(isRenderBufferUsed(rbname))
-			glDeleteRenderbuffers(1, &rbid);
+		if(it->id!=0) delete it->uploadRing;
+		if(it->id==0 || it->external) continue;
+		if(it->isRenderBuffer)
+			releaseRenderBuffer(it->id, it->renderBuffer);
+		else
+			releaseTexture(it->id, it->texture);
 	}
+
+	delete m_readbackRing;
+	delete m_timerQueryRing;
 	
-	glDeleteFramebuffers(1, &m_Id);
+	if(m_publishFence) glDeleteSync(m_publishFence);
+
+	// fbos of other contexts can only be deleted once they are current again
+	deleteFramebuffer(m_context, m_Id);
+	for(std::map<const void*, ContextFramebuffer>::iterator it = m_contextFramebuffers.begin(); it != m_contextFramebuffers.end(); ++it)
+		deleteFramebuffer(it->first, it->second.id);
 
 };
 
 
-void FrameBufferObject::createRenderBuffer(std::string name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei width, GLsizei height)
+AttachmentHandle FrameBufferObject::createRenderBuffer(const std::string& name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei width, GLsizei height, GLuint colorSlot)
 {
-	// fill in buffer data
-	RenderBufferFormat bf;
-	bf.bufferType = type;
-	bf.intFormat=internalFormat;
-	bf.width = width;
-	bf.height = height;
-	
-	GLuint idRenderBuffer;
-	glGenRenderbuffers(1, &idRenderBuffer);
-	m_renderBufferNames[name] = idRenderBuffer;
-	m_renderbuffers[idRenderBuffer] = bf;
-	
-	glBindRenderbuffer(GL_RENDERBUFFER, idRenderBuffer);
-	glRenderbufferStorage(GL_RENDERBUFFER, bf.intFormat, bf.width, bf.height);
+	return createMultisampleRenderBuffer(name, type, internalFormat, 0, width, height, colorSlot);
 }
 
 
-void FrameBufferObject::createRenderBufferAndAttach(std::string name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei width, GLsizei height)
+AttachmentHandle FrameBufferObject::createMultisampleRenderBuffer(const std::string& name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei samples, GLsizei width, GLsizei height, GLuint colorSlot)
 {
+	// slot check
+	if(type==RBT_COLOR && colorSlot>=getMaxColorAttachments())
+	{
+		std::cerr << "Error: color slot " << colorSlot << " of " << name << " renderbuffer exceeds GL_MAX_COLOR_ATTACHMENTS...\n";
+		return AttachmentHandle();
+	}
+
+	// format check
+	if(!checkFormat(name, getAttachmentPoint(type, colorSlot), internalFormat)) return AttachmentHandle();
+
+	// fill in buffer data
 	RenderBufferFormat bf;
 	bf.bufferType = type;
 	bf.intFormat=internalFormat;
+	bf.samples = samples<getMaxSamples() ? samples : getMaxSamples();
 	bf.width = width;
 	bf.height = height;
+	bf.colorSlot = colorSlot;
+	bf.attached = false;
 	
-	GLuint idRenderBuffer;
-	glGenRenderbuffers(1, &idRenderBuffer);
-	m_renderBufferNames[name] = idRenderBuffer;
-	m_renderbuffers[idRenderBuffer] = bf;
-	glBindRenderbuffer(GL_RENDERBUFFER, idRenderBuffer);
-	glRenderbufferStorage(GL_RENDERBUFFER, bf.intFormat, bf.width, bf.height);
-	// attach to FBO
-	// check to see if created fbo is the currently bound
-	// i.e. glBindFramebuffer()...
-	GLenum attachmentType;
-	switch(type)
-	{
-		case RBT_COLOR: attachmentType=GL_COLOR_ATTACHMENT0;break;
-		case RBT_DEPTH: attachmentType=GL_DEPTH_ATTACHMENT;break;
-		case RBT_STENCIL: attachmentType=GL_STENCIL_ATTACHMENT;break;
-	}
-	
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachmentType, GL_RENDERBUFFER, idRenderBuffer);
-	
+	GLuint idRenderBuffer = allocateRenderBuffer(bf);
+	AttachmentHandle handle = addAttachment(idRenderBuffer, true);
+	m_attachments[handle.index].renderBuffer = bf;
+	m_renderBufferNames[name] = handle;
+	return handle;
+}
 
+
+AttachmentHandle FrameBufferObject::createRenderBufferAndAttach(const std::string& name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei width, GLsizei height, GLuint colorSlot)
+{
+	AttachmentHandle handle = createRenderBuffer(name, type, internalFormat, width, height, colorSlot);
+	attachRenderBuffer(handle);
+	return handle;
 }
 
-void FrameBufferObject::attachRenderBuffer(std::string name)
+
+AttachmentHandle FrameBufferObject::createMultisampleRenderBufferAndAttach(const std::string& name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei samples, GLsizei width, GLsizei height, GLuint colorSlot)
 {
-	// attach to the currently bound FBO
-	// check to see if created fbo is the currently bound
-	// i.e. glBindFramebuffer()...
+	AttachmentHandle handle = createMultisampleRenderBuffer(name, type, internalFormat, samples, width, height, colorSlot);
+	attachRenderBuffer(handle);
+	return handle;
+}
 
-	// name check
-	if(getRenderBufferID(name)<=0) return;
+FBO_RESULT FrameBufferObject::attachRenderBuffer(AttachmentHandle handle)
+{
+	// handle check
+	Attachment* attachment = getAttachment(handle, true);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
 	
-	GLuint id = m_renderBufferNames[name];
-	const RenderBufferFormat& bf = m_renderbuffers[id];
+	RenderBufferFormat& bf = attachment->renderBuffer;
 	
-	GLenum attachmentType;
-	switch(bf.bufferType)
-	{
-		case RBT_COLOR: attachmentType=GL_COLOR_ATTACHMENT0;break;
-		case RBT_DEPTH: attachmentType=GL_DEPTH_ATTACHMENT;break;
-		case RBT_STENCIL: attachmentType=GL_STENCIL_ATTACHMENT;break;
-	}
+	// an attachment point holds a single buffer
+	detachAttachmentsAt(getAttachmentPoint(bf.bufferType, bf.colorSlot), handle.index);
+	if(bf.bufferType==RBT_COLOR && !useColorSlot(bf.colorSlot)) return FR_UNSUPPORTED;
+
+	bf.attached = true;
+	attachToFramebuffer(*attachment);
 
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachmentType, GL_RENDERBUFFER, id);
+	if(bf.bufferType==RBT_COLOR) applyDrawBuffers();
+	markConfigurationChanged();
+	return FR_OK;
 	
 }
 
 
-void FrameBufferObject::detachRenderBuffer(std::string name)
+FBO_RESULT FrameBufferObject::attachRenderBuffer(const std::string& name)
 {
-	// name check
-	if(getRenderBufferID(name)<=0) return;
+	AttachmentHandle handle;
+	FBO_RESULT result = findRenderBuffer(name, handle);
+	return result==FR_OK ? attachRenderBuffer(handle) : result;
+}
 
-	GLuint id = m_renderBufferNames[name];
-	RenderBufferFormat& bf = m_renderbuffers[id];
 
-	GLenum attachmentType;
-	switch(bf.bufferType)
+FBO_RESULT FrameBufferObject::detachRenderBuffer(AttachmentHandle handle)
+{
+	// handle check
+	Attachment* attachment = getAttachment(handle, true);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+
+	RenderBufferFormat& bf = attachment->renderBuffer;
+
+	GLenum attachmentType = getAttachmentPoint(bf.bufferType, bf.colorSlot);
+	if(isDirectStateAccessEnabled())
 	{
-		case RBT_COLOR: attachmentType=GL_COLOR_ATTACHMENT0;break;
-		case RBT_DEPTH: attachmentType=GL_DEPTH_ATTACHMENT;break;
-		case RBT_STENCIL: attachmentType=GL_STENCIL_ATTACHMENT;break;
+		glNamedFramebufferRenderbuffer(getContextID(), attachmentType, GL_RENDERBUFFER, 0);
+	}
+	else
+	{
+		bindToEdit();
+		glFramebufferRenderbuffer(getTarget(), attachmentType, GL_RENDERBUFFER, 0);
 	}
+	bf.attached = false;
 
-	GLenum target;
-	switch(m_BufferTargetMode)
+	if(bf.bufferType==RBT_COLOR)
 	{
-		case 0:  target = GL_READ_FRAMEBUFFER; break;
-		case 1:  target = GL_DRAW_FRAMEBUFFER; break;
-		case 2:  target = GL_FRAMEBUFFER; break;
-		default: target = GL_FRAMEBUFFER; break;
+		releaseColorSlot(bf.colorSlot);
+		applyDrawBuffers();
 	}
+	markConfigurationChanged();
+	return FR_OK;
+	
+}
 
-	glBindFramebuffer(target, m_Id);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachmentType, GL_RENDERBUFFER, 0);
 
-	
+FBO_RESULT FrameBufferObject::detachRenderBuffer(const std::string& name)
+{
+	AttachmentHandle handle;
+	FBO_RESULT result = findRenderBuffer(name, handle);
+	return result==FR_OK ? detachRenderBuffer(handle) : result;
 }
 
 
-void FrameBufferObject::deleteRenderBuffer(std::string name)
+FBO_RESULT FrameBufferObject::deleteRenderBuffer(AttachmentHandle handle)
 {
-	// name check
-	if(getRenderBufferID(name)<=0) return;
-	GLuint id = m_renderBufferNames[name];
-	glDeleteRenderbuffers(1, &id);
+	// handle check
+	Attachment* attachment = getAttachment(handle, true);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+
+	// frees the color slot and draw buffer, and a pooled buffer may be
+	// handed to another fbo, so it must not stay attached here
+	if(attachment->renderBuffer.attached)
+		detachRenderBuffer(handle);
+
+	releaseRenderBuffer(attachment->id, attachment->renderBuffer);
+	removeAttachment(handle);
+	markConfigurationChanged();
+	return FR_OK;
 }
 
 
-bool FrameBufferObject::isRenderBufferUsed(std::string name)
+FBO_RESULT FrameBufferObject::deleteRenderBuffer(const std::string& name)
+{
+	AttachmentHandle handle;
+	FBO_RESULT result = findRenderBuffer(name, handle);
+	if(result!=FR_OK) return result;
+
+	m_renderBufferNames.erase(name);
+	return deleteRenderBuffer(handle);
+}
+
+
+bool FrameBufferObject::isRenderBufferUsed(const std::string& name)
 {
 	// name check
-	if(getRenderBufferID(name)<=0) return false;
+	GLuint id = getRenderBufferID(name);
+	if(id==0) return false;
 
-	GLuint id = m_renderBufferNames[name];
 	return GL_TRUE==glIsRenderbuffer(id) ? true : false;
 }
 
 
-void FrameBufferObject::attach1DTexture(std::string name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLint level)
+AttachmentHandle FrameBufferObject::attach1DTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLint level, GLuint colorSlot, GLenum internalFormat, GLsizei numLevels)
 {
-	// create a texture object 
-	GLuint textureid;
-	glGenTextures(1, &textureid);
-	m_attachedTextureNames[name] = textureid;
-	
+	// format check
+	if(internalFormat==GL_NONE) internalFormat = getDefaultFormat(tbtype);
+	if(!checkFormat(name, getAttachmentPoint(tbtype, colorSlot), internalFormat) || !checkTextureFormat(name, internalFormat)) return AttachmentHandle();
+
+	// slot check, an attachment point holds a single buffer
+	detachAttachmentsAt(getAttachmentPoint(tbtype, colorSlot));
+	if(tbtype==TBT_COLOR && !useColorSlot(colorSlot)) return AttachmentHandle();
+
 	TextureBufferFormat tbf;
 	tbf.attachmentPoint=tbtype ;
 	tbf.width = width;
 	tbf.height = 0;
+	tbf.depth = 0;
+	tbf.level = level;
+	tbf.levels = getLevelCount(numLevels, level, width, 0, 0);
+	tbf.layer = 0;
+	tbf.samples = 0;
 	tbf.type = TT_1D;
+	tbf.intFormat = internalFormat;
+	tbf.colorSlot = colorSlot;
+	tbf.attached = true;
 
-	m_texturebuffers[textureid] = tbf;
+	// create a texture object or take one from the pool
+	GLuint textureid = allocateTexture(tbf);
+	AttachmentHandle handle = addAttachment(textureid, false);
+	m_attachments[handle.index].texture = tbf;
+	m_attachedTextureNames[name] = handle;
 
-	GLenum target;
-	switch(m_BufferTargetMode)
-	{
-		case 0:  target = GL_READ_FRAMEBUFFER; break;
-		case 1:  target = GL_DRAW_FRAMEBUFFER; break;
-		case 2:  target = GL_FRAMEBUFFER; break;
-		default: target = GL_FRAMEBUFFER; break;
-	}
+	// attach to fbo
+	attachToFramebuffer(m_attachments[handle.index]);
 
+	if(tbtype==TBT_COLOR) applyDrawBuffers();
+	markConfigurationChanged();
+	return handle;
+	
+}
 
-	GLenum attachmentType;
-	switch(tbf.attachmentPoint)
-	{
-		case TBT_COLOR: attachmentType=GL_COLOR_ATTACHMENT0;break;
-		case TBT_DEPTH: attachmentType=GL_DEPTH_ATTACHMENT;break;
-		case TBT_STENCIL: attachmentType=GL_STENCIL_ATTACHMENT;break;
-	}
+
+AttachmentHandle FrameBufferObject::attach2DTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLsizei height, GLint level, GLuint colorSlot, GLenum internalFormat, GLsizei numLevels)
+{
+	// format check
+	if(internalFormat==GL_NONE) internalFormat = getDefaultFormat(tbtype);
+	if(!checkFormat(name, getAttachmentPoint(tbtype, colorSlot), internalFormat) || !checkTextureFormat(name, internalFormat)) return AttachmentHandle();
+
+	// slot check, an attachment point holds a single buffer
+	detachAttachmentsAt(getAttachmentPoint(tbtype, colorSlot));
+	if(tbtype==TBT_COLOR && !useColorSlot(colorSlot)) return AttachmentHandle();
 	
-	// set storage for the texture
-	glBindTexture(GL_TEXTURE_1D, textureid);
-	glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, width, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL );
+	TextureBufferFormat tbf;
+	tbf.attachmentPoint=tbtype ;
+	tbf.width = width;
+	tbf.height = height;
+	tbf.depth = 0;
+	tbf.level = level;
+	tbf.levels = getLevelCount(numLevels, level, width, height, 0);
+	tbf.layer = 0;
+	tbf.samples = 0;
+	tbf.type = TT_2D;
+	tbf.intFormat = internalFormat;
+	tbf.colorSlot = colorSlot;
+	tbf.attached = true;
+
+	// create a texture object or take one from the pool
+	GLuint textureid = allocateTexture(tbf);
+	AttachmentHandle handle = addAttachment(textureid, false);
+	m_attachments[handle.index].texture = tbf;
+	m_attachedTextureNames[name] = handle;
 
 	// attach to fbo
-	glFramebufferTexture1D(target, attachmentType, GL_TEXTURE_1D, textureid, level);
-	
-}
+	attachToFramebuffer(m_attachments[handle.index]);
+
+	if(tbtype==TBT_COLOR) applyDrawBuffers();
+	markConfigurationChanged();
+	return handle;
 
+}
 
-void FrameBufferObject::attach2DTexture(std::string name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLsizei height, GLint level)
+AttachmentHandle FrameBufferObject::attach3DTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLsizei height, GLsizei depth, GLint level, GLint layer, GLuint colorSlot, GLenum internalFormat, GLsizei numLevels)
 {
+	// format check
+	if(internalFormat==GL_NONE) internalFormat = getDefaultFormat(tbtype);
+	if(!checkFormat(name, getAttachmentPoint(tbtype, colorSlot), internalFormat) || !checkTextureFormat(name, internalFormat)) return AttachmentHandle();
+
+	// slot check, an attachment point holds a single buffer
+	detachAttachmentsAt(getAttachmentPoint(tbtype, colorSlot));
+	if(tbtype==TBT_COLOR && !useColorSlot(colorSlot)) return AttachmentHandle();
+	
+	TextureBufferFormat tbf;
+	tbf.attachmentPoint=tbtype ;
+	tbf.width = width;
+	tbf.height = height;
+	tbf.depth = depth;
+	tbf.level = level;
+	tbf.levels = getLevelCount(numLevels, level, width, height, depth);
+	tbf.layer = layer;
+	tbf.samples = 0;
+	tbf.type = TT_3D;
+	tbf.intFormat = internalFormat;
+	tbf.colorSlot = colorSlot;
+	tbf.attached = true;
+
+	// create a texture object or take one from the pool
+	GLuint textureid = allocateTexture(tbf);
+	AttachmentHandle handle = addAttachment(textureid, false);
+	m_attachments[handle.index].texture = tbf;
+	m_attachedTextureNames[name] = handle;
 	
-	// create a texture object 
-	GLuint textureid;
-	glGenTextures(1, &textureid);
-	m_attachedTextureNames[name] = textureid;
+	attachTextureLayer(textureid, tbf);
+
+	if(tbtype==TBT_COLOR) applyDrawBuffers();
+	markConfigurationChanged();
+	return handle;
 	
+}
+
+AttachmentHandle FrameBufferObject::attach2DArrayTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLsizei height, GLsizei layers, GLint level, GLint layer, GLuint colorSlot, GLenum internalFormat, GLsizei numLevels)
+{
+	// format check
+	if(internalFormat==GL_NONE) internalFormat = getDefaultFormat(tbtype);
+	if(!checkFormat(name, getAttachmentPoint(tbtype, colorSlot), internalFormat) || !checkTextureFormat(name, internalFormat)) return AttachmentHandle();
+
+	// slot check, an attachment point holds a single buffer
+	detachAttachmentsAt(getAttachmentPoint(tbtype, colorSlot));
+	if(tbtype==TBT_COLOR && !useColorSlot(colorSlot)) return AttachmentHandle();
+
 	TextureBufferFormat tbf;
 	tbf.attachmentPoint=tbtype ;
 	tbf.width = width;
 	tbf.height = height;
-	tbf.type = TT_2D;
+	tbf.depth = layers;
+	tbf.level = level;
+	tbf.levels = getLevelCount(numLevels, level, width, height, 0);
+	tbf.layer = layer;
+	tbf.samples = 0;
+	tbf.type = TT_2D_ARRAY;
+	tbf.intFormat = internalFormat;
+	tbf.colorSlot = colorSlot;
+	tbf.attached = true;
+
+	// create a texture object or take one from the pool
+	GLuint textureid = allocateTexture(tbf);
+	AttachmentHandle handle = addAttachment(textureid, false);
+	m_attachments[handle.index].texture = tbf;
+	m_attachedTextureNames[name] = handle;
+
+	attachTextureLayer(textureid, tbf);
+
+	if(tbtype==TBT_COLOR) applyDrawBuffers();
+	markConfigurationChanged();
+	return handle;
 
-	m_texturebuffers[textureid] = tbf;
+}
 
-	GLenum target;
-	switch(m_BufferTargetMode)
-	{
-		case 0:  target = GL_READ_FRAMEBUFFER; break;
-		case 1:  target = GL_DRAW_FRAMEBUFFER; break;
-		case 2:  target = GL_FRAMEBUFFER; break;
-		default: target = GL_FRAMEBUFFER; break;
-	}
+AttachmentHandle FrameBufferObject::attachCubeMapTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei size, GLint level, GLint face, GLuint colorSlot, GLenum internalFormat, GLsizei numLevels)
+{
+	// format check
+	if(internalFormat==GL_NONE) internalFormat = getDefaultFormat(tbtype);
+	if(!checkFormat(name, getAttachmentPoint(tbtype, colorSlot), internalFormat) || !checkTextureFormat(name, internalFormat)) return AttachmentHandle();
 
-	GLenum attachmentType;
-	switch(tbf.attachmentPoint)
-	{
-		case TBT_COLOR: attachmentType=GL_COLOR_ATTACHMENT0;break;
-		case TBT_DEPTH: attachmentType=GL_DEPTH_ATTACHMENT;break;
-		case TBT_STENCIL: attachmentType=GL_STENCIL_ATTACHMENT;break;
-	}
-	
-	// set storage for the texture
-	glBindTexture(GL_TEXTURE_2D, textureid);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+	// slot check, an attachment point holds a single buffer
+	detachAttachmentsAt(getAttachmentPoint(tbtype, colorSlot));
+	if(tbtype==TBT_COLOR && !useColorSlot(colorSlot)) return AttachmentHandle();
 
-	// attach to fbo
-	glFramebufferTexture2D(target, attachmentType, GL_TEXTURE_2D, textureid, level);
+	TextureBufferFormat tbf;
+	tbf.attachmentPoint=tbtype ;
+	tbf.width = size;
+	tbf.height = size;
+	tbf.depth = 6;
+	tbf.level = level;
+	tbf.levels = getLevelCount(numLevels, level, size, size, 0);
+	tbf.layer = face;
+	tbf.samples = 0;
+	tbf.type = TT_CUBE_MAP;
+	tbf.intFormat = internalFormat;
+	tbf.colorSlot = colorSlot;
+	tbf.attached = true;
+
+	// create a texture object or take one from the pool
+	GLuint textureid = allocateTexture(tbf);
+	AttachmentHandle handle = addAttachment(textureid, false);
+	m_attachments[handle.index].texture = tbf;
+	m_attachedTextureNames[name] = handle;
+
+	attachTextureLayer(textureid, tbf);
+
+	if(tbtype==TBT_COLOR) applyDrawBuffers();
+	markConfigurationChanged();
+	return handle;
+
+}
+
+FBO_RESULT FrameBufferObject::selectLayer(AttachmentHandle handle, GLint level, GLint layer)
+{
+	// handle check
+	Attachment* attachment = getAttachment(handle, false);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+
+	TextureBufferFormat& tbf = attachment->texture;
+	if(tbf.type!=TT_3D && tbf.type!=TT_2D_ARRAY && tbf.type!=TT_CUBE_MAP) return FR_UNSUPPORTED;
+	if(layer>=tbf.depth || level<0 || level>=tbf.levels) return FR_NOT_FOUND;
+
+	tbf.level = level;
+	tbf.layer = layer;
+	setCleared(*attachment, false);
+	if(!tbf.attached) return FR_OK;
+
+	attachTextureLayer(attachment->id, tbf);
+	markConfigurationChanged();
+	return FR_OK;
+}
 
+FBO_RESULT FrameBufferObject::selectLevel(AttachmentHandle handle, GLint level)
+{
+	// handle check
+	Attachment* attachment = getAttachment(handle, false);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+
+	TextureBufferFormat& tbf = attachment->texture;
+	if(tbf.type==TT_2D_MULTISAMPLE) return FR_UNSUPPORTED;
+	if(level<0 || level>=tbf.levels) return FR_NOT_FOUND;
+	if(tbf.level==level) return FR_OK;
+
+	tbf.level = level;
+	setCleared(*attachment, false);
+	if(!tbf.attached) return FR_OK;
+
+	attachToFramebuffer(*attachment);
+	markConfigurationChanged();
+	return FR_OK;
 }
 
-void FrameBufferObject::attach3DTexture(std::string name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLsizei height, GLsizei depth, GLint level, GLint layer)
+AttachmentHandle FrameBufferObject::attach2DMultisampleTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei samples, GLsizei width, GLsizei height, GLuint colorSlot, GLenum internalFormat)
 {
+	// format check
+	if(internalFormat==GL_NONE) internalFormat = getDefaultFormat(tbtype);
+	if(!checkFormat(name, getAttachmentPoint(tbtype, colorSlot), internalFormat) || !checkTextureFormat(name, internalFormat)) return AttachmentHandle();
+
+	// slot check, an attachment point holds a single buffer
+	detachAttachmentsAt(getAttachmentPoint(tbtype, colorSlot));
+	if(tbtype==TBT_COLOR && !useColorSlot(colorSlot)) return AttachmentHandle();
+
+	TextureBufferFormat tbf;
+	tbf.attachmentPoint=tbtype ;
+	tbf.width = width;
+	tbf.height = height;
+	tbf.depth = 0;
+	tbf.level = 0;
+	tbf.levels = 1;
+	tbf.layer = 0;
+	tbf.samples = samples<getMaxSamples() ? samples : getMaxSamples();
+	tbf.type = TT_2D_MULTISAMPLE;
+	tbf.intFormat = internalFormat;
+	tbf.colorSlot = colorSlot;
+	tbf.attached = true;
+
+	// create a texture object or take one from the pool
+	GLuint textureid = allocateTexture(tbf);
+	AttachmentHandle handle = addAttachment(textureid, false);
+	m_attachments[handle.index].texture = tbf;
+	m_attachedTextureNames[name] = handle;
+
+	attachToFramebuffer(m_attachments[handle.index]);
+
+	if(tbtype==TBT_COLOR) applyDrawBuffers();
+	markConfigurationChanged();
+	return handle;
 	
-	// create a texture object 
-	GLuint textureid;
-	glGenTextures(1, &textureid);
-	m_attachedTextureNames[name] = textureid;
+}
+
+AttachmentHandle FrameBufferObject::attachExternalTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLuint textureId, GLenum internalFormat, GLsizei width, GLsizei height, GLint level, GLuint colorSlot, GLsizei numLevels)
+{
+	// format check
+	if(!checkFormat(name, getAttachmentPoint(tbtype, colorSlot), internalFormat)) return AttachmentHandle();
+
+	// slot check, an attachment point holds a single buffer
+	detachAttachmentsAt(getAttachmentPoint(tbtype, colorSlot));
+	if(tbtype==TBT_COLOR && !useColorSlot(colorSlot)) return AttachmentHandle();
 
 	TextureBufferFormat tbf;
 	tbf.attachmentPoint=tbtype ;
 	tbf.width = width;
 	tbf.height = height;
-	tbf.depth = depth;
-	tbf.type = TT_3D;
+	tbf.depth = 0;
+	tbf.level = level;
+	tbf.levels = std::max(numLevels, level+1);
+	tbf.layer = 0;
+	tbf.samples = 0;
+	tbf.type = TT_2D;
+	tbf.intFormat = internalFormat;
+	tbf.colorSlot = colorSlot;
+	tbf.attached = true;
 
-	m_texturebuffers[textureid] = tbf;
+	AttachmentHandle handle = addAttachment(textureId, false);
+	m_attachments[handle.index].texture = tbf;
+	m_attachments[handle.index].external = true;
+	m_attachedTextureNames[name] = handle;
 
-	GLenum target;
-	switch(m_BufferTargetMode)
-	{
-		case 0:  target = GL_READ_FRAMEBUFFER; break;
-		case 1:  target = GL_DRAW_FRAMEBUFFER; break;
-		case 2:  target = GL_FRAMEBUFFER; break;
-		default: target = GL_FRAMEBUFFER; break;
-	}
+	// attach to fbo
+	attachToFramebuffer(m_attachments[handle.index]);
+
+	if(tbtype==TBT_COLOR) applyDrawBuffers();
+	markConfigurationChanged();
+	return handle;
 
-	GLenum attachmentType;
-	switch(tbf.attachmentPoint)
-	{
-		case TBT_COLOR: attachmentType=GL_COLOR_ATTACHMENT0;break;
-		case TBT_DEPTH: attachmentType=GL_DEPTH_ATTACHMENT;break;
-		case TBT_STENCIL: attachmentType=GL_STENCIL_ATTACHMENT;break;
-	}
-	
-	// set storage for the texture
-	glBindTexture(GL_TEXTURE_3D, textureid);
-	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, width, height, depth, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
-	glFramebufferTexture3D(target, attachmentType, GL_TEXTURE_3D, textureid, level, layer);
-	
 }
 
-void FrameBufferObject::detachTexture(std::string name)
+FBO_RESULT FrameBufferObject::detachTexture(AttachmentHandle handle)
 {
-	// name check
-	if(getTextureBufferID(name)<=0) return;
+	// handle check
+	Attachment* attachment = getAttachment(handle, false);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
 
-	GLuint id = m_attachedTextureNames[name];
-	TextureBufferFormat& tbf = m_texturebuffers[id];
+	TextureBufferFormat& tbf = attachment->texture;
 	
-	GLenum target;
-	switch(m_BufferTargetMode)
-	{
-		case 0:  target = GL_READ_FRAMEBUFFER; break;
-		case 1:  target = GL_DRAW_FRAMEBUFFER; break;
-		case 2:  target = GL_FRAMEBUFFER; break;
-		default: target = GL_FRAMEBUFFER; break;
-	}
+	GLenum target = getTarget();
+	GLenum attachmentType = getAttachmentPoint(tbf.attachmentPoint, tbf.colorSlot);
 
-	GLenum attachmentType;
-	switch(tbf.attachmentPoint)
+	if(isDirectStateAccessEnabled())
+		glNamedFramebufferTexture(getContextID(), attachmentType, 0, 0);
+	else
 	{
-		case TBT_COLOR: attachmentType=GL_COLOR_ATTACHMENT0;break;
-		case TBT_DEPTH: attachmentType=GL_DEPTH_ATTACHMENT;break;
-		case TBT_STENCIL: attachmentType=GL_STENCIL_ATTACHMENT;break;
+		bindToEdit();
+		switch(tbf.type)
+		{
+			case TT_1D: glFramebufferTexture1D(target, attachmentType, GL_TEXTURE_1D, 0, 0);break;
+			case TT_2D: glFramebufferTexture2D(target, attachmentType, GL_TEXTURE_2D, 0, 0); break;
+			case TT_3D: glFramebufferTexture3D(target, attachmentType, GL_TEXTURE_3D, 0, 0 ,0);break;
+			case TT_2D_MULTISAMPLE: glFramebufferTexture2D(target, attachmentType, GL_TEXTURE_2D_MULTISAMPLE, 0, 0); break;
+			default: glFramebufferTexture(target, attachmentType, 0, 0); break;
+		}
 	}
+	tbf.attached = false;
 
-	switch(tbf.type)
+	if(tbf.attachmentPoint==TBT_COLOR)
 	{
-		case TT_1D: glFramebufferTexture1D(target, attachmentType, GL_TEXTURE_1D, 0, 0);break;
-		case TT_2D: glFramebufferTexture2D(target, attachmentType, GL_TEXTURE_2D, 0, 0); break;
-		case TT_3D: glFramebufferTexture3D(target, attachmentType, GL_TEXTURE_3D, 0, 0 ,0);break;
+		releaseColorSlot(tbf.colorSlot);
+		applyDrawBuffers();
 	}
-
+	markConfigurationChanged();
+	return FR_OK;
 	
 }
 
 
-GLuint FrameBufferObject::getID() const
+FBO_RESULT FrameBufferObject::detachTexture(const std::string& name)
 {
-	return m_Id;
+	AttachmentHandle handle;
+	FBO_RESULT result = findTexture(name, handle);
+	return result==FR_OK ? detachTexture(handle) : result;
 }
 
-BUFFER_TARGET_MODE FrameBufferObject::getBufferTargetMode()const
+
+FBO_RESULT FrameBufferObject::deleteTexture(AttachmentHandle handle)
 {
-	return m_BufferTargetMode;
+	// handle check
+	Attachment* attachment = getAttachment(handle, false);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+
+	// frees the color slot and draw buffer, and a pooled or external
+	// texture outlives this attachment, so it must not stay attached here
+	if(attachment->texture.attached)
+		detachTexture(handle);
+
+	if(!attachment->external)
+		releaseTexture(attachment->id, attachment->texture);
+	removeAttachment(handle);
+	markConfigurationChanged();
+	return FR_OK;
 }
 
-bool FrameBufferObject::isUsed()const
+
+FBO_RESULT FrameBufferObject::deleteTexture(const std::string& name)
 {
-	return GL_TRUE == glIsFramebuffer(m_Id) ? true : false;
+	AttachmentHandle handle;
+	FBO_RESULT result = findTexture(name, handle);
+	if(result!=FR_OK) return result;
+
+	m_attachedTextureNames.erase(name);
+	return deleteTexture(handle);
 }
 
 
-unsigned FrameBufferObject::getNumRenderbuffers() const
+FBO_RESULT FrameBufferObject::setAutoMipmap(AttachmentHandle handle, bool enable)
 {
-	return m_renderbuffers.size();
+	// handle check
+	Attachment* attachment = getAttachment(handle, false);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+	if(attachment->texture.levels<2) return FR_UNSUPPORTED;
+	if(attachment->autoMipmap==enable) return FR_OK;
+
+	attachment->autoMipmap = enable;
+	attachment->mipmapStale = false;
+	if(enable) ++m_numAutoMipmaps; else --m_numAutoMipmaps;
+	return FR_OK;
 }
 
 
-unsigned FrameBufferObject::getNumAttachedTexturebuffers() const
+bool FrameBufferObject::isMipmapStale(AttachmentHandle handle)const
 {
-	return m_texturebuffers.size();
+	const Attachment* attachment = getAttachment(handle);
+	return attachment!=NULL && attachment->mipmapStale;
 }
 
 
-const GLuint FrameBufferObject::getRenderBufferID(std::string name)const 
+FBO_RESULT FrameBufferObject::updateMipmap(AttachmentHandle handle)
 {
-	// name check
-	std::map<std::string, GLuint>::const_iterator it = m_renderBufferNames.find(name);
-	if(it==m_renderBufferNames.end())
-	{
-		std::cerr << "Error: " << name << " renderbuffer is not found...\n";
-		return 0;
-	}
+	// handle check
+	Attachment* attachment = getAttachment(handle, false);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+
+	return attachment->mipmapStale ? generateMipmap(handle) : FR_OK;
+}
+
+
+FBO_RESULT FrameBufferObject::bindForSampling(AttachmentHandle handle, GLuint unit)
+{
+	FBO_RESULT result = updateMipmap(handle);
+	if(result!=FR_OK) return result;
+
+	const Attachment* attachment = getAttachment(handle);
+	BindingCache::current().bindTexture(unit, getTextureTarget(attachment->texture.type), attachment->id);
+	return FR_OK;
+}
+
+
+FBO_RESULT FrameBufferObject::generateMipmap(AttachmentHandle handle)
+{
+	// handle check
+	Attachment* attachment = getAttachment(handle, false);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+
+	const TextureBufferFormat& tbf = attachment->texture;
+	if(tbf.type==TT_2D_MULTISAMPLE) return FR_UNSUPPORTED;
+
+	if(isDirectStateAccessEnabled())
+		glGenerateTextureMipmap(attachment->id);
 	else
 	{
-		return it->second;
+		GLenum target = getTextureTarget(tbf.type);
+		BindingCache::current().bindTexture(target, attachment->id);
+		glGenerateMipmap(target);
 	}
+	attachment->mipmapStale = false;
+	return FR_OK;
 }
 
 
-const GLuint FrameBufferObject::getTextureBufferID(std::string name)const
+FBO_RESULT FrameBufferObject::findRenderBuffer(const std::string& name, AttachmentHandle& handle)const
 {
-	// name check
-	std::map<std::string, GLuint>::const_iterator it = m_attachedTextureNames.find(name);
-	if(it==m_attachedTextureNames.end())
+	std::map<std::string, AttachmentHandle>::const_iterator it = m_renderBufferNames.find(name);
+	if(it==m_renderBufferNames.end()) return FR_NOT_FOUND;
+
+	// the name may outlive a buffer deleted through its handle
+	if(getAttachment(it->second)==NULL) return FR_NOT_FOUND;
+
+	handle = it->second;
+	return FR_OK;
+}
+
+
+FBO_RESULT FrameBufferObject::findTexture(const std::string& name, AttachmentHandle& handle)const
+{
+	std::map<std::string, AttachmentHandle>::const_iterator it = m_attachedTextureNames.find(name);
+	if(it==m_attachedTextureNames.end()) return FR_NOT_FOUND;
+
+	if(getAttachment(it->second)==NULL) return FR_NOT_FOUND;
+
+	handle = it->second;
+	return FR_OK;
+}
+
+
+void FrameBufferObject::setAttachmentPooling(bool enable)
+{
+	m_usePool = enable;
+}
+
+
+bool FrameBufferObject::isAttachmentPoolingEnabled()const
+{
+	return m_usePool;
+}
+
+
+FBO_RESULT FrameBufferObject::setTransient(AttachmentHandle handle, bool transient)
+{
+	if(getAttachment(handle)==NULL) return FR_INVALID_HANDLE;
+
+	m_attachments[handle.index].transient = transient;
+	return FR_OK;
+}
+
+
+bool FrameBufferObject::isTransient(AttachmentHandle handle)const
+{
+	const Attachment* attachment = getAttachment(handle);
+	return attachment ? attachment->transient : false;
+}
+
+
+FBO_RESULT FrameBufferObject::invalidate()
+{
+	// every attached transient buffer
+	std::vector<GLenum> attachmentPoints;
+	for(std::vector<Attachment>::const_iterator it = m_attachments.begin(); it != m_attachments.end(); ++it)
 	{
-		std::cerr << "Error: " << name << " texturebuffer is not found...\n";
-		return 0;
+		bool attached = it->isRenderBuffer ? it->renderBuffer.attached : it->texture.attached;
+		if(it->id && it->transient && attached)
+			attachmentPoints.push_back(getAttachmentPoint(*it));
 	}
-	else
+
+	if(attachmentPoints.empty()) return FR_OK;
+	return invalidateAttachments(attachmentPoints, NULL);
+}
+
+
+FBO_RESULT FrameBufferObject::invalidate(const std::vector<AttachmentHandle>& handles)
+{
+	std::vector<GLenum> attachmentPoints;
+	for(std::vector<AttachmentHandle>::const_iterator it = handles.begin(); it != handles.end(); ++it)
 	{
-		return it->second;
+		const Attachment* attachment = getAttachment(*it);
+		if(attachment==NULL) return FR_INVALID_HANDLE;
+		attachmentPoints.push_back(getAttachmentPoint(*attachment));
 	}
+
+	if(attachmentPoints.empty()) return FR_OK;
+	return invalidateAttachments(attachmentPoints, NULL);
 }
 
-void FrameBufferObject::switchToDefaultSystemBuffers()
+
+FBO_RESULT FrameBufferObject::invalidate(const std::vector<AttachmentHandle>& handles, GLint x, GLint y, GLsizei width, GLsizei height)
 {
-	GLenum target;
-	switch(m_BufferTargetMode)
+	std::vector<GLenum> attachmentPoints;
+	for(std::vector<AttachmentHandle>::const_iterator it = handles.begin(); it != handles.end(); ++it)
 	{
-		case 0:  target = GL_READ_FRAMEBUFFER; break;
-		case 1:  target = GL_DRAW_FRAMEBUFFER; break;
-		case 2:  target = GL_FRAMEBUFFER; break;
-		default: target = GL_FRAMEBUFFER; break;
+		const Attachment* attachment = getAttachment(*it);
+		if(attachment==NULL) return FR_INVALID_HANDLE;
+		attachmentPoints.push_back(getAttachmentPoint(*attachment));
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if(attachmentPoints.empty()) return FR_OK;
+	GLint rect[4] = {x, y, width, height};
+	return invalidateAttachments(attachmentPoints, rect);
+}
+
+
+void FrameBufferObject::setInvalidateOnUnbind(bool enable)
+{
+	m_invalidateOnUnbind = enable;
+}
+
+
+bool FrameBufferObject::isInvalidationSupported()
+{
+	return GLEW_VERSION_4_3 || GLEW_ARB_invalidate_subdata;
+}
+
+
+FBO_RESULT FrameBufferObject::clearColor(AttachmentHandle handle, GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+	// handle check
+	const Attachment* attachment = getAttachment(handle);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+	if(getBufferMask(*attachment)!=GL_COLOR_BUFFER_BIT) return FR_UNSUPPORTED;
+	if(!(attachment->isRenderBuffer ? attachment->renderBuffer.attached : attachment->texture.attached)) return FR_NOT_FOUND;
+
+	GLfloat value[4] = {r, g, b, a};
+	clearAttachment(m_attachments[handle.index], value);
+	return FR_OK;
+}
+
+
+FBO_RESULT FrameBufferObject::clearDepthStencil(AttachmentHandle handle, GLfloat depth, GLint stencil)
+{
+	// handle check
+	const Attachment* attachment = getAttachment(handle);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+	if(getBufferMask(*attachment)==GL_COLOR_BUFFER_BIT) return FR_UNSUPPORTED;
+	if(!(attachment->isRenderBuffer ? attachment->renderBuffer.attached : attachment->texture.attached)) return FR_NOT_FOUND;
+
+	GLfloat value[4] = {depth, (GLfloat)stencil, 0.0f, 0.0f};
+	clearAttachment(m_attachments[handle.index], value);
+	return FR_OK;
 }
 
 
+FBO_RESULT FrameBufferObject::clear(const GLfloat* color, GLfloat depth, GLint stencil)
+{
+	GLfloat depthStencil[4] = {depth, (GLfloat)stencil, 0.0f, 0.0f};
+	for(std::vector<Attachment>::iterator it = m_attachments.begin(); it != m_attachments.end(); ++it)
+	{
+		bool attached = it->isRenderBuffer ? it->renderBuffer.attached : it->texture.attached;
+		if(it->id==0 || !attached) continue;
+
+		if(getBufferMask(*it)!=GL_COLOR_BUFFER_BIT)
+			clearAttachment(*it, depthStencil);
+		else if(color)
+			clearAttachment(*it, color);
+	}
+	return FR_OK;
+}
+
+
+FBO_RESULT FrameBufferObject::setOverwritten(AttachmentHandle handle, bool overwritten)
+{
+	// handle check
+	const Attachment* attachment = getAttachment(handle);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+
+	m_attachments[handle.index].overwritten = overwritten;
+	return FR_OK;
+}
+
+
+bool FrameBufferObject::isOverwritten(AttachmentHandle handle)const
+{
+	const Attachment* attachment = getAttachment(handle);
+	return attachment!=NULL && attachment->overwritten;
+}
+
+
+bool FrameBufferObject::isCleared(AttachmentHandle handle)const
+{
+	const Attachment* attachment = getAttachment(handle);
+	return attachment!=NULL && attachment->cleared;
+}
+
+
+FBO_RESULT FrameBufferObject::resolve(FrameBufferObject& target, AttachmentHandle source, AttachmentHandle destination)
+{
+	const Attachment* src = getAttachment(source);
+	const Attachment* dst = target.getAttachment(destination);
+	if(src==NULL || dst==NULL) return FR_INVALID_HANDLE;
+
+	// only like buffers of the same size can be resolved
+	GLsizei srcWidth, srcHeight, dstWidth, dstHeight;
+	getSize(*src, srcWidth, srcHeight);
+	getSize(*dst, dstWidth, dstHeight);
+	if(getBufferMask(*src)!=getBufferMask(*dst) || srcWidth!=dstWidth || srcHeight!=dstHeight || getSamples(*dst)>0)
+		return FR_UNSUPPORTED;
+
+	blitAttachment(target, *src, *dst, NULL, NULL, GL_NEAREST);
+	target.markWritten(target.m_attachments[destination.index]);
+	return FR_OK;
+}
+
+
+FBO_RESULT FrameBufferObject::resolve(FrameBufferObject& target)
+{
+	// pair the attachments by attachment point
+	FBO_RESULT result = FR_OK;
+	for(unsigned i=0; i<m_attachments.size(); ++i)
+	{
+		const Attachment& src = m_attachments[i];
+		bool attached = src.isRenderBuffer ? src.renderBuffer.attached : src.texture.attached;
+		if(src.id==0 || !attached) continue;
+
+		for(unsigned j=0; j<target.m_attachments.size(); ++j)
+		{
+			const Attachment& dst = target.m_attachments[j];
+			bool dstAttached = dst.isRenderBuffer ? dst.renderBuffer.attached : dst.texture.attached;
+			if(dst.id==0 || !dstAttached || getAttachmentPoint(dst)!=getAttachmentPoint(src)) continue;
+
+			AttachmentHandle srcHandle, dstHandle;
+			srcHandle.index = (unsigned short)i;
+			srcHandle.generation = src.generation;
+			dstHandle.index = (unsigned short)j;
+			dstHandle.generation = dst.generation;
+
+			FBO_RESULT pairResult = resolve(target, srcHandle, dstHandle);
+			if(result==FR_OK) result = pairResult;
+			break;
+		}
+	}
+	return result;
+}
+
+
+FBO_RESULT FrameBufferObject::copy(FrameBufferObject& target, AttachmentHandle source, AttachmentHandle destination, GLenum filter)
+{
+	const Attachment* src = getAttachment(source);
+	const Attachment* dst = target.getAttachment(destination);
+	if(src==NULL || dst==NULL) return FR_INVALID_HANDLE;
+
+	GLsizei srcWidth, srcHeight, dstWidth, dstHeight;
+	getSize(*src, srcWidth, srcHeight);
+	getSize(*dst, dstWidth, dstHeight);
+	return copy(target, source, destination, 0, 0, srcWidth, srcHeight, 0, 0, dstWidth, dstHeight, filter);
+}
+
+
+FBO_RESULT FrameBufferObject::copy(FrameBufferObject& target, AttachmentHandle source, AttachmentHandle destination,
+								   GLint srcX, GLint srcY, GLsizei srcWidth, GLsizei srcHeight,
+								   GLint dstX, GLint dstY, GLsizei dstWidth, GLsizei dstHeight, GLenum filter)
+{
+	const Attachment* src = getAttachment(source);
+	const Attachment* dst = target.getAttachment(destination);
+	if(src==NULL || dst==NULL) return FR_INVALID_HANDLE;
+	if(getBufferMask(*src)!=getBufferMask(*dst)) return FR_UNSUPPORTED;
+
+	GLint srcRect[4] = {srcX, srcY, srcWidth, srcHeight};
+	GLint dstRect[4] = {dstX, dstY, dstWidth, dstHeight};
+
+	// a plain memory copy if the texels can be taken over unchanged
+	bool sameSize = srcWidth==dstWidth && srcHeight==dstHeight;
+	GLenum srcFormat = src->isRenderBuffer ? src->renderBuffer.intFormat : src->texture.intFormat;
+	GLenum dstFormat = dst->isRenderBuffer ? dst->renderBuffer.intFormat : dst->texture.intFormat;
+	if(sameSize && srcFormat==dstFormat && getSamples(*src)==getSamples(*dst) && isCopyImageSupported())
+	{
+		copyImage(*src, *dst, srcRect, dstRect);
+		target.markWritten(target.m_attachments[destination.index]);
+		return FR_OK;
+	}
+
+	// blits can resolve but neither scale samples nor write them
+	if(getSamples(*dst)>0 || (getSamples(*src)>0 && !sameSize)) return FR_UNSUPPORTED;
+
+	blitAttachment(target, *src, *dst, srcRect, dstRect, filter);
+	target.markWritten(target.m_attachments[destination.index]);
+	return FR_OK;
+}
+
+
+bool FrameBufferObject::isCopyImageSupported()
+{
+	return GLEW_VERSION_4_3 || GLEW_ARB_copy_image;
+}
+
+
+static GLint getInteger(GLenum name)
+{
+	GLint value = 0;
+	glGetIntegerv(name, &value);
+	return value;
+}
+
+
+GLsizei FrameBufferObject::getMaxSamples()
+{
+	// the limit is fixed for the lifetime of the context, query once. the
+	// initialization is thread safe, fbos are also built on worker contexts
+	static const GLint maxSamples = getInteger(GL_MAX_SAMPLES);
+	return (GLsizei)maxSamples;
+}
+
+
+void FrameBufferObject::setDrawBuffers(const std::vector<GLuint>& colorSlots)
+{
+	m_drawBuffers.clear();
+	for(std::vector<GLuint>::const_iterator it = colorSlots.begin(); it != colorSlots.end(); ++it)
+	{
+		if(*it>=getMaxColorAttachments())
+		{
+			std::cerr << "Error: draw buffer slot " << *it << " exceeds GL_MAX_COLOR_ATTACHMENTS...\n";
+			continue;
+		}
+		m_drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + *it);
+	}
+
+	m_explicitDrawBuffers = true;
+	applyDrawBuffers();
+}
+
+
+void FrameBufferObject::resetDrawBuffers()
+{
+	m_explicitDrawBuffers = false;
+	applyDrawBuffers();
+}
+
+
+bool FrameBufferObject::isDirectStateAccessEnabled()
+{
+	// GL 4.5 core or the ARB extension, decided once per process
+	if(s_directStateAccess<0)
+		s_directStateAccess = (GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access) ? 1 : 0;
+
+	return s_directStateAccess==1;
+}
+
+
+void FrameBufferObject::enableDirectStateAccess(bool enable)
+{
+	// re-detect so that enabling never selects an unsupported backend
+	s_directStateAccess = -1;
+	if(!enable || !isDirectStateAccessEnabled())
+		s_directStateAccess = 0;
+}
+
+
+GLuint FrameBufferObject::getMaxColorAttachments()
+{
+	// the limit is fixed for the lifetime of the context, query once. the
+	// initialization is thread safe, fbos are also built on worker contexts
+	static const GLint maxColorAttachments = getInteger(GL_MAX_COLOR_ATTACHMENTS);
+	return (GLuint)maxColorAttachments;
+}
+
+
+GLenum FrameBufferObject::getDefaultFormat(TEXTURE_BUFFER_TYPE type)
+{
+	switch(type)
+	{
+		case TBT_DEPTH:				return GL_DEPTH_COMPONENT24;
+		case TBT_STENCIL:			return GL_STENCIL_INDEX8;
+		case TBT_DEPTH_AND_STENCIL:	return GL_DEPTH24_STENCIL8;
+		default:					return GL_RGBA8;
+	}
+}
+
+
+void FrameBufferObject::createReadbackRing(unsigned depth)
+{
+	delete m_readbackRing;
+	m_readbackRing = new ReadbackRing(depth);
+}
+
+
+FBO_RESULT FrameBufferObject::queueReadback(AttachmentHandle handle, GLenum format, GLenum type)
+{
+	const Attachment* attachment = getAttachment(handle);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+
+	// multisampled attachments have to be resolved before they can be read
+	if(getSamples(*attachment)>0) return FR_UNSUPPORTED;
+
+	GLsizei width, height;
+	getSize(*attachment, width, height);
+
+	GLenum readBuffer = getAttachmentPoint(*attachment);
+	GLbitfield mask = getBufferMask(readBuffer);
+	bool isColor = mask==GL_COLOR_BUFFER_BIT;
+
+	// natural client format of the attachment, a packed depth-stencil
+	// buffer attached as depth or stencil only reads that part
+	GLenum naturalFormat, naturalType;
+	getClientFormat(attachment->isRenderBuffer ? attachment->renderBuffer.intFormat : attachment->texture.intFormat, naturalFormat, naturalType);
+	if(mask==GL_DEPTH_BUFFER_BIT)
+	{
+		naturalFormat = GL_DEPTH_COMPONENT;
+		naturalType = GL_FLOAT;
+	}
+	else if(mask==GL_STENCIL_BUFFER_BIT)
+	{
+		naturalFormat = GL_STENCIL_INDEX;
+		naturalType = GL_UNSIGNED_BYTE;
+	}
+
+	if(format==GL_NONE) format = naturalFormat;
+	if(type==GL_NONE) type = naturalType;
+
+	if(m_readbackRing==NULL) createReadbackRing(3);
+
+	// depth and stencil reads ignore the read buffer
+	GLuint fbo = getContextID();
+	if(isDirectStateAccessEnabled())
+	{
+		if(isColor) glNamedFramebufferReadBuffer(fbo, readBuffer);
+		BindingCache::current().bindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+	}
+	else
+	{
+		BindingCache::current().bindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+		if(isColor) glReadBuffer(readBuffer);
+	}
+
+	return m_readbackRing->queue(0, 0, width, height, format, type) ? FR_OK : FR_BUSY;
+}
+
+
+FBO_RESULT FrameBufferObject::queueReadback(const std::string& name, GLenum format, GLenum type)
+{
+	// textures first, then renderbuffers
+	AttachmentHandle handle;
+	if(findTexture(name, handle)!=FR_OK && findRenderBuffer(name, handle)!=FR_OK)
+		return FR_NOT_FOUND;
+
+	return queueReadback(handle, format, type);
+}
+
+
+bool FrameBufferObject::mapReadback(ReadbackFrame& frame, bool wait)
+{
+	if(m_readbackRing==NULL) return false;
+	return m_readbackRing->mapCompleted(frame, wait);
+}
+
+
+void FrameBufferObject::unmapReadback()
+{
+	if(m_readbackRing) m_readbackRing->unmapCompleted();
+}
+
+
+UploadRing* FrameBufferObject::createUploadStream(AttachmentHandle handle, unsigned depth, GLsizeiptr sliceSize)
+{
+	// handle check
+	Attachment* attachment = getAttachment(handle, false);
+	if(attachment==NULL || attachment->texture.type==TT_2D_MULTISAMPLE || attachment->texture.type==TT_1D) return NULL;
+
+	if(sliceSize<=0)
+	{
+		GLenum format, type;
+		GLsizei width, height;
+		getClientFormat(attachment->texture.intFormat, format, type);
+		getSize(*attachment, width, height);
+		sliceSize = (GLsizeiptr)ReadbackRing::getPixelSize(format, type) * width * height;
+	}
+
+	delete attachment->uploadRing;
+	attachment->uploadRing = new UploadRing(depth, sliceSize);
+	return attachment->uploadRing;
+}
+
+
+UploadRing* FrameBufferObject::getUploadStream(AttachmentHandle handle)const
+{
+	const Attachment* attachment = getAttachment(handle);
+	return attachment ? attachment->uploadRing : NULL;
+}
+
+
+FBO_RESULT FrameBufferObject::flushUploads(AttachmentHandle handle)
+{
+	// handle check
+	Attachment* attachment = getAttachment(handle, false);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+	if(attachment->uploadRing==NULL) return FR_NOT_FOUND;
+
+	// a layered attachment takes the updates into its first layer
+	const TextureBufferFormat& tbf = attachment->texture;
+	GLint layer = tbf.layer==ALL_LAYERS ? 0 : tbf.layer;
+	if(attachment->uploadRing->submit(attachment->id, getTextureTarget(tbf.type), tbf.level, layer)>0)
+		markWritten(*attachment);
+	return FR_OK;
+}
+
+
+void FrameBufferObject::flushUploads()
+{
+	for(unsigned i=0; i<m_attachments.size(); ++i)
+	{
+		if(m_attachments[i].id==0 || m_attachments[i].uploadRing==NULL) continue;
+
+		AttachmentHandle handle;
+		handle.index = (unsigned short)i;
+		handle.generation = m_attachments[i].generation;
+		flushUploads(handle);
+	}
+}
+
+
+void FrameBufferObject::createTimerQueryRing(unsigned depth, unsigned window)
+{
+	delete m_timerQueryRing;
+	m_timerQueryRing = new TimerQueryRing(depth, window);
+}
+
+
+FBO_RESULT FrameBufferObject::beginTiming()
+{
+	if(!TimerQueryRing::isSupported()) return FR_UNSUPPORTED;
+
+	// a few frames of latency before a result is waited for
+	if(m_timerQueryRing==NULL) createTimerQueryRing(4);
+	return m_timerQueryRing->begin() ? FR_OK : FR_BUSY;
+}
+
+
+FBO_RESULT FrameBufferObject::endTiming()
+{
+	if(m_timerQueryRing==NULL) return FR_NOT_FOUND;
+
+	m_timerQueryRing->end();
+	return FR_OK;
+}
+
+
+FBO_RESULT FrameBufferObject::getTimingStatistics(TimingStatistics& statistics)
+{
+	if(m_timerQueryRing==NULL) return FR_NOT_FOUND;
+
+	m_timerQueryRing->collect();
+	m_timerQueryRing->getStatistics(statistics);
+	return FR_OK;
+}
+
+
+void FrameBufferObject::writeTimingCSV(std::ostream& out, const std::string& label)
+{
+	if(m_timerQueryRing==NULL) return;
+
+	m_timerQueryRing->collect();
+	m_timerQueryRing->writeCSV(out, label);
+}
+
+
+bool FrameBufferObject::isComplete()
+{
+	return getStatus()==GL_FRAMEBUFFER_COMPLETE;
+}
+
+
+GLenum FrameBufferObject::getStatus()
+{
+	// the hash only narrows the search, a collision must not return the
+	// status of another configuration
+	std::vector<unsigned long> configuration;
+	unsigned long hash = getConfiguration(configuration);
+	std::map<unsigned long, CachedStatus>::const_iterator it = m_statusCache.find(hash);
+	if(it!=m_statusCache.end() && it->second.configuration==configuration) return it->second.status;
+
+	// a new configuration, ask the driver once
+	GLenum status;
+	if(isDirectStateAccessEnabled())
+		status = glCheckNamedFramebufferStatus(getContextID(), getTarget());
+	else
+	{
+		bindToEdit();
+		status = glCheckFramebufferStatus(getTarget());
+	}
+
+	if(status!=GL_FRAMEBUFFER_COMPLETE) diagnoseStatus(status);
+
+	// configurations are few, a runaway cache means they never repeat
+	if(m_statusCache.size()>=64) m_statusCache.clear();
+	CachedStatus& cached = m_statusCache[hash];
+	cached.configuration.swap(configuration);
+	cached.status = status;
+	return status;
+}
+
+
+const char* FrameBufferObject::getStatusString(GLenum status)
+{
+	switch(status)
+	{
+		case GL_FRAMEBUFFER_COMPLETE:						return "GL_FRAMEBUFFER_COMPLETE";
+		case GL_FRAMEBUFFER_UNDEFINED:						return "GL_FRAMEBUFFER_UNDEFINED";
+		case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:			return "GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT";
+		case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:	return "GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT";
+		case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER:			return "GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER";
+		case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER:			return "GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER";
+		case GL_FRAMEBUFFER_UNSUPPORTED:					return "GL_FRAMEBUFFER_UNSUPPORTED";
+		case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE:			return "GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE";
+		case GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS:		return "GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS";
+		default:											return "unknown framebuffer status";
+	}
+}
+
+
+FBO_RESULT FrameBufferObject::publish()
+{
+	// without sync objects the work is finished before the hand-over
+	if(!(GLEW_VERSION_3_2 || GLEW_ARB_sync))
+	{
+		glFinish();
+		return FR_OK;
+	}
+
+	std::lock_guard<std::mutex> lock(m_contextMutex);
+	if(m_publishFence) glDeleteSync(m_publishFence);
+	m_publishFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_publishContext = BindingCache::currentContext();
+	++m_publishSerial;
+
+	// other contexts can only wait for a fence that reached the GPU
+	glFlush();
+	return FR_OK;
+}
+
+
+void FrameBufferObject::releaseOrphanedFramebuffers()
+{
+	const void* context = BindingCache::currentContext();
+
+	std::lock_guard<std::mutex> lock(s_orphanMutex);
+	std::map<const void*, std::vector<GLuint> >::iterator it = s_orphanedFramebuffers.find(context);
+	if(it==s_orphanedFramebuffers.end()) return;
+
+	std::vector<GLuint>& ids = it->second;
+	glDeleteFramebuffers((GLsizei)ids.size(), &ids[0]);
+	for(std::vector<GLuint>::const_iterator id = ids.begin(); id != ids.end(); ++id)
+		BindingCache::current().onFramebufferDeleted(*id);
+	s_orphanedFramebuffers.erase(it);
+}
+
+
+GLuint FrameBufferObject::getID() const
+{
+	return m_Id;
+}
+
+GLuint FrameBufferObject::getContextID()
+{
+	// the creating context takes the fast path
+	const void* context = BindingCache::currentContext();
+	if(context==m_context)
+	{
+		syncContext(context, m_ownerSerial, m_ownerFenceSerial);
+		return m_Id;
+	}
+
+	ContextFramebuffer* framebuffer;
+	{
+		std::lock_guard<std::mutex> lock(m_contextMutex);
+		std::map<const void*, ContextFramebuffer>::iterator it = m_contextFramebuffers.find(context);
+		if(it==m_contextFramebuffers.end())
+		{
+			// first use on this context, the new fbo is rebuilt below
+			ContextFramebuffer created;
+			created.id = 0;
+			created.serial = m_serial - 1;
+			created.fenceSerial = 0;
+			it = m_contextFramebuffers.insert(std::make_pair(context, created)).first;
+		}
+		framebuffer = &it->second;
+	}
+
+	// map entries stay in place, the lock is not held while rebuilding
+	// since that resolves the id again
+	if(framebuffer->id==0)
+	{
+		releaseOrphanedFramebuffers();
+		framebuffer->id = createFramebuffer();
+	}
+	syncContext(context, framebuffer->serial, framebuffer->fenceSerial);
+	return framebuffer->id;
+}
+
+GLuint FrameBufferObject::getAttachmentID(AttachmentHandle handle)const
+{
+	const Attachment* attachment = getAttachment(handle);
+	return attachment ? attachment->id : 0;
+}
+
+FBO_RESULT FrameBufferObject::getAttachmentSize(AttachmentHandle handle, GLsizei& width, GLsizei& height)const
+{
+	const Attachment* attachment = getAttachment(handle);
+	if(attachment==NULL) return FR_INVALID_HANDLE;
+
+	getSize(*attachment, width, height);
+	return FR_OK;
+}
+
+GLenum FrameBufferObject::getAttachmentFormat(AttachmentHandle handle)const
+{
+	const Attachment* attachment = getAttachment(handle);
+	if(attachment==NULL) return GL_NONE;
+
+	return attachment->isRenderBuffer ? attachment->renderBuffer.intFormat : attachment->texture.intFormat;
+}
+
+GLsizei FrameBufferObject::getNumLevels(AttachmentHandle handle)const
+{
+	const Attachment* attachment = getAttachment(handle);
+	if(attachment==NULL) return 0;
+	return attachment->isRenderBuffer ? 1 : attachment->texture.levels;
+}
+
+
+BUFFER_TARGET_MODE FrameBufferObject::getBufferTargetMode()const
+{
+	return m_BufferTargetMode;
+}
+
+const std::vector<GLenum>& FrameBufferObject::getDrawBuffers()const
+{
+	return m_drawBuffers;
+}
+
+bool FrameBufferObject::isUsed()const
+{
+	return GL_TRUE == glIsFramebuffer(m_Id) ? true : false;
+}
+
+
+unsigned FrameBufferObject::getNumRenderbuffers() const
+{
+	return m_numRenderbuffers;
+}
+
+
+unsigned FrameBufferObject::getNumAttachedTexturebuffers() const
+{
+	return m_numTexturebuffers;
+}
+
+
+const GLuint FrameBufferObject::getRenderBufferID(const std::string& name)const 
+{
+	// name check
+	AttachmentHandle handle;
+	if(findRenderBuffer(name, handle)!=FR_OK) return 0;
+
+	return getAttachmentID(handle);
+}
+
+
+const GLuint FrameBufferObject::getTextureBufferID(const std::string& name)const
+{
+	// name check
+	AttachmentHandle handle;
+	if(findTexture(name, handle)!=FR_OK) return 0;
+
+	return getAttachmentID(handle);
+}
+
+void FrameBufferObject::bind()
+{
+	BindingCache::current().bindFramebuffer(getTarget(), getContextID());
+	m_drawing = m_BufferTargetMode!=BTM_READ;
+
+	// whatever is rendered next invalidates the lower levels
+	if((m_numAutoMipmaps>0 || m_numCleared>0) && m_BufferTargetMode!=BTM_READ) markDrawBuffersWritten();
+}
+
+
+void FrameBufferObject::bindToEdit()
+{
+	BindingCache::current().bindFramebuffer(getTarget(), getContextID());
+}
+
+
+void FrameBufferObject::switchToDefaultSystemBuffers()
+{
+	if(m_invalidateOnUnbind) invalidate();
+	BindingCache::current().bindFramebuffer(getTarget(), 0);
+	m_drawing = false;
+}
+
+
+GLenum FrameBufferObject::getTarget()const
+{
+	GLenum target;
+	switch(m_BufferTargetMode)
+	{
+		case BTM_READ:		 target = GL_READ_FRAMEBUFFER; break;
+		case BTM_WRITE:		 target = GL_DRAW_FRAMEBUFFER; break;
+		case BTM_READ_WRITE: target = GL_FRAMEBUFFER; break;
+		default:			 target = GL_FRAMEBUFFER; break;
+	}
+	return target;
+}
+
+
+GLenum FrameBufferObject::getAttachmentPoint(RBUFFER_TYPE type, GLuint colorSlot)
+{
+	GLenum attachmentType;
+	switch(type)
+	{
+		case RBT_COLOR: attachmentType=GL_COLOR_ATTACHMENT0 + colorSlot;break;
+		case RBT_DEPTH: attachmentType=GL_DEPTH_ATTACHMENT;break;
+		case RBT_STENCIL: attachmentType=GL_STENCIL_ATTACHMENT;break;
+		case RBT_DEPTH_AND_STENCIL: attachmentType=GL_DEPTH_STENCIL_ATTACHMENT;break;
+		default: attachmentType=GL_COLOR_ATTACHMENT0 + colorSlot;break;
+	}
+	return attachmentType;
+}
+
+
+GLenum FrameBufferObject::getAttachmentPoint(TEXTURE_BUFFER_TYPE type, GLuint colorSlot)
+{
+	GLenum attachmentType;
+	switch(type)
+	{
+		case TBT_COLOR: attachmentType=GL_COLOR_ATTACHMENT0 + colorSlot;break;
+		case TBT_DEPTH: attachmentType=GL_DEPTH_ATTACHMENT;break;
+		case TBT_STENCIL: attachmentType=GL_STENCIL_ATTACHMENT;break;
+		case TBT_DEPTH_AND_STENCIL: attachmentType=GL_DEPTH_STENCIL_ATTACHMENT;break;
+		default: attachmentType=GL_COLOR_ATTACHMENT0 + colorSlot;break;
+	}
+	return attachmentType;
+}
+
+
+GLbitfield FrameBufferObject::getFormatMask(GLenum intFormat)
+{
+	switch(intFormat)
+	{
+		case GL_DEPTH_COMPONENT:
+		case GL_DEPTH_COMPONENT16:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32:
+		case GL_DEPTH_COMPONENT32F:		return GL_DEPTH_BUFFER_BIT;
+		case GL_DEPTH_STENCIL:
+		case GL_DEPTH24_STENCIL8:
+		case GL_DEPTH32F_STENCIL8:		return GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT;
+		case GL_STENCIL_INDEX:
+		case GL_STENCIL_INDEX1:
+		case GL_STENCIL_INDEX4:
+		case GL_STENCIL_INDEX8:
+		case GL_STENCIL_INDEX16:		return GL_STENCIL_BUFFER_BIT;
+		default:						return GL_COLOR_BUFFER_BIT;
+	}
+}
+
+
+void FrameBufferObject::getClientFormat(GLenum intFormat, GLenum& format, GLenum& type)
+{
+	switch(getFormatMask(intFormat))
+	{
+		case GL_DEPTH_BUFFER_BIT:
+			format = GL_DEPTH_COMPONENT;
+			type = GL_FLOAT;
+			return;
+		case GL_STENCIL_BUFFER_BIT:
+			format = GL_STENCIL_INDEX;
+			type = GL_UNSIGNED_BYTE;
+			return;
+		case GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT:
+			format = GL_DEPTH_STENCIL;
+			type = intFormat==GL_DEPTH32F_STENCIL8 ? GL_FLOAT_32_UNSIGNED_INT_24_8_REV : GL_UNSIGNED_INT_24_8;
+			return;
+	}
+
+	// integer color formats only transfer through the *_INTEGER formats
+	switch(intFormat)
+	{
+		case GL_R8UI: case GL_R16UI: case GL_R32UI:
+		case GL_RG8UI: case GL_RG16UI: case GL_RG32UI:
+		case GL_RGBA8UI: case GL_RGBA16UI: case GL_RGBA32UI: case GL_RGB10_A2UI:
+			format = GL_RGBA_INTEGER;
+			type = GL_UNSIGNED_INT;
+			return;
+		case GL_R8I: case GL_R16I: case GL_R32I:
+		case GL_RG8I: case GL_RG16I: case GL_RG32I:
+		case GL_RGBA8I: case GL_RGBA16I: case GL_RGBA32I:
+			format = GL_RGBA_INTEGER;
+			type = GL_INT;
+			return;
+		default:
+			format = GL_RGBA;
+			type = GL_UNSIGNED_BYTE;
+			return;
+	}
+}
+
+
+bool FrameBufferObject::checkFormat(const std::string& name, GLenum attachmentPoint, GLenum intFormat)
+{
+	// a packed depth-stencil format may back a depth-only or stencil-only
+	// attachment, every other combination must match exactly
+	GLbitfield required = getBufferMask(attachmentPoint);
+	if((getFormatMask(intFormat) & required)==required) return true;
+
+	std::cerr << "Error: internal format 0x" << std::hex << intFormat << std::dec << " of " << name << " does not fit its attachment point...\n";
+	return false;
+}
+
+
+bool FrameBufferObject::checkTextureFormat(const std::string& name, GLenum intFormat)
+{
+	// immutable storage takes sized formats only
+	bool immutable = isDirectStateAccessEnabled() || GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+	if(immutable && !isSizedFormat(intFormat))
+	{
+		std::cerr << "Error: internal format 0x" << std::hex << intFormat << std::dec << " of " << name << " texture is not sized...\n";
+		return false;
+	}
+
+	// stencil-only textures came with GL 4.4
+	if(getFormatMask(intFormat)==GL_STENCIL_BUFFER_BIT && !GLEW_VERSION_4_4 && !GLEW_ARB_texture_stencil8)
+	{
+		std::cerr << "Error: stencil texture " << name << " needs GL 4.4 or ARB_texture_stencil8...\n";
+		return false;
+	}
+	return true;
+}
+
+
+bool FrameBufferObject::isSizedFormat(GLenum intFormat)
+{
+	switch(intFormat)
+	{
+		case GL_NONE:
+		case GL_RED:
+		case GL_RG:
+		case GL_RGB:
+		case GL_RGBA:
+		case GL_DEPTH_COMPONENT:
+		case GL_DEPTH_STENCIL:
+		case GL_STENCIL_INDEX:			return false;
+		default:						return true;
+	}
+}
+
+
+bool FrameBufferObject::useColorSlot(GLuint colorSlot)
+{
+	// range check against the implementation limit
+	if(colorSlot>=getMaxColorAttachments())
+	{
+		std::cerr << "Error: color slot " << colorSlot << " exceeds GL_MAX_COLOR_ATTACHMENTS...\n";
+		return false;
+	}
+
+	// the previous attachment of the slot was detached by detachAttachmentsAt()
+	m_colorSlots.insert(colorSlot);
+	return true;
+}
+
+
+void FrameBufferObject::detachAttachmentsAt(GLenum attachmentPoint, int keepIndex)
+{
+	// a depth-stencil attachment also occupies the depth and stencil points
+	GLbitfield mask = getBufferMask(attachmentPoint);
+	for(std::vector<Attachment>::iterator it = m_attachments.begin(); it != m_attachments.end(); ++it)
+	{
+		if(it->id==0 || it - m_attachments.begin()==keepIndex) continue;
+		bool attached = it->isRenderBuffer ? it->renderBuffer.attached : it->texture.attached;
+		if(!attached) continue;
+
+		GLenum point = getAttachmentPoint(*it);
+		if(point!=attachmentPoint && (mask==GL_COLOR_BUFFER_BIT || !(getBufferMask(point) & mask))) continue;
+
+		AttachmentHandle handle;
+		handle.index = (unsigned short)(it - m_attachments.begin());
+		handle.generation = it->generation;
+		if(it->isRenderBuffer)
+			detachRenderBuffer(handle);
+		else
+			detachTexture(handle);
+	}
+}
+
+
+void FrameBufferObject::releaseColorSlot(GLuint colorSlot)
+{
+	m_colorSlots.erase(colorSlot);
+}
+
+
+void FrameBufferObject::applyDrawBuffers()
+{
+	// derive the draw buffers from the attached color slots
+	// unless the client has set them explicitly
+	if(!m_explicitDrawBuffers)
+	{
+		m_drawBuffers.clear();
+		for(std::set<GLuint>::const_iterator it = m_colorSlots.begin(); it != m_colorSlots.end(); ++it)
+			m_drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + *it);
+	}
+
+	// draw buffer state belongs to the fbo, read-only fbos do not need it
+	if(m_BufferTargetMode==BTM_READ) return;
+
+	if(isDirectStateAccessEnabled())
+	{
+		if(m_drawBuffers.empty())
+			glNamedFramebufferDrawBuffer(getContextID(), GL_NONE);
+		else
+			glNamedFramebufferDrawBuffers(getContextID(), (GLsizei)m_drawBuffers.size(), &m_drawBuffers[0]);
+		return;
+	}
+
+	BindingCache::current().bindFramebuffer(GL_DRAW_FRAMEBUFFER, getContextID());
+	if(m_drawBuffers.empty())
+		glDrawBuffer(GL_NONE);
+	else
+		glDrawBuffers((GLsizei)m_drawBuffers.size(), &m_drawBuffers[0]);
+}
+
+
+AttachmentHandle FrameBufferObject::addAttachment(GLuint id, bool isRenderBuffer)
+{
+	// reuse a free entry, the bumped generation invalidates old handles to it
+	unsigned short index;
+	if(!m_freeAttachments.empty())
+	{
+		index = m_freeAttachments.back();
+		m_freeAttachments.pop_back();
+	}
+	else
+	{
+		index = (unsigned short)m_attachments.size();
+		Attachment unused;
+		unused.id = 0;
+		unused.generation = 0;
+		m_attachments.push_back(unused);
+	}
+
+	Attachment& attachment = m_attachments[index];
+	attachment.id = id;
+	attachment.isRenderBuffer = isRenderBuffer;
+	attachment.transient = false;
+	attachment.external = false;
+	attachment.autoMipmap = false;
+	attachment.mipmapStale = false;
+	attachment.uploadRing = NULL;
+	attachment.overwritten = false;
+	attachment.cleared = false;
+	if(++attachment.generation==0) attachment.generation = 1;
+
+	if(isRenderBuffer) ++m_numRenderbuffers; else ++m_numTexturebuffers;
+
+	AttachmentHandle handle;
+	handle.index = index;
+	handle.generation = attachment.generation;
+	return handle;
+}
+
+
+void FrameBufferObject::removeAttachment(AttachmentHandle handle)
+{
+	Attachment& attachment = m_attachments[handle.index];
+	if(attachment.isRenderBuffer) --m_numRenderbuffers; else --m_numTexturebuffers;
+	if(attachment.autoMipmap) --m_numAutoMipmaps;
+	setCleared(attachment, false);
+	delete attachment.uploadRing;
+	attachment.uploadRing = NULL;
+
+	attachment.id = 0;
+	m_freeAttachments.push_back(handle.index);
+}
+
+
+FrameBufferObject::Attachment* FrameBufferObject::getAttachment(AttachmentHandle handle, bool isRenderBuffer)
+{
+	if(handle.index>=m_attachments.size()) return NULL;
+
+	Attachment& attachment = m_attachments[handle.index];
+	if(attachment.id==0 || attachment.generation!=handle.generation || attachment.isRenderBuffer!=isRenderBuffer)
+		return NULL;
+
+	return &attachment;
+}
+
+
+const FrameBufferObject::Attachment* FrameBufferObject::getAttachment(AttachmentHandle handle)const
+{
+	if(handle.index>=m_attachments.size()) return NULL;
+
+	const Attachment& attachment = m_attachments[handle.index];
+	if(attachment.id==0 || attachment.generation!=handle.generation)
+		return NULL;
+
+	return &attachment;
+}
+
+
+GLenum FrameBufferObject::getAttachmentPoint(const Attachment& attachment)
+{
+	if(attachment.isRenderBuffer)
+		return getAttachmentPoint(attachment.renderBuffer.bufferType, attachment.renderBuffer.colorSlot);
+	else
+		return getAttachmentPoint(attachment.texture.attachmentPoint, attachment.texture.colorSlot);
+}
+
+
+GLbitfield FrameBufferObject::getBufferMask(GLenum attachmentPoint)
+{
+	switch(attachmentPoint)
+	{
+		case GL_DEPTH_ATTACHMENT:			return GL_DEPTH_BUFFER_BIT;
+		case GL_STENCIL_ATTACHMENT:			return GL_STENCIL_BUFFER_BIT;
+		case GL_DEPTH_STENCIL_ATTACHMENT:	return GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT;
+		default:							return GL_COLOR_BUFFER_BIT;
+	}
+}
+
+
+GLbitfield FrameBufferObject::getBufferMask(const Attachment& attachment)
+{
+	return getBufferMask(getAttachmentPoint(attachment));
+}
+
+
+GLsizei FrameBufferObject::getSamples(const Attachment& attachment)
+{
+	return attachment.isRenderBuffer ? attachment.renderBuffer.samples : attachment.texture.samples;
+}
+
+
+void FrameBufferObject::getSize(const Attachment& attachment, GLsizei& width, GLsizei& height)
+{
+	if(attachment.isRenderBuffer)
+	{
+		width = attachment.renderBuffer.width;
+		height = attachment.renderBuffer.height;
+	}
+	else
+	{
+		// the attached mip level
+		const TextureBufferFormat& tbf = attachment.texture;
+		width = std::max(tbf.width >> tbf.level, 1);
+		height = tbf.type==TT_1D ? 1 : std::max(tbf.height >> tbf.level, 1);
+	}
+}
+
+
+GLsizei FrameBufferObject::getLevelCount(GLsizei numLevels, GLint level, GLsizei width, GLsizei height, GLsizei depth)
+{
+	// levels down to 1x1, a level beyond them has no storage
+	GLsizei size = std::max(width, std::max(height, depth));
+	GLsizei maxLevels = 1;
+	while((size >> maxLevels)>0)
+		++maxLevels;
+
+	if(numLevels==FULL_MIP_CHAIN) return maxLevels;
+	return std::min(std::max(numLevels, level+1), maxLevels);
+}
+
+
+bool FrameBufferObject::isDrawBufferReachable(const Attachment& attachment)const
+{
+	bool attached = attachment.isRenderBuffer ? attachment.renderBuffer.attached : attachment.texture.attached;
+	if(attachment.id==0 || !attached) return false;
+
+	// depth and stencil are always reachable, colors only through a draw buffer
+	GLenum attachmentPoint = getAttachmentPoint(attachment);
+	if(getBufferMask(attachmentPoint)!=GL_COLOR_BUFFER_BIT) return true;
+	return std::find(m_drawBuffers.begin(), m_drawBuffers.end(), attachmentPoint)!=m_drawBuffers.end();
+}
+
+
+void FrameBufferObject::markDrawBuffersWritten()
+{
+	for(std::vector<Attachment>::iterator it = m_attachments.begin(); it != m_attachments.end(); ++it)
+	{
+		if(isDrawBufferReachable(*it)) markWritten(*it);
+	}
+}
+
+
+void FrameBufferObject::markWritten(Attachment& attachment)
+{
+	setCleared(attachment, false);
+
+	// lower levels rendered directly are not overwritten
+	if(!attachment.isRenderBuffer && attachment.autoMipmap && attachment.texture.level==0) attachment.mipmapStale = true;
+}
+
+
+void FrameBufferObject::setCleared(Attachment& attachment, bool cleared)
+{
+	if(attachment.cleared==cleared) return;
+	attachment.cleared = cleared;
+	if(cleared) ++m_numCleared; else --m_numCleared;
+}
+
+
+void FrameBufferObject::clearAttachment(Attachment& attachment, const GLfloat* value)
+{
+	GLenum attachmentPoint = getAttachmentPoint(attachment);
+	GLbitfield mask = getBufferMask(attachmentPoint);
+
+	// the next pass writes every pixel, the driver only has to forget the old ones
+	if(attachment.overwritten)
+	{
+		std::vector<GLenum> attachmentPoints(1, attachmentPoint);
+		invalidateAttachments(attachmentPoints, NULL);
+		setCleared(attachment, false);
+		return;
+	}
+
+	unsigned numValues = mask==GL_COLOR_BUFFER_BIT ? 4 : 2;
+	if(attachment.cleared && std::equal(value, value+numValues, attachment.clearValue)) return;
+
+	// glClearBuffer addresses color buffers by draw buffer index, colors
+	// outside the draw buffers are routed through index 0 for the clear
+	GLint drawBuffer = 0;
+	bool reroute = false;
+	if(mask==GL_COLOR_BUFFER_BIT)
+	{
+		std::vector<GLenum>::const_iterator it = std::find(m_drawBuffers.begin(), m_drawBuffers.end(), attachmentPoint);
+		reroute = m_BufferTargetMode==BTM_READ || it==m_drawBuffers.end();
+		if(!reroute) drawBuffer = (GLint)(it - m_drawBuffers.begin());
+	}
+
+	// draws into an fbo bound with bind() right now cannot be seen, so the
+	// clear is only remembered for buffers no draw can reach
+	GLuint fbo = getContextID();
+	bool drawing = m_drawing && BindingCache::current().getFramebuffer(GL_DRAW_FRAMEBUFFER)==fbo;
+	bool remember = !(drawing && isDrawBufferReachable(attachment));
+
+	GLenum format, type;
+	getClientFormat(attachment.isRenderBuffer ? attachment.renderBuffer.intFormat : attachment.texture.intFormat, format, type);
+	GLint integerValue[4] = {(GLint)value[0], (GLint)value[1], (GLint)value[2], (GLint)value[3]};
+	GLuint unsignedValue[4] = {(GLuint)value[0], (GLuint)value[1], (GLuint)value[2], (GLuint)value[3]};
+
+	if(isDirectStateAccessEnabled())
+	{
+		if(reroute) glNamedFramebufferDrawBuffer(fbo, attachmentPoint);
+		switch(mask)
+		{
+			case GL_DEPTH_BUFFER_BIT: glClearNamedFramebufferfv(fbo, GL_DEPTH, 0, &value[0]); break;
+			case GL_STENCIL_BUFFER_BIT: glClearNamedFramebufferiv(fbo, GL_STENCIL, 0, &integerValue[1]); break;
+			case GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT: glClearNamedFramebufferfi(fbo, GL_DEPTH_STENCIL, 0, value[0], integerValue[1]); break;
+			default:
+				if(type==GL_INT) glClearNamedFramebufferiv(fbo, GL_COLOR, drawBuffer, integerValue);
+				else if(type==GL_UNSIGNED_INT) glClearNamedFramebufferuiv(fbo, GL_COLOR, drawBuffer, unsignedValue);
+				else glClearNamedFramebufferfv(fbo, GL_COLOR, drawBuffer, value);
+				break;
+		}
+	}
+	else
+	{
+		BindingCache::current().bindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+		if(reroute) glDrawBuffer(attachmentPoint);
+		switch(mask)
+		{
+			case GL_DEPTH_BUFFER_BIT: glClearBufferfv(GL_DEPTH, 0, &value[0]); break;
+			case GL_STENCIL_BUFFER_BIT: glClearBufferiv(GL_STENCIL, 0, &integerValue[1]); break;
+			case GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT: glClearBufferfi(GL_DEPTH_STENCIL, 0, value[0], integerValue[1]); break;
+			default:
+				if(type==GL_INT) glClearBufferiv(GL_COLOR, drawBuffer, integerValue);
+				else if(type==GL_UNSIGNED_INT) glClearBufferuiv(GL_COLOR, drawBuffer, unsignedValue);
+				else glClearBufferfv(GL_COLOR, drawBuffer, value);
+				break;
+		}
+	}
+	if(reroute)
+	{
+		// applyDrawBuffers() leaves read-only fbos alone, they get the
+		// initial draw buffer back
+		if(m_BufferTargetMode!=BTM_READ)
+			applyDrawBuffers();
+		else if(isDirectStateAccessEnabled())
+			glNamedFramebufferDrawBuffer(fbo, GL_COLOR_ATTACHMENT0);
+		else
+			glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	}
+
+	// other fbos draw into external textures behind our back
+	std::copy(value, value+numValues, attachment.clearValue);
+	setCleared(attachment, remember && !attachment.external);
+}
+
+
+// one FNV-1a step
+static inline unsigned long hashValue(unsigned long hash, unsigned long value)
+{
+	return (hash ^ value) * 16777619UL;
+}
+
+
+unsigned long FrameBufferObject::getConfiguration(std::vector<unsigned long>& configuration)const
+{
+	// everything the driver validates, names are recycled by GL so
+	// formats and sizes are part of the key
+	configuration.clear();
+
+	for(std::vector<Attachment>::const_iterator it = m_attachments.begin(); it != m_attachments.end(); ++it)
+	{
+		if(it->id==0) continue;
+		if(it->isRenderBuffer)
+		{
+			const RenderBufferFormat& bf = it->renderBuffer;
+			if(!bf.attached) continue;
+			configuration.push_back(GL_RENDERBUFFER);
+			configuration.push_back(it->id);
+			configuration.push_back(getAttachmentPoint(*it));
+			configuration.push_back(bf.intFormat);
+			configuration.push_back(bf.width);
+			configuration.push_back(bf.height);
+			configuration.push_back(bf.samples);
+		}
+		else
+		{
+			const TextureBufferFormat& tbf = it->texture;
+			if(!tbf.attached) continue;
+			configuration.push_back(GL_TEXTURE);
+			configuration.push_back(it->id);
+			configuration.push_back(getAttachmentPoint(*it));
+			configuration.push_back(tbf.intFormat);
+			configuration.push_back(tbf.type);
+			configuration.push_back(tbf.width);
+			configuration.push_back(tbf.height);
+			configuration.push_back(tbf.depth);
+			configuration.push_back(tbf.samples);
+			configuration.push_back(tbf.level);
+			configuration.push_back(tbf.levels);
+			configuration.push_back(tbf.layer);
+		}
+	}
+
+	for(std::vector<GLenum>::const_iterator it = m_drawBuffers.begin(); it != m_drawBuffers.end(); ++it)
+		configuration.push_back(*it);
+
+	unsigned long hash = 2166136261UL;
+	for(std::vector<unsigned long>::const_iterator it = configuration.begin(); it != configuration.end(); ++it)
+		hash = hashValue(hash, *it);
+	return hash;
+}
+
+
+std::string FrameBufferObject::getAttachmentName(unsigned index)const
+{
+	// reverse lookup, only used for diagnostics
+	std::map<std::string, AttachmentHandle>::const_iterator it;
+	for(it = m_renderBufferNames.begin(); it != m_renderBufferNames.end(); ++it)
+	{
+		if(it->second.index==index && it->second.generation==m_attachments[index].generation) return it->first;
+	}
+	for(it = m_attachedTextureNames.begin(); it != m_attachedTextureNames.end(); ++it)
+	{
+		if(it->second.index==index && it->second.generation==m_attachments[index].generation) return it->first;
+	}
+	return "<unnamed>";
+}
+
+
+void FrameBufferObject::diagnoseStatus(GLenum status)const
+{
+	std::cerr << "Error: fbo " << m_Id << " is incomplete, " << getStatusString(status) << "...\n";
+
+	// the first attached buffer is the reference for samples and layering
+	const Attachment* reference = NULL;
+	for(unsigned i=0; i<m_attachments.size(); ++i)
+	{
+		const Attachment& attachment = m_attachments[i];
+		bool attached = attachment.isRenderBuffer ? attachment.renderBuffer.attached : attachment.texture.attached;
+		if(attachment.id==0 || !attached) continue;
+		if(reference==NULL) reference = &attachment;
+
+		GLsizei width, height;
+		getSize(attachment, width, height);
+		bool layered = !attachment.isRenderBuffer && attachment.texture.layer==ALL_LAYERS;
+		bool referenceLayered = !reference->isRenderBuffer && reference->texture.layer==ALL_LAYERS;
+
+		const char* reason = NULL;
+		switch(status)
+		{
+			case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:
+				if(width<=0 || height<=0) reason = "has zero size";
+				else if(!attachment.isRenderBuffer && attachment.texture.level>=attachment.texture.levels) reason = "is attached at a level without storage";
+				break;
+			case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE:
+				if(getSamples(attachment)!=getSamples(*reference)) reason = "has a different sample count";
+				break;
+			case GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS:
+				if(layered!=referenceLayered) reason = "mixes layered and single layer attachment";
+				break;
+			case GL_FRAMEBUFFER_UNSUPPORTED:
+				reason = "may use an unsupported format combination";
+				break;
+		}
+
+		if(reason)
+			std::cerr << "  attachment " << getAttachmentName(i) << " (0x" << std::hex << getAttachmentPoint(attachment) << std::dec << ") " << reason << "\n";
+	}
+
+	// draw buffers that point at empty attachment points
+	if(status==GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER)
+	{
+		for(std::vector<GLenum>::const_iterator it = m_drawBuffers.begin(); it != m_drawBuffers.end(); ++it)
+		{
+			if(m_colorSlots.count(*it - GL_COLOR_ATTACHMENT0)==0)
+				std::cerr << "  draw buffer GL_COLOR_ATTACHMENT" << *it - GL_COLOR_ATTACHMENT0 << " has no attachment\n";
+		}
+	}
+	if(reference==NULL)
+		std::cerr << "  no buffer is attached\n";
+}
+
+
+void FrameBufferObject::attachTextureLayer(GLuint id, const TextureBufferFormat& tbf)
+{
+	GLenum attachmentType = getAttachmentPoint(tbf.attachmentPoint, tbf.colorSlot);
+
+	// the whole texture, every layer is addressable from one pass
+	if(tbf.layer==ALL_LAYERS)
+	{
+		if(isDirectStateAccessEnabled())
+			glNamedFramebufferTexture(getContextID(), attachmentType, id, tbf.level);
+		else
+		{
+			bindToEdit();
+			glFramebufferTexture(getTarget(), attachmentType, id, tbf.level);
+		}
+		return;
+	}
+
+	// a single layer, cube map faces count as layers under dsa
+	if(isDirectStateAccessEnabled())
+	{
+		glNamedFramebufferTextureLayer(getContextID(), attachmentType, id, tbf.level, tbf.layer);
+		return;
+	}
+
+	bindToEdit();
+	switch(tbf.type)
+	{
+		case TT_3D: glFramebufferTexture3D(getTarget(), attachmentType, GL_TEXTURE_3D, id, tbf.level, tbf.layer); break;
+		case TT_CUBE_MAP: glFramebufferTexture2D(getTarget(), attachmentType, GL_TEXTURE_CUBE_MAP_POSITIVE_X + tbf.layer, id, tbf.level); break;
+		default: glFramebufferTextureLayer(getTarget(), attachmentType, id, tbf.level, tbf.layer); break;
+	}
+}
+
+
+void FrameBufferObject::attachToFramebuffer(const Attachment& attachment)
+{
+	GLenum target = getTarget();
+	GLenum attachmentType = getAttachmentPoint(attachment);
+
+	if(attachment.isRenderBuffer)
+	{
+		if(isDirectStateAccessEnabled())
+			glNamedFramebufferRenderbuffer(getContextID(), attachmentType, GL_RENDERBUFFER, attachment.id);
+		else
+		{
+			bindToEdit();
+			glFramebufferRenderbuffer(target, attachmentType, GL_RENDERBUFFER, attachment.id);
+		}
+		return;
+	}
+
+	const TextureBufferFormat& tbf = attachment.texture;
+	if(tbf.type==TT_3D || tbf.type==TT_2D_ARRAY || tbf.type==TT_CUBE_MAP)
+	{
+		attachTextureLayer(attachment.id, tbf);
+		return;
+	}
+
+	// multisample textures have a single level
+	if(isDirectStateAccessEnabled())
+	{
+		glNamedFramebufferTexture(getContextID(), attachmentType, attachment.id, tbf.level);
+		return;
+	}
+
+	bindToEdit();
+	switch(tbf.type)
+	{
+		case TT_1D: glFramebufferTexture1D(target, attachmentType, GL_TEXTURE_1D, attachment.id, tbf.level); break;
+		case TT_2D_MULTISAMPLE: glFramebufferTexture2D(target, attachmentType, GL_TEXTURE_2D_MULTISAMPLE, attachment.id, 0); break;
+		default: glFramebufferTexture2D(target, attachmentType, GL_TEXTURE_2D, attachment.id, tbf.level); break;
+	}
+}
+
+
+GLuint FrameBufferObject::createFramebuffer()
+{
+	GLuint id;
+	if(isDirectStateAccessEnabled())
+	{
+		glCreateFramebuffers(1, &id);
+		return id;
+	}
+
+	// the fbo only exists once it was bound
+	glGenFramebuffers(1, &id);
+	BindingCache::current().bindFramebuffer(getTarget(), id);
+	return id;
+}
+
+
+void FrameBufferObject::deleteFramebuffer(const void* context, GLuint id)
+{
+	if(context==BindingCache::currentContext())
+	{
+		glDeleteFramebuffers(1, &id);
+		BindingCache::current().onFramebufferDeleted(id);
+		return;
+	}
+
+	// fbo names are per context, deleting it here would hit another fbo
+	std::lock_guard<std::mutex> lock(s_orphanMutex);
+	s_orphanedFramebuffers[context].push_back(id);
+}
+
+
+void FrameBufferObject::syncContext(const void* context, unsigned long& serial, unsigned long& fenceSerial)
+{
+	// gpu side wait for the work published by another context
+	if(fenceSerial!=m_publishSerial)
+	{
+		std::lock_guard<std::mutex> lock(m_contextMutex);
+		if(m_publishContext!=context && m_publishFence)
+			glWaitSync(m_publishFence, 0, GL_TIMEOUT_IGNORED);
+		fenceSerial = m_publishSerial;
+	}
+
+	// updated first, the rebuild resolves the id of this context again
+	if(serial!=m_serial)
+	{
+		serial = m_serial;
+		rebuildFramebuffer();
+	}
+}
+
+
+void FrameBufferObject::rebuildFramebuffer()
+{
+	// start from an empty fbo, detaching with renderbuffer 0 works for any attachment
+	std::vector<GLenum> attachmentPoints;
+	attachmentPoints.push_back(GL_DEPTH_ATTACHMENT);
+	attachmentPoints.push_back(GL_STENCIL_ATTACHMENT);
+	for(GLuint i=0; i<getMaxColorAttachments(); ++i)
+		attachmentPoints.push_back(GL_COLOR_ATTACHMENT0 + i);
+
+	GLuint id = getContextID();
+	if(!isDirectStateAccessEnabled()) bindToEdit();
+	for(std::vector<GLenum>::const_iterator it = attachmentPoints.begin(); it != attachmentPoints.end(); ++it)
+	{
+		if(isDirectStateAccessEnabled())
+			glNamedFramebufferRenderbuffer(id, *it, GL_RENDERBUFFER, 0);
+		else
+			glFramebufferRenderbuffer(getTarget(), *it, GL_RENDERBUFFER, 0);
+	}
+
+	// replay the attachment table
+	for(std::vector<Attachment>::const_iterator it = m_attachments.begin(); it != m_attachments.end(); ++it)
+	{
+		if(it->id==0) continue;
+		bool attached = it->isRenderBuffer ? it->renderBuffer.attached : it->texture.attached;
+		if(attached) attachToFramebuffer(*it);
+	}
+	applyDrawBuffers();
+}
+
+
+void FrameBufferObject::markConfigurationChanged()
+{
+	++m_serial;
+
+	// the change was applied to the fbo of the current context right away
+	const void* context = BindingCache::currentContext();
+	if(context==m_context)
+	{
+		m_ownerSerial = m_serial;
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_contextMutex);
+	std::map<const void*, ContextFramebuffer>::iterator it = m_contextFramebuffers.find(context);
+	if(it!=m_contextFramebuffers.end()) it->second.serial = m_serial;
+}
+
+
+FBO_RESULT FrameBufferObject::invalidateAttachments(const std::vector<GLenum>& attachmentPoints, const GLint* rect)
+{
+	if(!isInvalidationSupported()) return FR_UNSUPPORTED;
+
+	// the contents are undefined from now on
+	for(std::vector<Attachment>::iterator it = m_attachments.begin(); it != m_attachments.end(); ++it)
+	{
+		bool attached = it->isRenderBuffer ? it->renderBuffer.attached : it->texture.attached;
+		if(it->id && attached && std::find(attachmentPoints.begin(), attachmentPoints.end(), getAttachmentPoint(*it))!=attachmentPoints.end())
+			setCleared(*it, false);
+	}
+
+	GLsizei count = (GLsizei)attachmentPoints.size();
+	if(isDirectStateAccessEnabled())
+	{
+		if(rect)
+			glInvalidateNamedFramebufferSubData(getContextID(), count, &attachmentPoints[0], rect[0], rect[1], rect[2], rect[3]);
+		else
+			glInvalidateNamedFramebufferData(getContextID(), count, &attachmentPoints[0]);
+		return FR_OK;
+	}
+
+	bindToEdit();
+	if(rect)
+		glInvalidateSubFramebuffer(getTarget(), count, &attachmentPoints[0], rect[0], rect[1], rect[2], rect[3]);
+	else
+		glInvalidateFramebuffer(getTarget(), count, &attachmentPoints[0]);
+	return FR_OK;
+}
+
+
+void FrameBufferObject::blitAttachment(FrameBufferObject& target, const Attachment& src, const Attachment& dst, const GLint* srcRect, const GLint* dstRect, GLenum filter)
+{
+	GLint srcBox[4] = {0, 0, 0, 0};
+	GLint dstBox[4] = {0, 0, 0, 0};
+	if(srcRect)
+		std::copy(srcRect, srcRect+4, srcBox);
+	else
+		getSize(src, srcBox[2], srcBox[3]);
+	if(dstRect)
+		std::copy(dstRect, dstRect+4, dstBox);
+	else
+		getSize(dst, dstBox[2], dstBox[3]);
+
+	// depth and stencil can only be copied unfiltered
+	GLbitfield mask = getBufferMask(src);
+	bool isColor = mask==GL_COLOR_BUFFER_BIT;
+	if(!isColor) filter = GL_NEAREST;
+
+	GLuint readFbo = getContextID();
+	GLuint drawFbo = target.getContextID();
+	if(isDirectStateAccessEnabled())
+	{
+		if(isColor)
+		{
+			glNamedFramebufferReadBuffer(readFbo, getAttachmentPoint(src));
+			glNamedFramebufferDrawBuffer(drawFbo, getAttachmentPoint(dst));
+		}
+		glBlitNamedFramebuffer(readFbo, drawFbo, srcBox[0], srcBox[1], srcBox[0]+srcBox[2], srcBox[1]+srcBox[3],
+							   dstBox[0], dstBox[1], dstBox[0]+dstBox[2], dstBox[1]+dstBox[3], mask, filter);
+	}
+	else
+	{
+		BindingCache& cache = BindingCache::current();
+		cache.bindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+		cache.bindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFbo);
+		if(isColor)
+		{
+			glReadBuffer(getAttachmentPoint(src));
+			glDrawBuffer(getAttachmentPoint(dst));
+		}
+		glBlitFramebuffer(srcBox[0], srcBox[1], srcBox[0]+srcBox[2], srcBox[1]+srcBox[3],
+						  dstBox[0], dstBox[1], dstBox[0]+dstBox[2], dstBox[1]+dstBox[3], mask, filter);
+	}
+
+	// the blit redirected the target's draw buffers
+	if(isColor) target.applyDrawBuffers();
+}
+
+
+void FrameBufferObject::copyImage(const Attachment& src, const Attachment& dst, const GLint* srcRect, const GLint* dstRect)
+{
+	// layers and cube map faces are addressed as z
+	GLenum srcTarget = src.isRenderBuffer ? GL_RENDERBUFFER : getTextureTarget(src.texture.type);
+	GLenum dstTarget = dst.isRenderBuffer ? GL_RENDERBUFFER : getTextureTarget(dst.texture.type);
+	GLint srcLevel = src.isRenderBuffer ? 0 : src.texture.level;
+	GLint dstLevel = dst.isRenderBuffer ? 0 : dst.texture.level;
+	GLint srcLayer = src.isRenderBuffer || src.texture.layer==ALL_LAYERS ? 0 : src.texture.layer;
+	GLint dstLayer = dst.isRenderBuffer || dst.texture.layer==ALL_LAYERS ? 0 : dst.texture.layer;
+
+	glCopyImageSubData(src.id, srcTarget, srcLevel, srcRect[0], srcRect[1], srcLayer,
+					   dst.id, dstTarget, dstLevel, dstRect[0], dstRect[1], dstLayer,
+					   srcRect[2], srcRect[3], 1);
+}
+
+
+GLenum FrameBufferObject::getTextureTarget(TEXTURE_TYPE type)
+{
+	switch(type)
+	{
+		case TT_1D: return GL_TEXTURE_1D;
+		case TT_3D: return GL_TEXTURE_3D;
+		case TT_2D_MULTISAMPLE: return GL_TEXTURE_2D_MULTISAMPLE;
+		case TT_2D_ARRAY: return GL_TEXTURE_2D_ARRAY;
+		case TT_CUBE_MAP: return GL_TEXTURE_CUBE_MAP;
+		default: return GL_TEXTURE_2D;
+	}
+}
+
+
+GLuint FrameBufferObject::allocateRenderBuffer(const RenderBufferFormat& bf)
+{
+	GLuint id = m_usePool ? AttachmentPool::getInstance().acquire(getPoolKey(bf)) : 0;
+	if(id) return id;
+
+	if(isDirectStateAccessEnabled())
+	{
+		glCreateRenderbuffers(1, &id);
+		if(bf.samples>0)
+			glNamedRenderbufferStorageMultisample(id, bf.samples, bf.intFormat, bf.width, bf.height);
+		else
+			glNamedRenderbufferStorage(id, bf.intFormat, bf.width, bf.height);
+		return id;
+	}
+
+	glGenRenderbuffers(1, &id);
+	BindingCache::current().bindRenderbuffer(id);
+	if(bf.samples>0)
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, bf.samples, bf.intFormat, bf.width, bf.height);
+	else
+		glRenderbufferStorage(GL_RENDERBUFFER, bf.intFormat, bf.width, bf.height);
+	return id;
+}
+
+
+GLuint FrameBufferObject::allocateTexture(const TextureBufferFormat& tbf)
+{
+	GLuint id = m_usePool ? AttachmentPool::getInstance().acquire(getPoolKey(tbf)) : 0;
+	if(id) return id;
+
+	// named textures get immutable storage without being bound
+	if(isDirectStateAccessEnabled())
+	{
+		switch(tbf.type)
+		{
+			case TT_1D:
+				glCreateTextures(GL_TEXTURE_1D, 1, &id);
+				glTextureStorage1D(id, tbf.levels, tbf.intFormat, tbf.width);
+				break;
+			case TT_2D:
+				glCreateTextures(GL_TEXTURE_2D, 1, &id);
+				glTextureStorage2D(id, tbf.levels, tbf.intFormat, tbf.width, tbf.height);
+				break;
+			case TT_3D:
+				glCreateTextures(GL_TEXTURE_3D, 1, &id);
+				glTextureStorage3D(id, tbf.levels, tbf.intFormat, tbf.width, tbf.height, tbf.depth);
+				break;
+			case TT_2D_MULTISAMPLE:
+				glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &id);
+				glTextureStorage2DMultisample(id, tbf.samples, tbf.intFormat, tbf.width, tbf.height, GL_TRUE);
+				break;
+			case TT_2D_ARRAY:
+				glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &id);
+				glTextureStorage3D(id, tbf.levels, tbf.intFormat, tbf.width, tbf.height, tbf.depth);
+				break;
+			case TT_CUBE_MAP:
+				glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &id);
+				glTextureStorage2D(id, tbf.levels, tbf.intFormat, tbf.width, tbf.height);
+				break;
+		}
+		return id;
+	}
+
+	// set storage for the texture, immutable if the driver supports it so
+	// that completeness is not re-validated on every use
+	bool immutable = GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+	bool immutableMultisample = GLEW_VERSION_4_3 || GLEW_ARB_texture_storage_multisample;
+
+	glGenTextures(1, &id);
+	GLenum target = getTextureTarget(tbf.type);
+	BindingCache::current().bindTexture(target, id);
+	switch(tbf.type)
+	{
+		case TT_1D:
+			if(immutable)
+				glTexStorage1D(GL_TEXTURE_1D, tbf.levels, tbf.intFormat, tbf.width);
+			break;
+		case TT_2D:
+			if(immutable)
+				glTexStorage2D(GL_TEXTURE_2D, tbf.levels, tbf.intFormat, tbf.width, tbf.height);
+			break;
+		case TT_3D:
+			if(immutable)
+				glTexStorage3D(GL_TEXTURE_3D, tbf.levels, tbf.intFormat, tbf.width, tbf.height, tbf.depth);
+			break;
+		case TT_2D_MULTISAMPLE:
+			if(immutableMultisample)
+				glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, tbf.samples, tbf.intFormat, tbf.width, tbf.height, GL_TRUE);
+			else
+				glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, tbf.samples, tbf.intFormat, tbf.width, tbf.height, GL_TRUE);
+			return id;
+		case TT_2D_ARRAY:
+			if(immutable)
+				glTexStorage3D(GL_TEXTURE_2D_ARRAY, tbf.levels, tbf.intFormat, tbf.width, tbf.height, tbf.depth);
+			break;
+		case TT_CUBE_MAP:
+			if(immutable)
+				glTexStorage2D(GL_TEXTURE_CUBE_MAP, tbf.levels, tbf.intFormat, tbf.width, tbf.height);
+			break;
+	}
+	if(immutable) return id;
+
+	// client format is only needed by glTexImage, it must match depth/stencil formats
+	GLenum format, type;
+	getClientFormat(tbf.intFormat, format, type);
+
+	// mutable storage is specified level by level, the texture is only
+	// mipmap complete if it stops at the last one
+	for(GLint level=0; level<tbf.levels; ++level)
+	{
+		GLsizei width = std::max(tbf.width >> level, 1);
+		GLsizei height = std::max(tbf.height >> level, 1);
+		switch(tbf.type)
+		{
+			case TT_1D:
+				glTexImage1D(GL_TEXTURE_1D, level, tbf.intFormat, width, 0, format, type, NULL );
+				break;
+			case TT_2D:
+				glTexImage2D(GL_TEXTURE_2D, level, tbf.intFormat, width, height, 0, format, type, NULL );
+				break;
+			case TT_3D:
+				glTexImage3D(GL_TEXTURE_3D, level, tbf.intFormat, width, height, std::max(tbf.depth >> level, 1), 0, format, type, NULL );
+				break;
+			case TT_2D_ARRAY:
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, level, tbf.intFormat, width, height, tbf.depth, 0, format, type, NULL );
+				break;
+			case TT_CUBE_MAP:
+				for(GLenum face=0; face<6; ++face)
+					glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, tbf.intFormat, width, height, 0, format, type, NULL );
+				break;
+			default:
+				break;
+		}
+	}
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, tbf.levels-1);
+	return id;
+}
+
+
+void FrameBufferObject::releaseRenderBuffer(GLuint id, const RenderBufferFormat& bf)
+{
+	if(m_usePool)
+		AttachmentPool::getInstance().release(getPoolKey(bf), id);
+	else
+	{
+		glDeleteRenderbuffers(1, &id);
+		BindingCache::current().onRenderbufferDeleted(id);
+	}
+}
+
+
+void FrameBufferObject::releaseTexture(GLuint id, const TextureBufferFormat& tbf)
+{
+	if(m_usePool)
+		AttachmentPool::getInstance().release(getPoolKey(tbf), id);
+	else
+	{
+		glDeleteTextures(1, &id);
+		BindingCache::current().onTextureDeleted(id);
+	}
+}
+
+
+AttachmentKey FrameBufferObject::getPoolKey(const RenderBufferFormat& bf)
+{
+	AttachmentKey key;
+	key.type = POT_RENDERBUFFER;
+	key.intFormat = bf.intFormat;
+	key.width = bf.width;
+	key.height = bf.height;
+	key.depth = 0;
+	key.samples = bf.samples;
+	key.levels = 1;
+	return key;
+}
+
+
+AttachmentKey FrameBufferObject::getPoolKey(const TextureBufferFormat& tbf)
+{
+	AttachmentKey key;
+	switch(tbf.type)
+	{
+		case TT_1D: key.type = POT_TEXTURE_1D; break;
+		case TT_2D: key.type = POT_TEXTURE_2D; break;
+		case TT_3D: key.type = POT_TEXTURE_3D; break;
+		case TT_2D_MULTISAMPLE: key.type = POT_TEXTURE_2D_MULTISAMPLE; break;
+		case TT_2D_ARRAY: key.type = POT_TEXTURE_2D_ARRAY; break;
+		case TT_CUBE_MAP: key.type = POT_TEXTURE_CUBE_MAP; break;
+		default:	key.type = POT_TEXTURE_2D; break;
+	}
+	key.intFormat = tbf.intFormat;
+	key.width = tbf.width;
+	key.height = tbf.height;
+	key.depth = tbf.depth;
+	key.samples = tbf.samples;
+	key.levels = tbf.levels;
+	return key;
+}
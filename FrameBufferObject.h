@@ -16,16 +16,16 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
+#include <mutex>
 #include <GL/glew.h>
 #include <GL/glut.h>
-
-// Buffer's target mode parameter
-enum BUFFER_TARGET_MODE {BTM_READ=0, BTM_WRITE, BTM_READ_WRITE };
-// Render buffer type
-enum RBUFFER_TYPE {RBT_COLOR=0, RBT_DEPTH, RBT_STENCIL};
-// texture buffer
-enum TEXTURE_BUFFER_TYPE {TBT_COLOR=0,TBT_DEPTH,TBT_STENCIL,TBT_DEPTH_AND_STENCIL};
-enum TEXTURE_TYPE {TT_1D=0, TT_2D, TT_3D};
+#include "ReadbackRing.h"
+#include "UploadRing.h"
+#include "TimerQueryRing.h"
+#include "AttachmentPool.h"
+#include "BindingCache.h"
+#include "FBOTypes.h"
 
 
 class FrameBufferObject
@@ -37,40 +37,269 @@ public:
 	 FrameBufferObject(BUFFER_TARGET_MODE mode);
 	~FrameBufferObject();
 
+	// bind to the target of the buffer target mode, redundant binds are skipped
+	void bind();
 	// switch to window-system provided buffers
 	void switchToDefaultSystemBuffers();
 
 	// Renderbuffer management methods
-	void createRenderBuffer(std::string name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei width, GLsizei height);
-	void createRenderBufferAndAttach(std::string name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei width, GLsizei height);
-	void deleteRenderBuffer(std::string name);
-	void attachRenderBuffer(std::string name);
-	void detachRenderBuffer(std::string name);
-	bool isRenderBufferUsed(std::string name);
+	// colorSlot selects GL_COLOR_ATTACHMENT0+colorSlot for RBT_COLOR buffers
+	AttachmentHandle createRenderBuffer(const std::string& name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei width, GLsizei height, GLuint colorSlot=0);
+	AttachmentHandle createRenderBufferAndAttach(const std::string& name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei width, GLsizei height, GLuint colorSlot=0);
+	AttachmentHandle createMultisampleRenderBuffer(const std::string& name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei samples, GLsizei width, GLsizei height, GLuint colorSlot=0);
+	AttachmentHandle createMultisampleRenderBufferAndAttach(const std::string& name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei samples, GLsizei width, GLsizei height, GLuint colorSlot=0);
+	FBO_RESULT deleteRenderBuffer(AttachmentHandle handle);
+	FBO_RESULT attachRenderBuffer(AttachmentHandle handle);
+	FBO_RESULT detachRenderBuffer(AttachmentHandle handle);
+	FBO_RESULT deleteRenderBuffer(const std::string& name);
+	FBO_RESULT attachRenderBuffer(const std::string& name);
+	FBO_RESULT detachRenderBuffer(const std::string& name);
+	bool isRenderBufferUsed(const std::string& name);
 
 	// Texture Object Attachment
-	void attach1DTexture(std::string name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLint level);
-	void attach2DTexture(std::string name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLsizei height, GLint level);
-	void attach3DTexture(std::string name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLsizei height, GLsizei depth, GLint level, GLint layer);
-	void detachTexture(std::string name);
+	// colorSlot selects GL_COLOR_ATTACHMENT0+colorSlot for TBT_COLOR textures
+	// internalFormat GL_NONE picks the default format of the buffer type,
+	// see getDefaultFormat(). Storage is immutable where GL supports it.
+	// numLevels mip levels are allocated, at least enough for the
+	// attached level, FULL_MIP_CHAIN allocates every level down to 1x1.
+	static const GLsizei FULL_MIP_CHAIN = 0;
+	AttachmentHandle attach1DTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLint level, GLuint colorSlot=0, GLenum internalFormat=GL_NONE, GLsizei numLevels=1);
+	AttachmentHandle attach2DTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLsizei height, GLint level, GLuint colorSlot=0, GLenum internalFormat=GL_NONE, GLsizei numLevels=1);
+	AttachmentHandle attach3DTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLsizei height, GLsizei depth, GLint level, GLint layer, GLuint colorSlot=0, GLenum internalFormat=GL_NONE, GLsizei numLevels=1);
+	AttachmentHandle attach2DMultisampleTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei samples, GLsizei width, GLsizei height, GLuint colorSlot=0, GLenum internalFormat=GL_NONE);
+
+	// Layered attachment
+	// For 3D, 2D array and cube map textures a layer of ALL_LAYERS
+	// attaches the whole texture, so a single pass can select the layer
+	// per primitive (gl_Layer). Cube map layers are the faces in
+	// GL_TEXTURE_CUBE_MAP_POSITIVE_X order. selectLayer() re-targets an
+	// attached texture without recreating it.
+	static const GLint ALL_LAYERS = -1;
+	AttachmentHandle attach2DArrayTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLsizei height, GLsizei layers, GLint level, GLint layer, GLuint colorSlot=0, GLenum internalFormat=GL_NONE, GLsizei numLevels=1);
+	AttachmentHandle attachCubeMapTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei size, GLint level, GLint face, GLuint colorSlot=0, GLenum internalFormat=GL_NONE, GLsizei numLevels=1);
+	FBO_RESULT selectLayer(AttachmentHandle handle, GLint level, GLint layer);
+	// re-targets the mip level of any single-sample attached texture,
+	// FR_NOT_FOUND if the level has no storage
+	FBO_RESULT selectLevel(AttachmentHandle handle, GLint level);
+	// attaches a 2D texture owned by the client, deleting it only detaches
+	// it. numLevels tells selectLevel() how many levels the texture has.
+	AttachmentHandle attachExternalTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLuint textureId, GLenum internalFormat, GLsizei width, GLsizei height, GLint level, GLuint colorSlot=0, GLsizei numLevels=1);
+	FBO_RESULT detachTexture(AttachmentHandle handle);
+	FBO_RESULT deleteTexture(AttachmentHandle handle);
+	FBO_RESULT detachTexture(const std::string& name);
+	FBO_RESULT deleteTexture(const std::string& name);
+
+	// Mipmaps
+	// With auto mipmaps enabled, binding the fbo while level 0 of the
+	// texture is attached marks its lower levels stale. They are
+	// regenerated once, the next time the texture is prepared for
+	// sampling, instead of after every pass that renders into it.
+	// Passes that render the lower levels themselves (hierarchical z,
+	// downsampling) leave it disabled.
+	FBO_RESULT setAutoMipmap(AttachmentHandle handle, bool enable);
+	bool isMipmapStale(AttachmentHandle handle)const;
+	// regenerates the levels if they are stale
+	FBO_RESULT updateMipmap(AttachmentHandle handle);
+	// updateMipmap() and bind the texture to the texture unit
+	FBO_RESULT bindForSampling(AttachmentHandle handle, GLuint unit);
+	// regenerates the levels unconditionally
+	FBO_RESULT generateMipmap(AttachmentHandle handle);
+
+	// Name lookup
+	// Slow path for tooling, resolves a name to the handle returned at
+	// creation. Hot loops should keep the handle instead.
+	FBO_RESULT findRenderBuffer(const std::string& name, AttachmentHandle& handle)const;
+	FBO_RESULT findTexture(const std::string& name, AttachmentHandle& handle)const;
+
+	// Attachment pooling
+	// When enabled, new buffers are taken from the process-wide
+	// AttachmentPool and deleted buffers are released back to it.
+	void setAttachmentPooling(bool enable);
+	bool isAttachmentPoolingEnabled()const;
+
+	// Invalidation
+	// Contents of transient attachments are not needed after the pass,
+	// invalidate() tells the driver so it can skip writing them back to
+	// memory. The explicit forms discard any attachment, optionally only
+	// a region of it. Without GL 4.3 or ARB_invalidate_subdata these
+	// return FR_UNSUPPORTED and the contents are simply kept.
+	FBO_RESULT setTransient(AttachmentHandle handle, bool transient);
+	bool isTransient(AttachmentHandle handle)const;
+	FBO_RESULT invalidate();
+	FBO_RESULT invalidate(const std::vector<AttachmentHandle>& handles);
+	FBO_RESULT invalidate(const std::vector<AttachmentHandle>& handles, GLint x, GLint y, GLsizei width, GLsizei height);
+	// when enabled switchToDefaultSystemBuffers() invalidates the transient attachments first
+	void setInvalidateOnUnbind(bool enable);
+	static bool isInvalidationSupported();
+
+	// Clears
+	// Each attachment is cleared on its own with glClearBuffer, the
+	// scissor and write masks apply as they do for glClear. The fbo
+	// remembers the value an attachment was cleared to and skips the
+	// clear while nothing can have been drawn into it since, that is
+	// until bind() makes it reachable through the draw buffers or a copy,
+	// resolve or upload writes it. Draw into the fbo only after bind().
+	// External textures are always cleared, other fbos may draw into them.
+	// An attachment marked as overwritten is fully covered by the next
+	// pass, its clear is replaced with an invalidate.
+	FBO_RESULT clearColor(AttachmentHandle handle, GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+	FBO_RESULT clearDepthStencil(AttachmentHandle handle, GLfloat depth, GLint stencil);
+	// every attached buffer, color may be NULL to leave the color buffers alone
+	FBO_RESULT clear(const GLfloat* color, GLfloat depth=1.0f, GLint stencil=0);
+	FBO_RESULT setOverwritten(AttachmentHandle handle, bool overwritten);
+	bool isOverwritten(AttachmentHandle handle)const;
+	bool isCleared(AttachmentHandle handle)const;
+
+	// Multisample resolve
+	// Blits a multisampled attachment of this fbo into a single-sample
+	// attachment of the target fbo. Both must have the same size. The
+	// second form resolves every attachment that has a counterpart at the
+	// same attachment point of the target.
+	FBO_RESULT resolve(FrameBufferObject& target, AttachmentHandle source, AttachmentHandle destination);
+	FBO_RESULT resolve(FrameBufferObject& target);
+	static GLsizei getMaxSamples();
+
+	// Copies
+	// Copies a region of an attachment of this fbo into an attachment of
+	// the target fbo, which may be this fbo. Unscaled copies between
+	// buffers of the same format and sample count use glCopyImageSubData
+	// (GL 4.3 or ARB_copy_image), which skips the framebuffer pipeline.
+	// Everything else is a blit, scaled with the filter for color and
+	// unfiltered for depth and stencil. Sizes are those of the attached
+	// level. Copies into multisampled buffers that need a blit and scaled
+	// copies out of them return FR_UNSUPPORTED.
+	FBO_RESULT copy(FrameBufferObject& target, AttachmentHandle source, AttachmentHandle destination, GLenum filter=GL_LINEAR);
+	FBO_RESULT copy(FrameBufferObject& target, AttachmentHandle source, AttachmentHandle destination,
+					GLint srcX, GLint srcY, GLsizei srcWidth, GLsizei srcHeight,
+					GLint dstX, GLint dstY, GLsizei dstWidth, GLsizei dstHeight, GLenum filter=GL_LINEAR);
+	static bool isCopyImageSupported();
+
+	// Multiple render targets
+	// By default every attached color slot is written (in slot order). An
+	// explicit set overrides that until resetDrawBuffers() is called.
+	void setDrawBuffers(const std::vector<GLuint>& colorSlots);
+	void resetDrawBuffers();
+	static GLuint getMaxColorAttachments();
+
+	// Internal formats
+	// RGBA8 for color, DEPTH_COMPONENT24, STENCIL_INDEX8 and the packed
+	// DEPTH24_STENCIL8 for the other buffer types.
+	static GLenum getDefaultFormat(TEXTURE_BUFFER_TYPE type);
+
+	// Direct state access
+	// With GL 4.5 or ARB_direct_state_access every fbo, texture and
+	// renderbuffer is edited by name and the current bindings are left
+	// alone. Otherwise the bind-to-edit path is used. Switch backends
+	// only while no FrameBufferObject exists.
+	static bool isDirectStateAccessEnabled();
+	static void enableDirectStateAccess(bool enable);
+
+	// Asynchronous readback
+	// Reads of an attachment are queued into a ring of pixel pack buffers
+	// and handed back through a mapped pointer once the GPU is done.
+	// format/type default to the attachment's natural client format.
+	void createReadbackRing(unsigned depth);
+	FBO_RESULT queueReadback(AttachmentHandle handle, GLenum format=GL_NONE, GLenum type=GL_NONE);
+	FBO_RESULT queueReadback(const std::string& name, GLenum format=GL_NONE, GLenum type=GL_NONE);
+	bool mapReadback(ReadbackFrame& frame, bool wait=false);
+	void unmapReadback();
+
+	// Streaming uploads
+	// CPU pixels produced on other threads (video frames, rasterized UI)
+	// reach a texture attachment through its UploadRing. Producers
+	// acquire a slice of a persistently mapped unpack buffer (GL 4.4 or
+	// ARB_buffer_storage), write the pixels and commit it without a GL
+	// context. flushUploads() issues the committed updates into the
+	// attached level and layer, the driver neither copies nor waits.
+	// sliceSize 0 fits the attached level in its natural client format.
+	UploadRing* createUploadStream(AttachmentHandle handle, unsigned depth=3, GLsizeiptr sliceSize=0);
+	UploadRing* getUploadStream(AttachmentHandle handle)const; // NULL if none was created
+	FBO_RESULT flushUploads(AttachmentHandle handle);
+	void flushUploads();
+
+	// GPU timing
+	// beginTiming()/endTiming() bracket the GPU work of a pass. Results
+	// are collected a few frames late without stalling and kept as
+	// rolling statistics. Without GL 3.3 or ARB_timer_query these return
+	// FR_UNSUPPORTED.
+	void createTimerQueryRing(unsigned depth, unsigned window=128);
+	FBO_RESULT beginTiming();
+	FBO_RESULT endTiming();
+	FBO_RESULT getTimingStatistics(TimingStatistics& statistics);
+	void writeTimingCSV(std::ostream& out, const std::string& label);
+
+	// Completeness
+	// The status is queried from GL only when the attachment
+	// configuration differs from every configuration seen before, so
+	// steady-state checks cost a hash of the attachment table. An
+	// incomplete configuration is reported once, naming the likely
+	// offending attachments.
+	bool isComplete();
+	GLenum getStatus();
+	static const char* getStatusString(GLenum status);
+
+	// Multiple contexts
+	// Textures and renderbuffers are shared between contexts, framebuffer
+	// objects are not. The fbo keeps its attachments once and builds a GL
+	// fbo for every context on first use there, replaying the attachment
+	// table whenever it changed on another context. Configure it on one
+	// thread at a time and call publish() before handing it over, the
+	// next context to use it waits on the GPU for the published work.
+	// Readback and timer rings belong to the context that created them.
+	FBO_RESULT publish();
+	// deletes the fbos that were destroyed while another context was
+	// current. call it on each context every frame and before the context
+	// is destroyed.
+	static void releaseOrphanedFramebuffers();
 
 	// Accessors
-			GLuint				getID() const;
-	const	GLuint				getRenderBufferID(std::string name)const;
-	const	GLuint				getTextureBufferID(std::string name)const;
+			GLuint				getID() const; // fbo of the creating context
+			GLuint				getContextID(); // fbo of the current context
+			GLuint				getAttachmentID(AttachmentHandle handle)const; // 0 if the handle is stale
+			FBO_RESULT			getAttachmentSize(AttachmentHandle handle, GLsizei& width, GLsizei& height)const; // of the attached level
+			GLenum				getAttachmentFormat(AttachmentHandle handle)const; // GL_NONE if the handle is stale
+			GLsizei				getNumLevels(AttachmentHandle handle)const; // allocated mip levels, 0 if the handle is stale
+	const	GLuint				getRenderBufferID(const std::string& name)const; // 0 if not found
+	const	GLuint				getTextureBufferID(const std::string& name)const; // 0 if not found
 			bool				isUsed()const;
 			unsigned			getNumRenderbuffers() const;
 			unsigned			getNumAttachedTexturebuffers() const;
 			BUFFER_TARGET_MODE	getBufferTargetMode()const;	
+	const	std::vector<GLenum>&	getDrawBuffers()const;
 	
 private:
+
+	// mapping of the target mode and buffer types onto GL enums
+	GLenum getTarget()const;
+	// bind() without marking mipmaps stale, for edits of the fbo
+	void bindToEdit();
+	static GLenum getAttachmentPoint(RBUFFER_TYPE type, GLuint colorSlot);
+	static GLenum getAttachmentPoint(TEXTURE_BUFFER_TYPE type, GLuint colorSlot);
+
+	// buffers an internal format provides and the client format that matches it
+	static GLbitfield getFormatMask(GLenum intFormat);
+	static void getClientFormat(GLenum intFormat, GLenum& format, GLenum& type);
+	static bool checkFormat(const std::string& name, GLenum attachmentPoint, GLenum intFormat);
+	// textures the fbo allocates, sized formats for immutable storage and stencil texture support
+	static bool checkTextureFormat(const std::string& name, GLenum intFormat);
+	static bool isSizedFormat(GLenum intFormat);
+
+	// color slot bookkeeping for MRT
+	bool useColorSlot(GLuint colorSlot);
+	// detaches what is attached at the point, apart from the entry keepIndex
+	void detachAttachmentsAt(GLenum attachmentPoint, int keepIndex=-1);
+	void releaseColorSlot(GLuint colorSlot);
+	void applyDrawBuffers();
 	
 	// renderbuffer state
 	struct RenderBufferFormat {
 		GLsizei width; // buffer's width
 		GLsizei height; // buffer's height
 		GLenum  intFormat;
+		GLsizei samples; // 0 for single-sample storage
 		RBUFFER_TYPE bufferType;
+		GLuint colorSlot; // GL_COLOR_ATTACHMENT0 offset, RBT_COLOR only
+		bool attached;
 	};
 
 	// texture buffer state
@@ -79,21 +308,150 @@ private:
 		TEXTURE_TYPE type;
 		GLsizei width;
 		GLsizei height;
-		GLsizei depth; // buffer's depth , for volumetric textures
+		GLsizei depth; // buffer's depth , for volumetric textures and arrays
+		GLint level; // attached mip level
+		GLsizei levels; // allocated mip levels
+		GLint layer; // attached layer, ALL_LAYERS if layered
+		GLsizei samples; // TT_2D_MULTISAMPLE only
+		GLenum intFormat;
+		GLuint colorSlot; // GL_COLOR_ATTACHMENT0 offset, TBT_COLOR only
+		bool attached;
+	};
+
+	// entry of the attachment table, free entries have id 0
+	struct Attachment {
+		GLuint id; // GL renderbuffer or texture name
+		unsigned short generation;
+		bool isRenderBuffer;
+		bool transient; // contents are discarded by invalidate()
+		bool external; // owned by the client, never deleted or pooled
+		bool autoMipmap; // regenerate the levels after level 0 was rendered
+		bool mipmapStale;
+		UploadRing* uploadRing; // created by createUploadStream()
+		bool overwritten; // clears are replaced with an invalidate
+		bool cleared; // holds clearValue and nothing was drawn since
+		GLfloat clearValue[4]; // color, or depth and stencil
+		RenderBufferFormat renderBuffer; // valid if isRenderBuffer
+		TextureBufferFormat texture; // valid otherwise
 	};
 
+	// attachment table management, O(1) handle resolution
+	AttachmentHandle addAttachment(GLuint id, bool isRenderBuffer);
+	void removeAttachment(AttachmentHandle handle);
+	Attachment* getAttachment(AttachmentHandle handle, bool isRenderBuffer);
+	const Attachment* getAttachment(AttachmentHandle handle)const;
+
+	// format independent views of an attachment
+	static GLenum getAttachmentPoint(const Attachment& attachment);
+	static GLbitfield getBufferMask(GLenum attachmentPoint);
+	static GLbitfield getBufferMask(const Attachment& attachment);
+	static GLsizei getSamples(const Attachment& attachment);
+	static void getSize(const Attachment& attachment, GLsizei& width, GLsizei& height);
+	static GLsizei getLevelCount(GLsizei numLevels, GLint level, GLsizei width, GLsizei height, GLsizei depth);
+
+	// contents tracking, bind() marks every attachment a draw can reach
+	bool isDrawBufferReachable(const Attachment& attachment)const;
+	void markDrawBuffersWritten();
+	void markWritten(Attachment& attachment);
+	void setCleared(Attachment& attachment, bool cleared);
+	void clearAttachment(Attachment& attachment, const GLfloat* value);
+
+	// attaches the current level/layer of a 3D, array or cube texture
+	void attachTextureLayer(GLuint id, const TextureBufferFormat& tbf);
+	void attachToFramebuffer(const Attachment& attachment);
+
+	// per context fbos
+	struct ContextFramebuffer {
+		GLuint id;
+		unsigned long serial; // configuration the fbo was built for
+		unsigned long fenceSerial; // last publish() waited for
+	};
+	GLuint createFramebuffer();
+	static void deleteFramebuffer(const void* context, GLuint id);
+	void syncContext(const void* context, unsigned long& serial, unsigned long& fenceSerial);
+	void rebuildFramebuffer();
+	void markConfigurationChanged();
+
+	// completeness bookkeeping
+	// serializes the configuration and returns its hash
+	unsigned long getConfiguration(std::vector<unsigned long>& configuration)const;
+	std::string getAttachmentName(unsigned index)const;
+	void diagnoseStatus(GLenum status)const;
+
+	// discards the given attachment points, the whole buffers if rect is NULL
+	FBO_RESULT invalidateAttachments(const std::vector<GLenum>& attachmentPoints, const GLint* rect);
+
+	// copies src of this fbo into dst of the target fbo, rects are
+	// x, y, width, height and cover the whole buffers if NULL
+	void blitAttachment(FrameBufferObject& target, const Attachment& src, const Attachment& dst, const GLint* srcRect, const GLint* dstRect, GLenum filter);
+	static void copyImage(const Attachment& src, const Attachment& dst, const GLint* srcRect, const GLint* dstRect);
+	static GLenum getTextureTarget(TEXTURE_TYPE type);
+
+	// buffer storage, drawn from the attachment pool if enabled
+	GLuint allocateRenderBuffer(const RenderBufferFormat& bf);
+	GLuint allocateTexture(const TextureBufferFormat& tbf);
+	void releaseRenderBuffer(GLuint id, const RenderBufferFormat& bf);
+	void releaseTexture(GLuint id, const TextureBufferFormat& tbf);
+	static AttachmentKey getPoolKey(const RenderBufferFormat& bf);
+	static AttachmentKey getPoolKey(const TextureBufferFormat& tbf);
+
 	// each attachment can be identified by its unique name
-	// which maps to its associated OpenGL id
-	std::map<std::string, GLuint>m_renderBufferNames;
-	std::map<std::string, GLuint>m_attachedTextureNames;
+	// which maps to its handle, only used by the name based methods
+	std::map<std::string, AttachmentHandle>m_renderBufferNames;
+	std::map<std::string, AttachmentHandle>m_attachedTextureNames;
 	
-	// currently attached buffers list for this fbo
-	std::map<GLuint, RenderBufferFormat>m_renderbuffers;
-	std::map<GLuint, TextureBufferFormat>m_texturebuffers;
+	// flat table of the buffers created by this fbo, indexed by handle
+	std::vector<Attachment>			m_attachments;
+	std::vector<unsigned short>		m_freeAttachments;
+	unsigned						m_numRenderbuffers;
+	unsigned						m_numTexturebuffers;
+
+	// color slots currently in use and the draw buffers derived from them
+	std::set<GLuint>		m_colorSlots;
+	std::vector<GLenum>		m_drawBuffers;
+	bool					m_explicitDrawBuffers;
+
+	// glCheckFramebufferStatus results by configuration hash
+	struct CachedStatus {
+		std::vector<unsigned long> configuration;
+		GLenum status;
+	};
+	std::map<unsigned long, CachedStatus>	m_statusCache;
+
+	// pending asynchronous reads, created on first use
+	ReadbackRing*			m_readbackRing;
+
+	// gpu timing of the passes rendered into this fbo, created on first use
+	TimerQueryRing*			m_timerQueryRing;
+
+	bool					m_usePool; // take buffers from the AttachmentPool
+	bool					m_invalidateOnUnbind;
+	unsigned				m_numAutoMipmaps; // attachments with auto mipmaps, bind() skips the scan if 0
+	unsigned				m_numCleared; // attachments known to be clear, likewise
+	bool					m_drawing; // bound with bind() since the last switch to the system buffers
 
 	GLuint					m_Id; // FBO id
 	BUFFER_TARGET_MODE		m_BufferTargetMode;
 	
+	// m_Id belongs to m_context, the fbos of other contexts are built lazily
+	const void*				m_context;
+	unsigned long			m_serial; // bumped by every configuration change
+	unsigned long			m_ownerSerial;
+	unsigned long			m_ownerFenceSerial;
+	std::map<const void*, ContextFramebuffer>	m_contextFramebuffers;
+	std::mutex				m_contextMutex;
+
+	// last publish()
+	GLsync					m_publishFence;
+	const void*				m_publishContext;
+	unsigned long			m_publishSerial;
+	
+	static int				s_directStateAccess; // -1 undecided, 0 bind-to-edit, 1 dsa
+
+	// fbos deleted while another context was current, by context
+	static std::map<const void*, std::vector<GLuint> >	s_orphanedFramebuffers;
+	static std::mutex		s_orphanMutex;
+	
 };
 
 #endif
\ No newline at end of file
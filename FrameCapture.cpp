@@ -0,0 +1,360 @@
+// =================================================================
+//   File      : FrameCapture.cpp
+//   Desc	   : Streams the frames rendered into an fbo attachment
+//				 to disk. Frames are read back asynchronously, copied
+//				 into a bounded queue and written by worker threads
+//				 into preallocated, memory mapped files, so the render
+//				 thread never waits for the disk.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "FrameCapture.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+// bytes of the "FRAME\n" marker in front of every y4m frame
+static const size_t Y4M_FRAME_MARKER = 6;
+
+// RGBA8 to packed RGB8
+static void convertToRGB(unsigned char* dst, const unsigned char* src, size_t numPixels)
+{
+	for(size_t i=0; i<numPixels; ++i, dst+=3, src+=4)
+	{
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+	}
+}
+
+// RGBA8 to planar 4:4:4 BT.601 studio range
+static void convertToYUV(unsigned char* dst, const unsigned char* src, size_t numPixels)
+{
+	unsigned char* y = dst;
+	unsigned char* u = dst + numPixels;
+	unsigned char* v = dst + 2*numPixels;
+	for(size_t i=0; i<numPixels; ++i, src+=4)
+	{
+		int r = src[0];
+		int g = src[1];
+		int b = src[2];
+		y[i] = (unsigned char)(((66*r + 129*g + 25*b + 128) >> 8) + 16);
+		u[i] = (unsigned char)(((-38*r - 74*g + 112*b + 128) >> 8) + 128);
+		v[i] = (unsigned char)(((112*r - 94*g - 18*b + 128) >> 8) + 128);
+	}
+}
+
+
+FrameCapture::FrameCapture() : m_fbo(NULL), m_format(CF_RAW), m_backpressure(CB_DROP), m_frameRate(30), m_width(0), m_height(0), m_capturing(false),
+	m_headerSize(0), m_frameSize(0), m_stopping(false)
+{
+	memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+
+FrameCapture::~FrameCapture()
+{
+	stop();
+	for(std::vector<Frame*>::iterator it = m_frames.begin(); it != m_frames.end(); ++it)
+		delete *it;
+}
+
+
+// true if the ppm path has exactly one int conversion and nothing else
+// snprintf() would read an argument for, "%%" is a literal percent sign
+static bool isFramePattern(const std::string& path)
+{
+	unsigned numConversions = 0;
+	for(size_t i=0; i<path.size(); ++i)
+	{
+		if(path[i]!='%') continue;
+		if(++i<path.size() && path[i]=='%') continue;
+
+		// flags, width and precision, but no '*' or length modifier
+		while(i<path.size() && strchr("-+ #0", path[i])) ++i;
+		while(i<path.size() && isdigit((unsigned char)path[i])) ++i;
+		if(i<path.size() && path[i]=='.')
+			for(++i; i<path.size() && isdigit((unsigned char)path[i]); ++i);
+
+		if(i>=path.size() || (path[i]!='d' && path[i]!='i')) return false;
+		++numConversions;
+	}
+	return numConversions==1;
+}
+
+
+bool FrameCapture::start(FrameBufferObject& fbo, AttachmentHandle attachment, const std::string& path, CAPTURE_FORMAT format,
+						 unsigned numWorkers, unsigned queueSize, CAPTURE_BACKPRESSURE backpressure, unsigned frameRate)
+{
+	stop();
+
+	GLsizei width, height;
+	if(fbo.getAttachmentSize(attachment, width, height)!=FR_OK)
+	{
+		std::cerr << "Error: capture attachment of fbo " << fbo.getID() << " is invalid...\n";
+		return false;
+	}
+
+	// every frame needs a file of its own, workers must never share one
+	if(format==CF_PPM && !isFramePattern(path))
+	{
+		std::cerr << "Error: capture path " << path << " needs exactly one integer conversion such as %05d...\n";
+		return false;
+	}
+
+	m_fbo = &fbo;
+	m_attachment = attachment;
+	m_path = path;
+	m_format = format;
+	m_backpressure = backpressure;
+	m_frameRate = frameRate ? frameRate : 30;
+	m_width = width;
+	m_height = height;
+
+	size_t numPixels = (size_t)width * height;
+	m_headerSize = 0;
+	switch(format)
+	{
+		case CF_RAW: m_frameSize = numPixels * 4; break;
+		case CF_Y4M: m_frameSize = Y4M_FRAME_MARKER + numPixels * 3; break;
+		default: m_frameSize = numPixels * 3; break;
+	}
+
+	// streams get their header now and grow while the workers write
+	if(format!=CF_PPM)
+	{
+		if(!m_stream.open(path)) return false;
+
+		if(format==CF_Y4M)
+		{
+			char header[128];
+			int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C444\n", width, height, m_frameRate);
+			m_headerSize = (size_t)length;
+
+			MappedView view;
+			if(!m_stream.reserve(m_headerSize) || !m_stream.map(0, m_headerSize, view))
+			{
+				m_stream.close();
+				return false;
+			}
+			memcpy(view.data, header, m_headerSize);
+			MappedFile::unmap(view);
+		}
+	}
+
+	// queue entries are allocated once and recycled
+	if(queueSize==0) queueSize = 1;
+	if(numWorkers==0) numWorkers = 1;
+	if(m_stream.isOpen()) m_stream.reserve(getFrameOffset(queueSize));
+	for(std::vector<Frame*>::iterator it = m_frames.begin(); it != m_frames.end(); ++it)
+		delete *it;
+	m_frames.clear();
+	m_free.clear();
+	for(unsigned i=0; i<queueSize; ++i)
+	{
+		Frame* frame = new Frame;
+		frame->number = 0;
+		frame->pixels.resize(numPixels * 4);
+		m_frames.push_back(frame);
+		m_free.push_back(frame);
+	}
+
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	m_statistics.bytesWritten = m_headerSize;
+	m_stopping = false;
+	for(unsigned i=0; i<numWorkers; ++i)
+		m_workers.push_back(std::thread(&FrameCapture::workerLoop, this));
+
+	// a few frames of latency between the draw and its readback
+	m_fbo->createReadbackRing(3);
+	m_capturing = true;
+	return true;
+}
+
+
+void FrameCapture::captureFrame()
+{
+	if(!m_capturing) return;
+
+	// hand over whatever the GPU finished, then read this frame
+	collectReadbacks(false);
+
+	if(m_fbo->queueReadback(m_attachment, GL_RGBA, GL_UNSIGNED_BYTE)!=FR_OK)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_statistics.framesDropped;
+	}
+}
+
+
+void FrameCapture::stop()
+{
+	if(!m_capturing) return;
+
+	// the readbacks still in flight are the last frames of the capture
+	collectReadbacks(true);
+	m_capturing = false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_queued.notify_all();
+	for(std::vector<std::thread>::iterator it = m_workers.begin(); it != m_workers.end(); ++it)
+		it->join();
+	m_workers.clear();
+
+	// drop the space reserved ahead
+	if(m_stream.isOpen())
+		m_stream.close(getFrameOffset(m_statistics.framesCaptured));
+}
+
+
+bool FrameCapture::isCapturing()const
+{
+	return m_capturing;
+}
+
+
+void FrameCapture::getStatistics(CaptureStatistics& statistics)const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	statistics = m_statistics;
+}
+
+
+void FrameCapture::collectReadbacks(bool wait)
+{
+	ReadbackFrame readback;
+	while(m_fbo->mapReadback(readback, wait))
+	{
+		enqueue(readback);
+		m_fbo->unmapReadback();
+	}
+}
+
+
+bool FrameCapture::enqueue(const ReadbackFrame& readback)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	// the attachment was recreated with another size
+	if(readback.width!=m_width || readback.height!=m_height)
+	{
+		++m_statistics.framesDropped;
+		return false;
+	}
+
+	if(m_free.empty())
+	{
+		if(m_backpressure==CB_DROP)
+		{
+			++m_statistics.framesDropped;
+			return false;
+		}
+		m_released.wait(lock, [this]{ return !m_free.empty(); });
+	}
+
+	Frame* frame = m_free.back();
+	m_free.pop_back();
+	frame->number = m_statistics.framesCaptured++;
+	lock.unlock();
+
+	// GL rows start at the bottom, the outputs start at the top
+	size_t rowSize = (size_t)m_width * 4;
+	const unsigned char* src = (const unsigned char*)readback.data;
+	for(GLsizei row=0; row<m_height; ++row)
+		memcpy(&frame->pixels[(m_height-1-row) * rowSize], src + (size_t)row * readback.rowStride, rowSize);
+
+	lock.lock();
+	m_queue.push_back(frame);
+	m_statistics.queueDepth = m_queue.size();
+	if(m_statistics.queueDepth>m_statistics.maxQueueDepth)
+		m_statistics.maxQueueDepth = m_statistics.queueDepth;
+	lock.unlock();
+
+	m_queued.notify_one();
+	return true;
+}
+
+
+void FrameCapture::workerLoop()
+{
+	for(;;)
+	{
+		Frame* frame;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_queued.wait(lock, [this]{ return m_stopping || !m_queue.empty(); });
+			// stop() lets the queue drain first
+			if(m_queue.empty()) return;
+
+			frame = m_queue.front();
+			m_queue.pop_front();
+			m_statistics.queueDepth = m_queue.size();
+		}
+
+		writeFrame(*frame);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free.push_back(frame);
+		}
+		m_released.notify_one();
+	}
+}
+
+
+void FrameCapture::writeFrame(const Frame& frame)
+{
+	size_t numPixels = (size_t)m_width * m_height;
+	MappedView view;
+
+	if(m_format==CF_PPM)
+	{
+		char path[1024];
+		snprintf(path, sizeof(path), m_path.c_str(), (int)frame.number);
+		char header[64];
+		size_t headerSize = (size_t)snprintf(header, sizeof(header), "P6\n%d %d\n255\n", m_width, m_height);
+		size_t size = headerSize + m_frameSize;
+
+		MappedFile file;
+		if(!file.open(path) || !file.reserve(size) || !file.map(0, size, view)) return;
+		memcpy(view.data, header, headerSize);
+		convertToRGB(view.data + headerSize, &frame.pixels[0], numPixels);
+		MappedFile::unmap(view);
+		file.close(size);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_statistics.framesWritten;
+		m_statistics.bytesWritten += size;
+		return;
+	}
+
+	// keep the stream reserved a queue length ahead of the writes
+	size_t offset = getFrameOffset(frame.number);
+	if(!m_stream.reserve(getFrameOffset(frame.number + 1 + m_frames.size())) || !m_stream.map(offset, m_frameSize, view))
+		return;
+
+	if(m_format==CF_RAW)
+		memcpy(view.data, &frame.pixels[0], m_frameSize);
+	else
+	{
+		memcpy(view.data, "FRAME\n", Y4M_FRAME_MARKER);
+		convertToYUV(view.data + Y4M_FRAME_MARKER, &frame.pixels[0], numPixels);
+	}
+	MappedFile::unmap(view);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_statistics.framesWritten;
+	m_statistics.bytesWritten += m_frameSize;
+}
+
+
+size_t FrameCapture::getFrameOffset(unsigned long number)const
+{
+	return m_headerSize + (size_t)number * m_frameSize;
+}
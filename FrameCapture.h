@@ -0,0 +1,114 @@
+// =================================================================
+//   File      : FrameCapture.h
+//   Desc	   : Streams the frames rendered into an fbo attachment
+//				 to disk. Frames are read back asynchronously, copied
+//				 into a bounded queue and written by worker threads
+//				 into preallocated, memory mapped files, so the render
+//				 thread never waits for the disk.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "FrameBufferObject.h"
+#include "MappedFile.h"
+
+// output of a capture
+// CF_RAW	one file of RGBA8 frames, top row first, no header
+// CF_Y4M	one YUV4MPEG2 stream, 4:4:4 BT.601 studio range
+// CF_PPM	one binary PPM per frame, the path is a printf pattern
+//			such as "frame_%05d.ppm" that receives the frame number.
+//			it must hold exactly one %d or %i conversion
+enum CAPTURE_FORMAT {CF_RAW=0, CF_Y4M, CF_PPM};
+// what captureFrame() does when every queue entry is in use
+enum CAPTURE_BACKPRESSURE {CB_DROP=0, CB_BLOCK};
+
+struct CaptureStatistics {
+	unsigned queueDepth; // frames waiting for a worker
+	unsigned maxQueueDepth;
+	unsigned long framesCaptured; // handed to the workers
+	unsigned long framesWritten;
+	unsigned long framesDropped; // readback ring or queue full
+	unsigned long long bytesWritten;
+};
+
+
+class FrameCapture
+{
+public:
+
+	 // Constructor/Destructor
+	 FrameCapture();
+	~FrameCapture();
+
+	// starts capturing a single-sample color attachment of the fbo. the
+	// capture reads back through the fbo's readback ring, which it recreates.
+	bool start(FrameBufferObject& fbo, AttachmentHandle attachment, const std::string& path, CAPTURE_FORMAT format,
+			   unsigned numWorkers=2, unsigned queueSize=8, CAPTURE_BACKPRESSURE backpressure=CB_DROP, unsigned frameRate=30);
+	// call once per frame after rendering, on the thread of the fbo's
+	// context. queues the readback of this frame and hands the finished
+	// readbacks of earlier frames to the workers.
+	void captureFrame();
+	// writes the frames still in flight, joins the workers and closes the file
+	void stop();
+
+	// Accessors
+	bool isCapturing()const;
+	void getStatistics(CaptureStatistics& statistics)const;
+
+private:
+
+	FrameCapture(const FrameCapture&);
+	FrameCapture& operator=(const FrameCapture&);
+
+	// a frame copied out of the readback ring, RGBA8 top row first
+	struct Frame {
+		unsigned long number;
+		std::vector<unsigned char> pixels;
+	};
+
+	void collectReadbacks(bool wait);
+	bool enqueue(const ReadbackFrame& readback);
+	void workerLoop();
+	void writeFrame(const Frame& frame);
+	size_t getFrameOffset(unsigned long number)const;
+
+	FrameBufferObject*		m_fbo;
+	AttachmentHandle		m_attachment;
+	std::string				m_path;
+	CAPTURE_FORMAT			m_format;
+	CAPTURE_BACKPRESSURE	m_backpressure;
+	unsigned				m_frameRate;
+	GLsizei					m_width;
+	GLsizei					m_height;
+	bool					m_capturing;
+
+	// CF_RAW and CF_Y4M stream, reserved a few frames ahead
+	MappedFile				m_stream;
+	size_t					m_headerSize;
+	size_t					m_frameSize; // bytes per frame in the output
+
+	// Frame entries move from m_free to m_queue and back
+	std::vector<Frame*>		m_frames;
+	std::vector<Frame*>		m_free;
+	std::deque<Frame*>		m_queue;
+	std::vector<std::thread>	m_workers;
+	mutable std::mutex		m_mutex;
+	std::condition_variable	m_queued; // signalled for the workers
+	std::condition_variable	m_released; // signalled for a blocked captureFrame()
+	bool					m_stopping;
+
+	CaptureStatistics		m_statistics;
+
+};
+
+#endif
@@ -0,0 +1,197 @@
+// =================================================================
+//   File      : MappedFile.cpp
+//   Desc	   : Output file written through memory mapped views.
+//				 The file is preallocated ahead of the writes and any
+//				 byte range of it can be mapped, so several threads
+//				 can fill disjoint parts of one file without seeking
+//				 or copying through stdio buffers.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "MappedFile.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef _WIN32
+static const HANDLE INVALID_FILE = INVALID_HANDLE_VALUE;
+#else
+static const int INVALID_FILE = -1;
+#endif
+
+MappedFile::MappedFile() : m_handle(INVALID_FILE), m_size(0)
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	m_handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+	m_handle = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+#endif
+	if(m_handle==INVALID_FILE)
+	{
+		std::cerr << "Error: cannot create " << path << "...\n";
+		return false;
+	}
+
+	m_path = path;
+	m_size = 0;
+	return true;
+}
+
+
+void MappedFile::close(size_t size)
+{
+	if(m_handle==INVALID_FILE) return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(size!=m_size && !resize(size))
+			std::cerr << "Error: cannot truncate " << m_path << " to " << size << " bytes...\n";
+	}
+	close();
+}
+
+
+void MappedFile::close()
+{
+	if(m_handle==INVALID_FILE) return;
+
+#ifdef _WIN32
+	CloseHandle(m_handle);
+#else
+	::close(m_handle);
+#endif
+	m_handle = INVALID_FILE;
+	m_size = 0;
+}
+
+
+bool MappedFile::reserve(size_t size)
+{
+	if(m_handle==INVALID_FILE) return false;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(size<=m_size) return true;
+
+	if(!resize(size))
+	{
+		std::cerr << "Error: cannot preallocate " << size << " bytes for " << m_path << "...\n";
+		return false;
+	}
+	m_size = size;
+	return true;
+}
+
+
+bool MappedFile::map(size_t offset, size_t length, MappedView& view)
+{
+	if(m_handle==INVALID_FILE || length==0) return false;
+	if(offset+length>getSize())
+	{
+		std::cerr << "Error: mapped range exceeds the reserved size of " << m_path << "...\n";
+		return false;
+	}
+
+	// mappings start at a multiple of the allocation granularity
+	size_t alignedOffset = offset - offset % getGranularity();
+	size_t alignedLength = length + (offset - alignedOffset);
+
+#ifdef _WIN32
+	// the view keeps the mapping object alive after its handle is closed
+	HANDLE mapping = CreateFileMappingA(m_handle, NULL, PAGE_READWRITE, 0, 0, NULL);
+	if(mapping==NULL) return false;
+	void* base = MapViewOfFile(mapping, FILE_MAP_WRITE, (DWORD)((unsigned long long)alignedOffset >> 32), (DWORD)(alignedOffset & 0xffffffff), alignedLength);
+	CloseHandle(mapping);
+	if(base==NULL) return false;
+#else
+	void* base = mmap(NULL, alignedLength, PROT_READ | PROT_WRITE, MAP_SHARED, m_handle, (off_t)alignedOffset);
+	if(base==MAP_FAILED) return false;
+#endif
+
+	view.base = base;
+	view.length = alignedLength;
+	view.data = (unsigned char*)base + (offset - alignedOffset);
+	return true;
+}
+
+
+void MappedFile::unmap(MappedView& view)
+{
+	if(view.base==NULL) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(view.base);
+#else
+	munmap(view.base, view.length);
+#endif
+	view = MappedView();
+}
+
+
+bool MappedFile::isOpen()const
+{
+	return m_handle!=INVALID_FILE;
+}
+
+
+size_t MappedFile::getSize()const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_size;
+}
+
+
+const std::string& MappedFile::getPath()const
+{
+	return m_path;
+}
+
+
+bool MappedFile::resize(size_t size)
+{
+#ifdef _WIN32
+	LARGE_INTEGER position;
+	position.QuadPart = (LONGLONG)size;
+	return SetFilePointerEx(m_handle, position, NULL, FILE_BEGIN) && SetEndOfFile(m_handle);
+#else
+#ifdef __linux__
+	// allocates the blocks up front, a full disk fails here instead of
+	// raising SIGBUS inside a mapped write
+	if(size>m_size && posix_fallocate(m_handle, 0, (off_t)size)==0) return true;
+#endif
+	return ftruncate(m_handle, (off_t)size)==0;
+#endif
+}
+
+
+size_t MappedFile::getGranularity()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+#else
+	return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
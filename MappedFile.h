@@ -0,0 +1,76 @@
+// =================================================================
+//   File      : MappedFile.h
+//   Desc	   : Output file written through memory mapped views.
+//				 The file is preallocated ahead of the writes and any
+//				 byte range of it can be mapped, so several threads
+//				 can fill disjoint parts of one file without seeking
+//				 or copying through stdio buffers.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <mutex>
+
+// mapped byte range of a file, valid until it is unmapped
+struct MappedView {
+	unsigned char* data; // first byte of the requested range
+	void* base; // start of the mapping, aligned to the allocation granularity
+	size_t length; // bytes mapped from base
+
+	MappedView() : data(NULL), base(NULL), length(0) {}
+};
+
+
+class MappedFile
+{
+public:
+
+	 // Constructor/Destructor
+	 MappedFile();
+	~MappedFile();
+
+	// creates or truncates the file for reading and writing
+	bool open(const std::string& path);
+	// truncates the file to size and closes it, unmap every view first
+	void close(size_t size);
+	void close();
+
+	// grows the file to at least size bytes, never shrinks it. safe to
+	// call while other threads write through their views.
+	bool reserve(size_t size);
+
+	// maps [offset, offset+length), the range has to be reserved
+	bool map(size_t offset, size_t length, MappedView& view);
+	static void unmap(MappedView& view);
+
+	// Accessors
+	bool isOpen()const;
+	size_t getSize()const; // reserved bytes
+	const std::string& getPath()const;
+
+private:
+
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	bool resize(size_t size);
+	static size_t getGranularity();
+
+#ifdef _WIN32
+	void*			m_handle; // HANDLE of the file
+#else
+	int				m_handle; // file descriptor
+#endif
+	std::string		m_path;
+	size_t			m_size;
+	mutable std::mutex	m_mutex; // guards m_size and resizing
+
+};
+
+#endif
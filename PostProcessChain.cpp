@@ -0,0 +1,277 @@
+// =================================================================
+//   File      : PostProcessChain.cpp
+//   Desc	   : Chain of full screen post-processing stages on top
+//				 of FrameBufferObject. Every stage samples the output
+//				 of the previous one and renders into the next target
+//				 of a small ring, so a chain of any length needs only
+//				 N targets per output size instead of one per stage.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "PostProcessChain.h"
+#include "RenderGraph.h"
+
+PostProcessChain::PostProcessChain() : m_width(0), m_height(0), m_intFormat(GL_RGBA8), m_numBuffers(2)
+{
+}
+
+
+PostProcessChain::~PostProcessChain()
+{
+	releaseTargets();
+}
+
+
+void PostProcessChain::setup(GLsizei width, GLsizei height, GLenum internalFormat, unsigned numBuffers)
+{
+	if(numBuffers<2) numBuffers = 2;
+
+	// targets of the old setup no longer fit
+	if(width!=m_width || height!=m_height || internalFormat!=m_intFormat || numBuffers!=m_numBuffers)
+		releaseTargets();
+
+	m_width = width;
+	m_height = height;
+	m_intFormat = internalFormat;
+	m_numBuffers = numBuffers;
+}
+
+
+unsigned PostProcessChain::addStage(const std::string& name, PostProcessFunc func, void* userData, unsigned divisor)
+{
+	Stage stage;
+	stage.name = name;
+	stage.func = func;
+	stage.userData = userData;
+	stage.divisor = divisor ? divisor : 1;
+	stage.width = 0;
+	stage.height = 0;
+	stage.enabled = true;
+	stage.ring = -1;
+	stage.target = -1;
+	m_stages.push_back(stage);
+	return m_stages.size()-1;
+}
+
+
+unsigned PostProcessChain::addStage(const std::string& name, PostProcessFunc func, void* userData, GLsizei width, GLsizei height)
+{
+	unsigned index = addStage(name, func, userData, 1);
+	m_stages[index].divisor = 0;
+	m_stages[index].width = width;
+	m_stages[index].height = height;
+	return index;
+}
+
+
+void PostProcessChain::setStageEnabled(unsigned stage, bool enable)
+{
+	if(stage<m_stages.size()) m_stages[stage].enabled = enable;
+}
+
+
+GLuint PostProcessChain::execute(GLuint sourceTexture)
+{
+	PostProcessPass pass;
+	pass.inputTexture = sourceTexture;
+	pass.inputWidth = m_width;
+	pass.inputHeight = m_height;
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	for(std::vector<Stage>::iterator it = m_stages.begin(); it != m_stages.end(); ++it)
+	{
+		it->ring = -1;
+		it->target = -1;
+	}
+
+	for(unsigned i=0; i<m_stages.size(); ++i)
+	{
+		Stage& stage = m_stages[i];
+		if(!stage.enabled) continue;
+
+		getOutputSize(stage, pass.outputWidth, pass.outputHeight);
+		int ringIndex = getRing(pass.outputWidth, pass.outputHeight);
+		if(ringIndex<0) break;
+
+		// the previous target of the ring still holds the input, so with
+		// two or more targets the next one is always free to overwrite
+		Ring& ring = m_rings[ringIndex];
+		unsigned targetIndex = ring.next;
+		ring.next = (ring.next+1) % ring.targets.size();
+
+		Target& target = ring.targets[targetIndex];
+		target.stage = i;
+		stage.ring = ringIndex;
+		stage.target = targetIndex;
+
+		// the old contents are overwritten, tilers can skip loading them
+		target.fbo->bind();
+		target.fbo->invalidate();
+		glViewport(0, 0, pass.outputWidth, pass.outputHeight);
+
+		pass.stage = i;
+		if(stage.func) stage.func(*this, pass, stage.userData);
+
+		pass.inputTexture = target.fbo->getAttachmentID(target.color);
+		pass.inputWidth = pass.outputWidth;
+		pass.inputHeight = pass.outputHeight;
+	}
+
+	BindingCache::current().bindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	return pass.inputTexture;
+}
+
+
+void PostProcessChain::reset()
+{
+	releaseTargets();
+	m_stages.clear();
+}
+
+
+GLuint PostProcessChain::getStageTexture(unsigned stage)const
+{
+	if(stage>=m_stages.size() || m_stages[stage].ring<0) return 0;
+
+	// a later stage of the same size may have reused the target
+	const Target& target = m_rings[m_stages[stage].ring].targets[m_stages[stage].target];
+	return target.stage==(int)stage ? target.fbo->getAttachmentID(target.color) : 0;
+}
+
+
+bool PostProcessChain::isStageEnabled(unsigned stage)const
+{
+	return stage<m_stages.size() && m_stages[stage].enabled;
+}
+
+
+unsigned PostProcessChain::getNumStages()const
+{
+	return m_stages.size();
+}
+
+
+unsigned PostProcessChain::getNumTargets()const
+{
+	unsigned count = 0;
+	for(std::vector<Ring>::const_iterator it = m_rings.begin(); it != m_rings.end(); ++it)
+		count += it->targets.size();
+	return count;
+}
+
+
+size_t PostProcessChain::getAllocatedMemory()const
+{
+	size_t bytes = 0;
+	for(std::vector<Ring>::const_iterator it = m_rings.begin(); it != m_rings.end(); ++it)
+		bytes += it->targets.size() * RenderGraph::getBytesPerPixel(m_intFormat) * it->width * it->height;
+	return bytes;
+}
+
+
+size_t PostProcessChain::getUnchainedMemory()const
+{
+	size_t bytes = 0;
+	for(std::vector<Stage>::const_iterator it = m_stages.begin(); it != m_stages.end(); ++it)
+	{
+		if(!it->enabled) continue;
+
+		GLsizei width, height;
+		getOutputSize(*it, width, height);
+		bytes += RenderGraph::getBytesPerPixel(m_intFormat) * width * height;
+	}
+	return bytes;
+}
+
+
+void PostProcessChain::getOutputSize(const Stage& stage, GLsizei& width, GLsizei& height)const
+{
+	if(stage.divisor==0)
+	{
+		width = stage.width;
+		height = stage.height;
+		return;
+	}
+
+	width = m_width / stage.divisor;
+	height = m_height / stage.divisor;
+	if(width<1) width = 1;
+	if(height<1) height = 1;
+}
+
+
+int PostProcessChain::getRing(GLsizei width, GLsizei height)
+{
+	for(unsigned i=0; i<m_rings.size(); ++i)
+	{
+		if(m_rings[i].width==width && m_rings[i].height==height) return i;
+	}
+
+	// first stage of this size, the whole ring is created at once
+	Ring ring;
+	ring.width = width;
+	ring.height = height;
+	ring.next = 0;
+	for(unsigned i=0; i<m_numBuffers; ++i)
+	{
+		Target target;
+		target.fbo = new FrameBufferObject(BTM_WRITE);
+		target.fbo->setAttachmentPooling(true);
+		target.color = target.fbo->attach2DTexture("color", TBT_COLOR, width, height, 0, 0, m_intFormat);
+		target.fbo->setTransient(target.color, true);
+		target.stage = -1;
+		ring.targets.push_back(target);
+
+		if(!target.fbo->isComplete())
+		{
+			std::cerr << "Error: post-process target of " << width << "x" << height << " is incomplete...\n";
+			for(std::vector<Target>::iterator it = ring.targets.begin(); it != ring.targets.end(); ++it)
+				delete it->fbo;
+			return -1;
+		}
+
+		// stages sample the targets as plain textures
+		GLuint id = target.fbo->getAttachmentID(target.color);
+		if(FrameBufferObject::isDirectStateAccessEnabled())
+		{
+			glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		else
+		{
+			BindingCache::current().bindTexture(GL_TEXTURE_2D, id);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+	}
+
+	m_rings.push_back(ring);
+	return m_rings.size()-1;
+}
+
+
+void PostProcessChain::releaseTargets()
+{
+	// pooled fbos hand their textures back on deletion
+	for(std::vector<Ring>::iterator ring = m_rings.begin(); ring != m_rings.end(); ++ring)
+	{
+		for(std::vector<Target>::iterator it = ring->targets.begin(); it != ring->targets.end(); ++it)
+			delete it->fbo;
+	}
+	m_rings.clear();
+
+	for(std::vector<Stage>::iterator it = m_stages.begin(); it != m_stages.end(); ++it)
+	{
+		it->ring = -1;
+		it->target = -1;
+	}
+}
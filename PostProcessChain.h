@@ -0,0 +1,117 @@
+// =================================================================
+//   File      : PostProcessChain.h
+//   Desc	   : Chain of full screen post-processing stages on top
+//				 of FrameBufferObject. Every stage samples the output
+//				 of the previous one and renders into the next target
+//				 of a small ring, so a chain of any length needs only
+//				 N targets per output size instead of one per stage.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef POSTPROCESSCHAIN_H
+#define POSTPROCESSCHAIN_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "FrameBufferObject.h"
+
+class PostProcessChain;
+
+// what a stage samples and where it renders
+struct PostProcessPass {
+	unsigned stage;
+	GLuint inputTexture; // source or output of the previous enabled stage
+	GLsizei inputWidth;
+	GLsizei inputHeight;
+	GLsizei outputWidth;
+	GLsizei outputHeight;
+};
+
+// draws the stage, its target is bound and the viewport covers it
+typedef void (*PostProcessFunc)(PostProcessChain& chain, const PostProcessPass& pass, void* userData);
+
+
+class PostProcessChain
+{
+public:
+
+	 // Constructor/Destructor
+	 PostProcessChain();
+	~PostProcessChain();
+
+	// size and format of the source and of the full size targets. every
+	// output size gets a ring of numBuffers targets, at least 2. a deeper
+	// ring keeps the outputs of earlier stages alive for later ones, see
+	// getStageTexture(). targets are drawn from the AttachmentPool.
+	void setup(GLsizei width, GLsizei height, GLenum internalFormat=GL_RGBA8, unsigned numBuffers=2);
+
+	// Stages run in the order they were added. The first form renders at
+	// 1/divisor of the setup size, the second at an explicit size.
+	unsigned addStage(const std::string& name, PostProcessFunc func, void* userData=NULL, unsigned divisor=1);
+	unsigned addStage(const std::string& name, PostProcessFunc func, void* userData, GLsizei width, GLsizei height);
+	// disabled stages are skipped, the next stage samples their input
+	void setStageEnabled(unsigned stage, bool enable);
+
+	// runs the enabled stages on the source texture and returns the
+	// texture holding the result, the source itself if nothing ran
+	GLuint execute(GLuint sourceTexture);
+	// drops the stages, targets go back to the AttachmentPool
+	void reset();
+
+	// Accessors
+	GLuint		getStageTexture(unsigned stage)const; // 0 once overwritten or if the stage did not run
+	bool		isStageEnabled(unsigned stage)const;
+	unsigned	getNumStages()const;
+	unsigned	getNumTargets()const;
+	size_t		getAllocatedMemory()const; // bytes of the ring targets
+	size_t		getUnchainedMemory()const; // bytes with one target per stage
+
+private:
+
+	PostProcessChain(const PostProcessChain&);
+	PostProcessChain& operator=(const PostProcessChain&);
+
+	struct Stage {
+		std::string name;
+		PostProcessFunc func;
+		void* userData;
+		unsigned divisor; // of the setup size, 0 for an explicit size
+		GLsizei width;
+		GLsizei height;
+		bool enabled;
+		int ring; // where the last execute() wrote the output, -1 if it did not run
+		int target;
+	};
+
+	// render target of a ring
+	struct Target {
+		FrameBufferObject* fbo;
+		AttachmentHandle color;
+		int stage; // stage whose output it holds, -1 if none
+	};
+
+	// targets of one output size, used round-robin
+	struct Ring {
+		GLsizei width;
+		GLsizei height;
+		std::vector<Target> targets;
+		unsigned next;
+	};
+
+	void getOutputSize(const Stage& stage, GLsizei& width, GLsizei& height)const;
+	int getRing(GLsizei width, GLsizei height);
+	void releaseTargets();
+
+	std::vector<Stage>		m_stages;
+	std::vector<Ring>		m_rings;
+	GLsizei					m_width;
+	GLsizei					m_height;
+	GLenum					m_intFormat;
+	unsigned				m_numBuffers;
+
+};
+
+#endif
@@ -0,0 +1,206 @@
+// =================================================================
+//   File      : ReadbackRing.cpp
+//   Desc	   : N-deep ring of pixel pack buffers used to read pixels
+//				 back from the GPU without stalling. Every queued read
+//				 is guarded by a fence and can be mapped once the GPU
+//				 has finished writing it, usually one or two frames
+//				 later.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "ReadbackRing.h"
+
+#include <iostream>
+
+ReadbackRing::ReadbackRing(unsigned depth) : m_head(0), m_tail(0), m_numPending(0), m_serial(0)
+{
+	if(depth==0) depth = 1;
+
+	m_slots.resize(depth);
+	for(unsigned i=0; i<depth; ++i)
+	{
+		Slot& slot = m_slots[i];
+		glGenBuffers(1, &slot.pbo);
+		slot.fence = 0;
+		slot.capacity = 0;
+		slot.state = SS_FREE;
+	}
+}
+
+
+ReadbackRing::~ReadbackRing()
+{
+	for(unsigned i=0; i<m_slots.size(); ++i)
+	{
+		Slot& slot = m_slots[i];
+		if(slot.state==SS_MAPPED)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		if(slot.fence)
+			glDeleteSync(slot.fence);
+		glDeleteBuffers(1, &slot.pbo);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+
+bool ReadbackRing::queue(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+	// ring is full, the client has to consume older reads first
+	Slot& slot = m_slots[m_head];
+	if(slot.state!=SS_FREE) return false;
+
+	GLsizei rowStride = getRowStride(width, format, type);
+	GLsizeiptr size = (GLsizeiptr)rowStride * height;
+	if(size<=0) return false;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+
+	// reallocate only when the slot is too small, steady state reuses storage
+	if(slot.capacity<size)
+	{
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+		slot.capacity = size;
+	}
+
+	// with a pack buffer bound the pointer is an offset, this returns immediately
+	glReadPixels(x, y, width, height, format, type, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.state = SS_PENDING;
+	slot.frame.data = NULL;
+	slot.frame.width = width;
+	slot.frame.height = height;
+	slot.frame.format = format;
+	slot.frame.type = type;
+	slot.frame.rowStride = rowStride;
+	slot.frame.size = size;
+	slot.frame.serial = m_serial++;
+
+	m_head = (m_head+1) % m_slots.size();
+	++m_numPending;
+
+	return true;
+}
+
+
+bool ReadbackRing::mapCompleted(ReadbackFrame& frame, bool wait)
+{
+	Slot& slot = m_slots[m_tail];
+	if(slot.state!=SS_PENDING) return false;
+
+	// poll the fence, the flush bit makes sure the fence eventually signals
+	GLuint64 timeout = wait ? GL_TIMEOUT_IGNORED : 0;
+	GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	if(result==GL_TIMEOUT_EXPIRED || result==GL_WAIT_FAILED) return false;
+
+	glDeleteSync(slot.fence);
+	slot.fence = 0;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	slot.frame.data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.frame.size, GL_MAP_READ_BIT);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// the read is lost, free its slot so the ring moves on to the next one
+	if(slot.frame.data==NULL)
+	{
+		std::cerr << "Error: readback " << slot.frame.serial << " could not be mapped and is dropped...\n";
+		slot.state = SS_FREE;
+		--m_numPending;
+		m_tail = (m_tail+1) % m_slots.size();
+		return false;
+	}
+
+	slot.state = SS_MAPPED;
+	--m_numPending;
+	frame = slot.frame;
+
+	return true;
+}
+
+
+void ReadbackRing::unmapCompleted()
+{
+	Slot& slot = m_slots[m_tail];
+	if(slot.state!=SS_MAPPED) return;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.frame.data = NULL;
+	slot.state = SS_FREE;
+	m_tail = (m_tail+1) % m_slots.size();
+}
+
+
+unsigned ReadbackRing::getDepth()const
+{
+	return m_slots.size();
+}
+
+
+unsigned ReadbackRing::getNumPending()const
+{
+	return m_numPending;
+}
+
+
+GLsizei ReadbackRing::getRowStride(GLsizei width, GLenum format, GLenum type)
+{
+	GLsizei pixelSize = getPixelSize(format, type);
+	if(pixelSize==0) return 0;
+
+	// rows are padded to the current pack alignment
+	GLint alignment = 4;
+	glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+	GLsizei rowSize = width * pixelSize;
+	return (rowSize + alignment - 1) / alignment * alignment;
+}
+
+
+GLsizei ReadbackRing::getPixelSize(GLenum format, GLenum type)
+{
+	// packed types carry every component in a single element
+	switch(type)
+	{
+		case GL_UNSIGNED_SHORT_5_6_5:
+		case GL_UNSIGNED_SHORT_4_4_4_4:
+		case GL_UNSIGNED_SHORT_5_5_5_1: return 2;
+		case GL_UNSIGNED_INT_8_8_8_8:
+		case GL_UNSIGNED_INT_8_8_8_8_REV:
+		case GL_UNSIGNED_INT_2_10_10_10_REV:
+		case GL_UNSIGNED_INT_10F_11F_11F_REV:
+		case GL_UNSIGNED_INT_24_8: return 4;
+		case GL_FLOAT_32_UNSIGNED_INT_24_8_REV: return 8;
+		default: break;
+	}
+
+	GLsizei components;
+	switch(format)
+	{
+		case GL_RED: case GL_GREEN: case GL_BLUE: case GL_RED_INTEGER:
+		case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX: components = 1; break;
+		case GL_RG: case GL_RG_INTEGER: components = 2; break;
+		case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: components = 3; break;
+		case GL_RGBA: case GL_BGRA: case GL_RGBA_INTEGER: components = 4; break;
+		default: return 0;
+	}
+
+	GLsizei componentSize;
+	switch(type)
+	{
+		case GL_UNSIGNED_BYTE: case GL_BYTE: componentSize = 1; break;
+		case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: componentSize = 2; break;
+		case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: componentSize = 4; break;
+		default: return 0;
+	}
+
+	return components * componentSize;
+}
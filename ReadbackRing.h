@@ -0,0 +1,81 @@
+// =================================================================
+//   File      : ReadbackRing.h
+//   Desc	   : N-deep ring of pixel pack buffers used to read pixels
+//				 back from the GPU without stalling. Every queued read
+//				 is guarded by a fence and can be mapped once the GPU
+//				 has finished writing it, usually one or two frames
+//				 later.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef READBACKRING_H
+#define READBACKRING_H
+
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+
+// completed readback as handed back to the client
+struct ReadbackFrame {
+	const void* data; // mapped pixel data, valid until the frame is unmapped
+	GLsizei width;
+	GLsizei height;
+	GLenum format;
+	GLenum type;
+	GLsizei rowStride; // bytes between two rows, includes GL_PACK_ALIGNMENT padding
+	GLsizeiptr size; // total bytes
+	unsigned long serial; // increases by one for each queued read
+};
+
+
+class ReadbackRing
+{
+public:
+
+	 // Constructor/Destructor
+	 ReadbackRing(unsigned depth);
+	~ReadbackRing();
+
+	// queue a read of the current read buffer of the bound read framebuffer.
+	// returns false if every slot is still in flight or mapped.
+	bool queue(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type);
+
+	// map the oldest read if the GPU has finished it. does not block unless
+	// wait is set. returns false if no read is ready. a read whose buffer
+	// cannot be mapped is dropped so the ring keeps moving.
+	bool mapCompleted(ReadbackFrame& frame, bool wait=false);
+	void unmapCompleted();
+
+	// Accessors
+	unsigned getDepth()const;
+	unsigned getNumPending()const;
+	static GLsizei getRowStride(GLsizei width, GLenum format, GLenum type);
+	static GLsizei getPixelSize(GLenum format, GLenum type); // 0 if unknown, needs no context
+
+private:
+
+	ReadbackRing(const ReadbackRing&);
+	ReadbackRing& operator=(const ReadbackRing&);
+
+	enum SLOT_STATE {SS_FREE=0, SS_PENDING, SS_MAPPED};
+
+	// one pixel pack buffer of the ring
+	struct Slot {
+		GLuint pbo;
+		GLsync fence;
+		GLsizeiptr capacity; // allocated bytes, only grows
+		SLOT_STATE state;
+		ReadbackFrame frame;
+	};
+
+	std::vector<Slot>	m_slots;
+	unsigned			m_head; // next slot to queue into
+	unsigned			m_tail; // oldest queued slot
+	unsigned			m_numPending;
+	unsigned long		m_serial;
+
+};
+
+#endif
@@ -0,0 +1,467 @@
+// =================================================================
+//   File      : RenderGraph.cpp
+//   Desc	   : Frame graph on top of FrameBufferObject. Passes
+//				 declare the render targets they read and write, the
+//				 graph culls passes whose results are never used and
+//				 lets render targets with disjoint lifetimes share one
+//				 GL texture. Declare the passes, compile() once and
+//				 execute() every frame until the setup changes.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "RenderGraph.h"
+
+#include <algorithm>
+
+// immutable single level 2D storage, interchangeable with fbo textures in the
+// pool. compile() checks for GL 4.2 or ARB_texture_storage
+static GLuint allocateTexture2D(const AttachmentKey& key)
+{
+	GLuint id;
+	if(FrameBufferObject::isDirectStateAccessEnabled())
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &id);
+		glTextureStorage2D(id, 1, key.intFormat, key.width, key.height);
+		return id;
+	}
+
+	glGenTextures(1, &id);
+	BindingCache::current().bindTexture(GL_TEXTURE_2D, id);
+	glTexStorage2D(GL_TEXTURE_2D, 1, key.intFormat, key.width, key.height);
+	return id;
+}
+
+
+static bool isSameKey(const AttachmentKey& a, const AttachmentKey& b)
+{
+	return !(a<b) && !(b<a);
+}
+
+
+RenderGraph::RenderGraph() : m_compiled(false), m_compileFailed(false), m_unaliasedMemory(0), m_allocatedMemory(0), m_peakMemory(0)
+{
+}
+
+
+RenderGraph::~RenderGraph()
+{
+	releaseTextures();
+}
+
+
+unsigned RenderGraph::createTexture(const std::string& name, TEXTURE_BUFFER_TYPE type, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	Resource resource;
+	resource.name = name;
+	resource.type = type;
+	resource.intFormat = internalFormat;
+	resource.width = width;
+	resource.height = height;
+	resource.importedId = 0;
+	resource.output = false;
+	resource.firstUse = -1;
+	resource.lastUse = -1;
+	resource.texture = -1;
+
+	m_resources.push_back(resource);
+	m_compiled = false;
+	m_compileFailed = false;
+	return m_resources.size()-1;
+}
+
+
+unsigned RenderGraph::importTexture(const std::string& name, TEXTURE_BUFFER_TYPE type, GLuint textureId, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	unsigned resource = createTexture(name, type, internalFormat, width, height);
+	m_resources[resource].importedId = textureId;
+	m_resources[resource].output = true;
+	return resource;
+}
+
+
+unsigned RenderGraph::addPass(const std::string& name, RenderPassFunc func, void* userData)
+{
+	Pass pass;
+	pass.name = name;
+	pass.func = func;
+	pass.userData = userData;
+	pass.culled = false;
+	pass.fbo = NULL;
+
+	m_passes.push_back(pass);
+	m_compiled = false;
+	m_compileFailed = false;
+	return m_passes.size()-1;
+}
+
+
+void RenderGraph::read(unsigned pass, unsigned resource)
+{
+	if(pass>=m_passes.size() || resource>=m_resources.size())
+	{
+		std::cerr << "Error: render graph read of unknown pass or resource...\n";
+		return;
+	}
+
+	Access access;
+	access.resource = resource;
+	access.write = false;
+	access.colorSlot = 0;
+	m_passes[pass].accesses.push_back(access);
+	m_compiled = false;
+	m_compileFailed = false;
+}
+
+
+void RenderGraph::write(unsigned pass, unsigned resource, GLuint colorSlot)
+{
+	if(pass>=m_passes.size() || resource>=m_resources.size())
+	{
+		std::cerr << "Error: render graph write of unknown pass or resource...\n";
+		return;
+	}
+
+	Access access;
+	access.resource = resource;
+	access.write = true;
+	access.colorSlot = colorSlot;
+	m_passes[pass].accesses.push_back(access);
+	m_compiled = false;
+	m_compileFailed = false;
+}
+
+
+void RenderGraph::markOutput(unsigned resource)
+{
+	if(resource<m_resources.size())
+		m_resources[resource].output = true;
+	m_compiled = false;
+	m_compileFailed = false;
+}
+
+
+bool RenderGraph::compile()
+{
+	releaseTextures();
+	// until the end is reached, execute() does not retry
+	m_compileFailed = true;
+
+	if(!(GLEW_VERSION_4_2 || GLEW_ARB_texture_storage))
+	{
+		std::cerr << "Error: render graph requires immutable texture storage...\n";
+		return false;
+	}
+
+	// every read must see an earlier write or an imported texture
+	std::vector<bool> written(m_resources.size(), false);
+	for(std::vector<Pass>::const_iterator pass = m_passes.begin(); pass != m_passes.end(); ++pass)
+	{
+		for(std::vector<Access>::const_iterator it = pass->accesses.begin(); it != pass->accesses.end(); ++it)
+		{
+			const Resource& resource = m_resources[it->resource];
+			if(!it->write && !written[it->resource] && resource.importedId==0)
+			{
+				std::cerr << "Error: pass " << pass->name << " reads " << resource.name << " before it is written...\n";
+				return false;
+			}
+			if(it->write) written[it->resource] = true;
+		}
+	}
+
+	// walk backwards from the outputs, a pass survives if a later
+	// surviving pass or the client needs something it writes
+	std::vector<bool> needed(m_resources.size(), false);
+	for(unsigned i=0; i<m_resources.size(); ++i)
+		needed[i] = m_resources[i].output;
+
+	for(int p=(int)m_passes.size()-1; p>=0; --p)
+	{
+		Pass& pass = m_passes[p];
+		pass.culled = true;
+		for(std::vector<Access>::const_iterator it = pass.accesses.begin(); it != pass.accesses.end(); ++it)
+		{
+			if(it->write && needed[it->resource]) pass.culled = false;
+		}
+
+		if(pass.culled) continue;
+		for(std::vector<Access>::const_iterator it = pass.accesses.begin(); it != pass.accesses.end(); ++it)
+		{
+			if(!it->write) needed[it->resource] = true;
+		}
+	}
+
+	// lifetimes in execution order, outputs live until the end of the frame
+	m_order.clear();
+	for(unsigned p=0; p<m_passes.size(); ++p)
+	{
+		if(m_passes[p].culled) continue;
+
+		int position = (int)m_order.size();
+		m_order.push_back(p);
+		for(std::vector<Access>::const_iterator it = m_passes[p].accesses.begin(); it != m_passes[p].accesses.end(); ++it)
+		{
+			Resource& resource = m_resources[it->resource];
+			if(resource.firstUse<0) resource.firstUse = position;
+			resource.lastUse = position;
+		}
+	}
+	for(std::vector<Resource>::iterator it = m_resources.begin(); it != m_resources.end(); ++it)
+	{
+		if(it->output && it->firstUse>=0) it->lastUse = (int)m_order.size();
+	}
+
+	// resources in order of first use, each takes the first texture of the
+	// same format whose previous user is done
+	std::vector<unsigned> byFirstUse;
+	for(unsigned i=0; i<m_resources.size(); ++i)
+	{
+		if(m_resources[i].firstUse>=0 && m_resources[i].importedId==0)
+			byFirstUse.push_back(i);
+	}
+	for(unsigned i=1; i<byFirstUse.size(); ++i)
+	{
+		// insertion sort, stable and the list is nearly sorted already
+		unsigned value = byFirstUse[i];
+		unsigned j = i;
+		for(; j>0 && m_resources[byFirstUse[j-1]].firstUse>m_resources[value].firstUse; --j)
+			byFirstUse[j] = byFirstUse[j-1];
+		byFirstUse[j] = value;
+	}
+
+	m_unaliasedMemory = 0;
+	for(std::vector<unsigned>::const_iterator it = byFirstUse.begin(); it != byFirstUse.end(); ++it)
+	{
+		Resource& resource = m_resources[*it];
+
+		AttachmentKey key;
+		key.type = POT_TEXTURE_2D;
+		key.intFormat = resource.intFormat;
+		key.width = resource.width;
+		key.height = resource.height;
+		key.depth = 0;
+		key.samples = 0;
+		key.levels = 1;
+
+		resource.texture = -1;
+		for(unsigned t=0; t<m_textures.size(); ++t)
+		{
+			if(m_textures[t].lastUse<resource.firstUse && isSameKey(m_textures[t].key, key))
+			{
+				resource.texture = (int)t;
+				break;
+			}
+		}
+
+		if(resource.texture<0)
+		{
+			Texture texture;
+			texture.key = key;
+			texture.id = 0;
+			m_textures.push_back(texture);
+			resource.texture = (int)m_textures.size()-1;
+		}
+		m_textures[resource.texture].lastUse = resource.lastUse;
+
+		m_unaliasedMemory += getBytesPerPixel(resource.intFormat) * resource.width * resource.height;
+	}
+
+	// memory estimates
+	m_allocatedMemory = 0;
+	for(std::vector<Texture>::const_iterator it = m_textures.begin(); it != m_textures.end(); ++it)
+		m_allocatedMemory += getBytesPerPixel(it->key.intFormat) * it->key.width * it->key.height;
+
+	m_peakMemory = 0;
+	for(int position=0; position<(int)m_order.size(); ++position)
+	{
+		size_t live = 0;
+		for(std::vector<unsigned>::const_iterator it = byFirstUse.begin(); it != byFirstUse.end(); ++it)
+		{
+			const Resource& resource = m_resources[*it];
+			if(resource.firstUse<=position && position<=resource.lastUse)
+				live += getBytesPerPixel(resource.intFormat) * resource.width * resource.height;
+		}
+		m_peakMemory = std::max(m_peakMemory, live);
+	}
+
+	// textures come from the pool, so recompiling an unchanged graph is cheap
+	for(std::vector<Texture>::iterator it = m_textures.begin(); it != m_textures.end(); ++it)
+	{
+		it->id = AttachmentPool::getInstance().acquire(it->key);
+		if(it->id==0) it->id = allocateTexture2D(it->key);
+	}
+
+	// one fbo per surviving pass with its written resources attached,
+	// a resource whose lifetime ends in the pass is discarded after it
+	for(int position=0; position<(int)m_order.size(); ++position)
+	{
+		Pass& pass = m_passes[m_order[position]];
+		pass.fbo = new FrameBufferObject(BTM_WRITE);
+
+		for(std::vector<Access>::const_iterator it = pass.accesses.begin(); it != pass.accesses.end(); ++it)
+		{
+			if(!it->write) continue;
+
+			const Resource& resource = m_resources[it->resource];
+			AttachmentHandle handle = pass.fbo->attachExternalTexture(resource.name, resource.type, getTextureID(it->resource), resource.intFormat, resource.width, resource.height, 0, it->colorSlot);
+			if(resource.lastUse==position)
+				pass.fbo->setTransient(handle, true);
+		}
+
+		// validated once here, execute() runs without status queries
+		if(!pass.fbo->isComplete())
+		{
+			std::cerr << "Error: pass " << pass.name << " has an incomplete framebuffer...\n";
+			releaseTextures();
+			return false;
+		}
+	}
+
+	m_compiled = true;
+	m_compileFailed = false;
+	return true;
+}
+
+
+void RenderGraph::execute()
+{
+	// a failed compile is retried once the graph has been edited, not
+	// every frame
+	if(!m_compiled && (m_compileFailed || !compile())) return;
+
+	for(std::vector<unsigned>::const_iterator it = m_order.begin(); it != m_order.end(); ++it)
+	{
+		Pass& pass = m_passes[*it];
+		pass.fbo->bind();
+		if(pass.func) pass.func(*this, *pass.fbo, pass.userData);
+		pass.fbo->invalidate();
+	}
+
+	BindingCache::current().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+void RenderGraph::reset()
+{
+	releaseTextures();
+	m_resources.clear();
+	m_passes.clear();
+	m_order.clear();
+	m_unaliasedMemory = 0;
+	m_allocatedMemory = 0;
+	m_peakMemory = 0;
+}
+
+
+void RenderGraph::printReport(std::ostream& out)const
+{
+	out << "render graph: " << m_passes.size() << " passes, " << m_passes.size()-m_order.size() << " culled\n";
+
+	for(unsigned p=0; p<m_passes.size(); ++p)
+		out << (m_passes[p].culled ? "  culled   " : "  pass     ") << m_passes[p].name << "\n";
+
+	for(std::vector<Resource>::const_iterator it = m_resources.begin(); it != m_resources.end(); ++it)
+	{
+		out << "  resource " << it->name;
+		if(it->importedId)
+			out << " -> imported texture " << it->importedId << "\n";
+		else if(it->texture<0)
+			out << " -> unused\n";
+		else
+			out << " -> texture " << it->texture << ", passes " << it->firstUse << "-" << it->lastUse << "\n";
+	}
+
+	out << "  memory   " << m_unaliasedMemory/1024 << " KB unaliased, " << m_allocatedMemory/1024 << " KB allocated in "
+		<< m_textures.size() << " textures, " << m_peakMemory/1024 << " KB peak live\n";
+}
+
+
+GLuint RenderGraph::getTextureID(unsigned resource)const
+{
+	if(resource>=m_resources.size()) return 0;
+
+	const Resource& r = m_resources[resource];
+	if(r.importedId) return r.importedId;
+	return r.texture>=0 && r.texture<(int)m_textures.size() ? m_textures[r.texture].id : 0;
+}
+
+
+bool RenderGraph::isPassCulled(unsigned pass)const
+{
+	return pass<m_passes.size() ? m_passes[pass].culled : true;
+}
+
+
+unsigned RenderGraph::getNumPasses()const
+{
+	return m_passes.size();
+}
+
+
+unsigned RenderGraph::getNumTextures()const
+{
+	return m_textures.size();
+}
+
+
+size_t RenderGraph::getUnaliasedMemory()const
+{
+	return m_unaliasedMemory;
+}
+
+
+size_t RenderGraph::getAllocatedMemory()const
+{
+	return m_allocatedMemory;
+}
+
+
+size_t RenderGraph::getPeakMemory()const
+{
+	return m_peakMemory;
+}
+
+
+size_t RenderGraph::getBytesPerPixel(GLenum internalFormat)
+{
+	switch(internalFormat)
+	{
+		case GL_R8: case GL_R8I: case GL_R8UI: case GL_STENCIL_INDEX8:
+			return 1;
+		case GL_RG8: case GL_R16F: case GL_R16: case GL_R16I: case GL_R16UI:
+		case GL_DEPTH_COMPONENT16: case GL_RGB565:
+			return 2;
+		case GL_RGBA16F: case GL_RGBA16: case GL_RGBA16I: case GL_RGBA16UI:
+		case GL_RG32F: case GL_RG32I: case GL_RG32UI: case GL_DEPTH32F_STENCIL8:
+			return 8;
+		case GL_RGBA32F: case GL_RGBA32I: case GL_RGBA32UI:
+			return 16;
+		default: // RGBA8, RGB10_A2, R11F_G11F_B10F, R32F, RG16F, DEPTH24_STENCIL8, ...
+			return 4;
+	}
+}
+
+
+void RenderGraph::releaseTextures()
+{
+	// fbos first, they still reference the textures
+	for(std::vector<Pass>::iterator it = m_passes.begin(); it != m_passes.end(); ++it)
+	{
+		delete it->fbo;
+		it->fbo = NULL;
+	}
+
+	for(std::vector<Texture>::const_iterator it = m_textures.begin(); it != m_textures.end(); ++it)
+		AttachmentPool::getInstance().release(it->key, it->id);
+	m_textures.clear();
+
+	for(std::vector<Resource>::iterator it = m_resources.begin(); it != m_resources.end(); ++it)
+	{
+		it->firstUse = -1;
+		it->lastUse = -1;
+		it->texture = -1;
+	}
+	m_compiled = false;
+	m_compileFailed = false;
+}
@@ -0,0 +1,129 @@
+// =================================================================
+//   File      : RenderGraph.h
+//   Desc	   : Frame graph on top of FrameBufferObject. Passes
+//				 declare the render targets they read and write, the
+//				 graph culls passes whose results are never used and
+//				 lets render targets with disjoint lifetimes share one
+//				 GL texture. Declare the passes, compile() once and
+//				 execute() every frame until the setup changes.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "FrameBufferObject.h"
+
+class RenderGraph;
+
+// records the commands of a pass, the pass fbo is bound when it is called
+typedef void (*RenderPassFunc)(RenderGraph& graph, FrameBufferObject& fbo, void* userData);
+
+
+class RenderGraph
+{
+public:
+
+	 // Constructor/Destructor
+	 RenderGraph();
+	~RenderGraph();
+
+	// Declaration
+	// Resources and passes are identified by the index returned here.
+	// Passes run in declaration order, which is also the order in which
+	// their reads and writes of a resource take effect.
+	unsigned createTexture(const std::string& name, TEXTURE_BUFFER_TYPE type, GLenum internalFormat, GLsizei width, GLsizei height);
+	unsigned importTexture(const std::string& name, TEXTURE_BUFFER_TYPE type, GLuint textureId, GLenum internalFormat, GLsizei width, GLsizei height);
+	unsigned addPass(const std::string& name, RenderPassFunc func, void* userData=NULL);
+	void read(unsigned pass, unsigned resource);
+	void write(unsigned pass, unsigned resource, GLuint colorSlot=0);
+	// passes that contribute to an output are never culled, imported
+	// textures are outputs as well
+	void markOutput(unsigned resource);
+
+	// culls, assigns textures and builds the pass fbos. returns false if
+	// a resource is read before any pass wrote it or if a pass fbo is
+	// incomplete. execute() compiles when needed, after a failure only
+	// once the declarations have changed again.
+	bool compile();
+	void execute();
+	// drops all declarations, textures go back to the AttachmentPool
+	void reset();
+
+	// Report
+	void printReport(std::ostream& out)const;
+
+	// Accessors
+	GLuint		getTextureID(unsigned resource)const; // 0 before compile() or if culled
+	bool		isPassCulled(unsigned pass)const;
+	unsigned	getNumPasses()const;
+	unsigned	getNumTextures()const; // GL textures backing the resources
+	size_t		getUnaliasedMemory()const; // bytes without aliasing
+	size_t		getAllocatedMemory()const; // bytes of the GL textures
+	size_t		getPeakMemory()const; // largest sum of live resources at any pass
+
+	static size_t getBytesPerPixel(GLenum internalFormat);
+
+private:
+
+	RenderGraph(const RenderGraph&);
+	RenderGraph& operator=(const RenderGraph&);
+
+	void releaseTextures();
+
+	// declared render target
+	struct Resource {
+		std::string name;
+		TEXTURE_BUFFER_TYPE type;
+		GLenum intFormat;
+		GLsizei width;
+		GLsizei height;
+		GLuint importedId; // 0 for graph owned resources
+		bool output;
+		int firstUse; // position in the execution order, -1 if unused
+		int lastUse;
+		int texture; // entry of m_textures, -1 if imported or unused
+	};
+
+	// one read or write of a pass
+	struct Access {
+		unsigned resource;
+		bool write;
+		GLuint colorSlot;
+	};
+
+	struct Pass {
+		std::string name;
+		RenderPassFunc func;
+		void* userData;
+		std::vector<Access> accesses;
+		bool culled;
+		FrameBufferObject* fbo; // built by compile()
+	};
+
+	// GL texture shared by resources with disjoint lifetimes
+	struct Texture {
+		AttachmentKey key;
+		GLuint id;
+		int lastUse;
+	};
+
+	std::vector<Resource>	m_resources;
+	std::vector<Pass>		m_passes;
+	std::vector<Texture>	m_textures;
+	std::vector<unsigned>	m_order; // surviving passes in execution order
+	bool					m_compiled;
+	bool					m_compileFailed; // until the declarations change
+
+	size_t					m_unaliasedMemory;
+	size_t					m_allocatedMemory;
+	size_t					m_peakMemory;
+
+};
+
+#endif
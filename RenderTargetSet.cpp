@@ -0,0 +1,520 @@
+// =================================================================
+//   File      : RenderTargetSet.cpp
+//   Desc	   : A set of FrameBufferObjects described in a small text
+//				 format and built in one pre-warm pass at startup.
+//				 Every attachment is allocated, each fbo is validated
+//				 once and all storage is touched with a clear before
+//				 the first frame, so the driver does not commit memory
+//				 lazily in the middle of rendering.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "RenderTargetSet.h"
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+// internal formats known to the description
+struct FormatName {
+	const char* name;
+	GLenum format;
+};
+
+static const FormatName g_formatNames[] = {
+	{"R8", GL_R8}, {"RG8", GL_RG8}, {"RGB8", GL_RGB8}, {"RGBA8", GL_RGBA8}, {"SRGB8_ALPHA8", GL_SRGB8_ALPHA8},
+	{"RGB10_A2", GL_RGB10_A2}, {"R11F_G11F_B10F", GL_R11F_G11F_B10F}, {"RGBA16", GL_RGBA16},
+	{"R16F", GL_R16F}, {"RG16F", GL_RG16F}, {"RGBA16F", GL_RGBA16F},
+	{"R32F", GL_R32F}, {"RG32F", GL_RG32F}, {"RGBA32F", GL_RGBA32F},
+	{"R8UI", GL_R8UI}, {"R32UI", GL_R32UI}, {"RGBA8UI", GL_RGBA8UI}, {"RGBA32UI", GL_RGBA32UI},
+	{"R32I", GL_R32I}, {"RGBA32I", GL_RGBA32I},
+	{"DEPTH_COMPONENT16", GL_DEPTH_COMPONENT16}, {"DEPTH_COMPONENT24", GL_DEPTH_COMPONENT24}, {"DEPTH_COMPONENT32F", GL_DEPTH_COMPONENT32F},
+	{"DEPTH24_STENCIL8", GL_DEPTH24_STENCIL8}, {"DEPTH32F_STENCIL8", GL_DEPTH32F_STENCIL8}, {"STENCIL_INDEX8", GL_STENCIL_INDEX8}
+};
+static const unsigned g_numFormatNames = sizeof(g_formatNames)/sizeof(g_formatNames[0]);
+
+static GLenum findFormat(std::string name)
+{
+	if(name.compare(0, 3, "GL_")==0) name = name.substr(3);
+	for(unsigned i=0; i<g_numFormatNames; ++i)
+	{
+		if(name==g_formatNames[i].name) return g_formatNames[i].format;
+	}
+	return GL_NONE;
+}
+
+static const char* getFormatName(GLenum format)
+{
+	for(unsigned i=0; i<g_numFormatNames; ++i)
+	{
+		if(format==g_formatNames[i].format) return g_formatNames[i].name;
+	}
+	return "?";
+}
+
+// positive integer, no sign or trailing characters
+static bool parseCount(const std::string& text, GLsizei& value)
+{
+	char* end = NULL;
+	long parsed = strtol(text.c_str(), &end, 10);
+	if(text.empty() || *end!='\0' || parsed<=0) return false;
+	value = (GLsizei)parsed;
+	return true;
+}
+
+
+RenderTargetSet::RenderTargetSet() : m_windowWidth(0), m_windowHeight(0), m_allocatedMemory(0), m_prewarmTime(0.0)
+{
+}
+
+
+RenderTargetSet::~RenderTargetSet()
+{
+	release();
+}
+
+
+bool RenderTargetSet::load(std::istream& in, const std::string& source)
+{
+	std::vector<Framebuffer> framebuffers;
+	std::string text, error;
+	unsigned lineNumber = 0;
+	bool valid = true;
+	while(std::getline(in, text))
+	{
+		++lineNumber;
+		text = text.substr(0, text.find('#'));
+
+		std::istringstream line(text);
+		if(!parseLine(line, framebuffers, error))
+		{
+			std::cerr << "Error: " << source << ":" << lineNumber << ": " << error << "...\n";
+			valid = false;
+		}
+	}
+	if(!valid) return false;
+
+	release();
+	m_framebuffers.swap(framebuffers);
+	return true;
+}
+
+
+bool RenderTargetSet::loadFile(const std::string& path)
+{
+	std::ifstream in(path.c_str());
+	if(!in)
+	{
+		std::cerr << "Error: render target description " << path << " could not be opened...\n";
+		return false;
+	}
+	return load(in, path);
+}
+
+
+bool RenderTargetSet::prewarm(GLsizei windowWidth, GLsizei windowHeight)
+{
+	release();
+	m_windowWidth = windowWidth;
+	m_windowHeight = windowHeight;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// all storage first, so the driver sees the allocations back to back
+	bool complete = true;
+	for(std::vector<Framebuffer>::iterator it = m_framebuffers.begin(); it != m_framebuffers.end(); ++it)
+		complete = build(*it) && complete;
+
+	// validated once here, the result stays cached in the fbos
+	for(std::vector<Framebuffer>::iterator it = m_framebuffers.begin(); it != m_framebuffers.end(); ++it)
+	{
+		if(!it->fbo->isComplete())
+		{
+			std::cerr << "Error: fbo " << it->name << " of the render target set is incomplete...\n";
+			complete = false;
+		}
+	}
+
+	// a clear makes the driver commit the memory now instead of at the
+	// first draw, the fbos then skip a first clear to zero
+	const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	for(std::vector<Framebuffer>::iterator it = m_framebuffers.begin(); it != m_framebuffers.end(); ++it)
+	{
+		if(it->fbo->isComplete()) it->fbo->clear(zero, 1.0f, 0);
+	}
+	BindingCache::current().bindFramebuffer(GL_FRAMEBUFFER, 0);
+	glFinish();
+
+	m_prewarmTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	updateMemory();
+	return complete;
+}
+
+
+bool RenderTargetSet::resize(GLsizei windowWidth, GLsizei windowHeight)
+{
+	if(windowWidth==m_windowWidth && windowHeight==m_windowHeight) return true;
+	m_windowWidth = windowWidth;
+	m_windowHeight = windowHeight;
+
+	bool complete = true;
+	for(std::vector<Framebuffer>::iterator it = m_framebuffers.begin(); it != m_framebuffers.end(); ++it)
+	{
+		if(it->fbo==NULL || !isWindowRelative(*it)) continue;
+
+		destroy(*it);
+		const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		if(build(*it) && it->fbo->isComplete())
+			it->fbo->clear(zero, 1.0f, 0);
+		else
+			complete = false;
+	}
+	BindingCache::current().bindFramebuffer(GL_FRAMEBUFFER, 0);
+	updateMemory();
+	return complete;
+}
+
+
+void RenderTargetSet::release()
+{
+	for(std::vector<Framebuffer>::iterator it = m_framebuffers.begin(); it != m_framebuffers.end(); ++it)
+		destroy(*it);
+	m_allocatedMemory = 0;
+}
+
+
+void RenderTargetSet::printReport(std::ostream& out)const
+{
+	out << "render targets: " << m_framebuffers.size() << " fbos, " << getNumAttachments() << " attachments, "
+		<< m_allocatedMemory/1024 << " KB, prewarmed in " << m_prewarmTime << " ms\n";
+
+	for(std::vector<Framebuffer>::const_iterator it = m_framebuffers.begin(); it != m_framebuffers.end(); ++it)
+	{
+		out << "  fbo      " << it->name << (it->fbo ? "\n" : " -> not built\n");
+		for(std::vector<Target>::const_iterator target = it->targets.begin(); target != it->targets.end(); ++target)
+		{
+			GLsizei width, height;
+			getTargetSize(*target, width, height);
+			out << "    " << (target->isRenderBuffer ? "renderbuffer " : "texture      ") << target->name << " "
+				<< getFormatName(target->intFormat) << " " << width << "x" << height;
+			if(target->samples>0) out << " x" << target->samples << " samples";
+			out << " -> " << target->memory/1024 << " KB\n";
+		}
+	}
+}
+
+
+FrameBufferObject* RenderTargetSet::getFramebuffer(const std::string& name)const
+{
+	for(std::vector<Framebuffer>::const_iterator it = m_framebuffers.begin(); it != m_framebuffers.end(); ++it)
+	{
+		if(it->name==name) return it->fbo;
+	}
+	return NULL;
+}
+
+
+AttachmentHandle RenderTargetSet::getAttachment(const std::string& framebuffer, const std::string& attachment)const
+{
+	for(std::vector<Framebuffer>::const_iterator it = m_framebuffers.begin(); it != m_framebuffers.end(); ++it)
+	{
+		if(it->name!=framebuffer) continue;
+
+		for(std::vector<Target>::const_iterator target = it->targets.begin(); target != it->targets.end(); ++target)
+		{
+			if(target->name==attachment) return target->handle;
+		}
+	}
+	return AttachmentHandle();
+}
+
+
+unsigned RenderTargetSet::getNumFramebuffers()const
+{
+	return m_framebuffers.size();
+}
+
+
+unsigned RenderTargetSet::getNumAttachments()const
+{
+	unsigned numAttachments = 0;
+	for(std::vector<Framebuffer>::const_iterator it = m_framebuffers.begin(); it != m_framebuffers.end(); ++it)
+		numAttachments += it->targets.size();
+	return numAttachments;
+}
+
+
+size_t RenderTargetSet::getAllocatedMemory()const
+{
+	return m_allocatedMemory;
+}
+
+
+double RenderTargetSet::getPrewarmTime()const
+{
+	return m_prewarmTime;
+}
+
+
+bool RenderTargetSet::parseLine(std::istream& line, std::vector<Framebuffer>& framebuffers, std::string& error)
+{
+	std::string keyword;
+	if(!(line >> keyword)) return true;
+
+	if(keyword=="fbo")
+	{
+		Framebuffer framebuffer;
+		framebuffer.mode = BTM_WRITE;
+		framebuffer.fbo = NULL;
+
+		std::string mode;
+		if(!(line >> framebuffer.name))
+		{
+			error = "fbo without a name";
+			return false;
+		}
+		if(line >> mode)
+		{
+			if(mode=="read") framebuffer.mode = BTM_READ;
+			else if(mode=="write") framebuffer.mode = BTM_WRITE;
+			else if(mode=="readwrite") framebuffer.mode = BTM_READ_WRITE;
+			else
+			{
+				error = "unknown fbo mode " + mode;
+				return false;
+			}
+		}
+		for(std::vector<Framebuffer>::const_iterator it = framebuffers.begin(); it != framebuffers.end(); ++it)
+		{
+			if(it->name==framebuffer.name)
+			{
+				error = "fbo " + framebuffer.name + " is declared twice";
+				return false;
+			}
+		}
+		framebuffers.push_back(framebuffer);
+	}
+	else if(keyword=="texture" || keyword=="renderbuffer")
+	{
+		if(framebuffers.empty())
+		{
+			error = keyword + " before the first fbo";
+			return false;
+		}
+
+		Target target;
+		if(!parseTarget(line, keyword=="renderbuffer", target, error)) return false;
+
+		std::vector<Target>& targets = framebuffers.back().targets;
+		for(std::vector<Target>::const_iterator it = targets.begin(); it != targets.end(); ++it)
+		{
+			if(it->name==target.name)
+			{
+				error = "attachment " + target.name + " is declared twice";
+				return false;
+			}
+		}
+		targets.push_back(target);
+	}
+	else
+	{
+		error = "unknown declaration " + keyword;
+		return false;
+	}
+
+	std::string rest;
+	if(line >> rest)
+	{
+		error = "unexpected " + rest;
+		return false;
+	}
+	return true;
+}
+
+
+bool RenderTargetSet::parseTarget(std::istream& line, bool isRenderBuffer, Target& target, std::string& error)
+{
+	target.isRenderBuffer = isRenderBuffer;
+	target.colorSlot = 0;
+	target.width = target.height = 0;
+	target.scale = 1.0f;
+	target.samples = 0;
+	target.levels = 1;
+	target.memory = 0;
+
+	std::string buffer, format, size;
+	if(!(line >> target.name >> buffer >> format >> size))
+	{
+		error = "expected <name> <buffer> <format> <size>";
+		return false;
+	}
+
+	// attachment point
+	GLsizei slot = 0;
+	if(buffer=="depth") target.type = TBT_DEPTH;
+	else if(buffer=="stencil") target.type = TBT_STENCIL;
+	else if(buffer=="depthstencil") target.type = TBT_DEPTH_AND_STENCIL;
+	else if(buffer.compare(0, 5, "color")==0 && (buffer.size()==5 || parseCount(buffer.substr(5), slot) || buffer.substr(5)=="0"))
+	{
+		target.type = TBT_COLOR;
+		target.colorSlot = slot;
+	}
+	else
+	{
+		error = "unknown buffer " + buffer;
+		return false;
+	}
+
+	target.intFormat = findFormat(format);
+	if(target.intFormat==GL_NONE)
+	{
+		error = "unknown format " + format;
+		return false;
+	}
+
+	// *scale of the window or WxH pixels
+	char* end = NULL;
+	if(size[0]=='*')
+	{
+		target.scale = (float)strtod(size.c_str()+1, &end);
+		if(size.size()==1 || *end!='\0' || !(target.scale>0.0f) || !std::isfinite(target.scale))
+		{
+			error = "invalid window scale " + size;
+			return false;
+		}
+	}
+	else
+	{
+		std::string::size_type x = size.find('x');
+		if(x==std::string::npos || !parseCount(size.substr(0, x), target.width) || !parseCount(size.substr(x+1), target.height))
+		{
+			error = "invalid size " + size;
+			return false;
+		}
+	}
+
+	// options
+	std::string option;
+	while(line >> option)
+	{
+		std::string::size_type equals = option.find('=');
+		std::string key = option.substr(0, equals);
+		std::string value = equals==std::string::npos ? std::string() : option.substr(equals+1);
+
+		if(key=="samples" && parseCount(value, target.samples))
+			continue;
+		if(key=="levels" && !isRenderBuffer && value=="full")
+			target.levels = FrameBufferObject::FULL_MIP_CHAIN;
+		else if(!(key=="levels" && !isRenderBuffer && parseCount(value, target.levels)))
+		{
+			error = "invalid option " + option;
+			return false;
+		}
+	}
+
+	if(target.samples>0 && target.levels!=1)
+	{
+		error = "multisampled texture " + target.name + " cannot have mip levels";
+		return false;
+	}
+	return true;
+}
+
+
+bool RenderTargetSet::isWindowRelative(const Framebuffer& framebuffer)
+{
+	for(std::vector<Target>::const_iterator it = framebuffer.targets.begin(); it != framebuffer.targets.end(); ++it)
+	{
+		if(it->width==0) return true;
+	}
+	return false;
+}
+
+
+bool RenderTargetSet::build(Framebuffer& framebuffer)
+{
+	framebuffer.fbo = new FrameBufferObject(framebuffer.mode);
+
+	bool created = true;
+	for(std::vector<Target>::iterator it = framebuffer.targets.begin(); it != framebuffer.targets.end(); ++it)
+	{
+		GLsizei width, height;
+		getTargetSize(*it, width, height);
+
+		// the buffer types of renderbuffers and textures line up
+		FrameBufferObject& fbo = *framebuffer.fbo;
+		if(it->isRenderBuffer && it->samples>0)
+			it->handle = fbo.createMultisampleRenderBufferAndAttach(it->name, (RBUFFER_TYPE)it->type, it->intFormat, it->samples, width, height, it->colorSlot);
+		else if(it->isRenderBuffer)
+			it->handle = fbo.createRenderBufferAndAttach(it->name, (RBUFFER_TYPE)it->type, it->intFormat, width, height, it->colorSlot);
+		else if(it->samples>0)
+			it->handle = fbo.attach2DMultisampleTexture(it->name, it->type, it->samples, width, height, it->colorSlot, it->intFormat);
+		else
+			it->handle = fbo.attach2DTexture(it->name, it->type, width, height, 0, it->colorSlot, it->intFormat, it->levels);
+
+		if(!it->handle.isValid())
+		{
+			std::cerr << "Error: attachment " << it->name << " of fbo " << framebuffer.name << " could not be created...\n";
+			created = false;
+		}
+	}
+	return created;
+}
+
+
+void RenderTargetSet::destroy(Framebuffer& framebuffer)
+{
+	delete framebuffer.fbo;
+	framebuffer.fbo = NULL;
+	for(std::vector<Target>::iterator it = framebuffer.targets.begin(); it != framebuffer.targets.end(); ++it)
+	{
+		it->handle = AttachmentHandle();
+		it->memory = 0;
+	}
+}
+
+
+void RenderTargetSet::getTargetSize(const Target& target, GLsizei& width, GLsizei& height)const
+{
+	if(target.width>0)
+	{
+		width = target.width;
+		height = target.height;
+		return;
+	}
+	// a huge scale must not overflow the conversion, the allocation reports it
+	width = (GLsizei)std::min(std::max(m_windowWidth * (double)target.scale + 0.5, 1.0), (double)INT_MAX);
+	height = (GLsizei)std::min(std::max(m_windowHeight * (double)target.scale + 0.5, 1.0), (double)INT_MAX);
+}
+
+
+void RenderTargetSet::updateMemory()
+{
+	m_allocatedMemory = 0;
+	for(std::vector<Framebuffer>::iterator it = m_framebuffers.begin(); it != m_framebuffers.end(); ++it)
+	{
+		if(it->fbo==NULL) continue;
+
+		for(std::vector<Target>::iterator target = it->targets.begin(); target != it->targets.end(); ++target)
+		{
+			GLsizei width, height;
+			getTargetSize(*target, width, height);
+
+			// every allocated level, samples are stored separately
+			size_t pixels = 0;
+			GLsizei levels = it->fbo->getNumLevels(target->handle);
+			for(GLsizei level=0; level<levels; ++level)
+				pixels += (size_t)std::max(width >> level, 1) * std::max(height >> level, 1);
+
+			target->memory = RenderGraph::getBytesPerPixel(target->intFormat) * pixels * std::max(target->samples, 1);
+			m_allocatedMemory += target->memory;
+		}
+	}
+}
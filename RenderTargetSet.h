@@ -0,0 +1,122 @@
+// =================================================================
+//   File      : RenderTargetSet.h
+//   Desc	   : A set of FrameBufferObjects described in a small text
+//				 format and built in one pre-warm pass at startup.
+//				 Every attachment is allocated, each fbo is validated
+//				 once and all storage is touched with a clear before
+//				 the first frame, so the driver does not commit memory
+//				 lazily in the middle of rendering.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef RENDERTARGETSET_H
+#define RENDERTARGETSET_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "FrameBufferObject.h"
+
+// Description, one declaration per line, # starts a comment
+//
+//   fbo <name> [read|write|readwrite]
+//   texture <name> <buffer> <format> <size> [samples=N] [levels=N|full]
+//   renderbuffer <name> <buffer> <format> <size> [samples=N]
+//
+// Attachments belong to the fbo declared last. buffer is color0..colorN,
+// depth, stencil or depthstencil. format is a sized internal format with
+// or without the GL_ prefix, e.g. RGBA16F or DEPTH24_STENCIL8. size is
+// WxH in pixels or *S for the window size scaled by S, e.g. *0.5.
+//
+//   fbo scene write
+//   texture color color0 RGBA16F *1
+//   renderbuffer depth depthstencil DEPTH24_STENCIL8 *1
+//   fbo bloom write
+//   texture color color0 R11F_G11F_B10F *0.5 levels=full
+
+class RenderTargetSet
+{
+public:
+
+	 // Constructor/Destructor
+	 RenderTargetSet();
+	~RenderTargetSet();
+
+	// Description
+	// replaces the current description, source names the input in error
+	// messages. returns false and keeps nothing if a line is malformed.
+	bool load(std::istream& in, const std::string& source="description");
+	bool loadFile(const std::string& path);
+
+	// Pre-warm
+	// builds every fbo for the window size, validates each one once and
+	// clears all attachments to zero, then waits for the GPU. returns false
+	// if an attachment could not be created or an fbo is incomplete.
+	bool prewarm(GLsizei windowWidth, GLsizei windowHeight);
+	// rebuilds the fbos with window relative attachments, their fbos and
+	// handles change and have to be looked up again
+	bool resize(GLsizei windowWidth, GLsizei windowHeight);
+	// deletes the fbos, the description is kept
+	void release();
+
+	// Report
+	void printReport(std::ostream& out)const;
+
+	// Accessors
+	FrameBufferObject*	getFramebuffer(const std::string& name)const; // NULL before prewarm()
+	AttachmentHandle	getAttachment(const std::string& framebuffer, const std::string& attachment)const;
+	unsigned			getNumFramebuffers()const;
+	unsigned			getNumAttachments()const;
+	size_t				getAllocatedMemory()const; // bytes of the last prewarm()
+	double				getPrewarmTime()const; // milliseconds of the last prewarm()
+
+private:
+
+	RenderTargetSet(const RenderTargetSet&);
+	RenderTargetSet& operator=(const RenderTargetSet&);
+
+	// declared attachment
+	struct Target {
+		std::string name;
+		bool isRenderBuffer;
+		TEXTURE_BUFFER_TYPE type; // same order as RBUFFER_TYPE
+		GLuint colorSlot;
+		GLenum intFormat;
+		GLsizei width; // pixels, 0 if window relative
+		GLsizei height;
+		float scale; // of the window size
+		GLsizei samples;
+		GLsizei levels;
+		AttachmentHandle handle; // built by prewarm()
+		size_t memory;
+	};
+
+	// declared fbo
+	struct Framebuffer {
+		std::string name;
+		BUFFER_TARGET_MODE mode;
+		std::vector<Target> targets;
+		FrameBufferObject* fbo; // built by prewarm()
+	};
+
+	static bool parseLine(std::istream& line, std::vector<Framebuffer>& framebuffers, std::string& error);
+	static bool parseTarget(std::istream& line, bool isRenderBuffer, Target& target, std::string& error);
+	static bool isWindowRelative(const Framebuffer& framebuffer);
+
+	// allocates the attachments of one fbo, validation is left to the caller
+	bool build(Framebuffer& framebuffer);
+	void destroy(Framebuffer& framebuffer);
+	void getTargetSize(const Target& target, GLsizei& width, GLsizei& height)const;
+	void updateMemory();
+
+	std::vector<Framebuffer>	m_framebuffers;
+	GLsizei						m_windowWidth;
+	GLsizei						m_windowHeight;
+	size_t						m_allocatedMemory;
+	double						m_prewarmTime;
+
+};
+
+#endif
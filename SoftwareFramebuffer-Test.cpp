@@ -0,0 +1,322 @@
+// ===========================================================
+//   File      : SoftwareFramebuffer-Test.cpp
+//   Desc	   : Software framebuffer test code. Needs neither GL
+//				 headers nor a GL driver. Checks that the scalar,
+//				 SSE2 and AVX2 kernels and any number of worker
+//				 threads give bit-identical results, on lengths that
+//				 are not multiples of the vector width, and that
+//				 pixels survive write, copy, downsample and read.
+//   Author    : Berk Atabek - Copyright 2012
+//
+//============================================================
+
+#include <iostream>
+#include <vector>
+#include <string.h>
+#include <math.h>
+
+#include "SoftwareFramebuffer.h"
+#include "SoftwareKernels.h"
+#include "TileWorkerPool.h"
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+	if(!condition)
+	{
+		std::cerr << "Error: " << what << " failed...\n";
+		++g_failures;
+	}
+}
+
+//=========================================
+// Test data
+//=========================================
+static void fillBytes(std::vector<unsigned char>& data, unsigned seed)
+{
+	for(size_t i=0; i<data.size(); ++i)
+		data[i] = (unsigned char)((i*131 + i/7 + seed*29) & 0xff);
+}
+
+// covers [0,1] with the x.5/255 rounding boundaries and values outside it,
+// the kernels only take finite floats
+static void fillFloats(std::vector<float>& data, unsigned seed)
+{
+	for(size_t i=0; i<data.size(); ++i)
+	{
+		unsigned k = (unsigned)((i*37 + seed*11) % 700);
+		data[i] = k<600 ? (float)k/510.0f : (float)k/100.0f - 6.5f;
+	}
+}
+
+//=========================================
+// Kernels
+//=========================================
+// all outputs of every kernel for numPixels pixels, the inputs start offset
+// elements after their buffer so the vector loads are unaligned as well
+static std::vector<unsigned char> runKernels(size_t numPixels, size_t offset)
+{
+	std::vector<unsigned char> bytes0(numPixels*8 + offset + 1), bytes1(numPixels*8 + offset + 1);
+	std::vector<float> floats0(numPixels*8 + offset + 1), floats1(numPixels*8 + offset + 1);
+	fillBytes(bytes0, 1); fillBytes(bytes1, 2);
+	fillFloats(floats0, 3); fillFloats(floats1, 4);
+
+	std::vector<unsigned char> downRGBA8(numPixels*4 + 1);
+	std::vector<float> downRGBA32F(numPixels*4 + 1), downR32F(numPixels + 1), toFloat(numPixels*4 + 1);
+	std::vector<unsigned char> toRGBA8(numPixels*4 + 1);
+
+	SoftwareKernels::downsampleRGBA8(&bytes0[offset], &bytes1[offset], &downRGBA8[0], numPixels);
+	SoftwareKernels::downsampleRGBA32F(&floats0[offset], &floats1[offset], &downRGBA32F[0], numPixels);
+	SoftwareKernels::downsampleR32F(&floats0[offset], &floats1[offset], &downR32F[0], numPixels);
+	SoftwareKernels::convertRGBA8ToFloat(&bytes0[offset], &toFloat[0], numPixels);
+	SoftwareKernels::convertFloatToRGBA8(&floats0[offset], &toRGBA8[0], numPixels);
+
+	std::vector<unsigned char> result;
+	result.insert(result.end(), downRGBA8.begin(), downRGBA8.end());
+	result.insert(result.end(), (unsigned char*)&downRGBA32F[0], (unsigned char*)(&downRGBA32F[0] + downRGBA32F.size()));
+	result.insert(result.end(), (unsigned char*)&downR32F[0], (unsigned char*)(&downR32F[0] + downR32F.size()));
+	result.insert(result.end(), (unsigned char*)&toFloat[0], (unsigned char*)(&toFloat[0] + toFloat.size()));
+	result.insert(result.end(), toRGBA8.begin(), toRGBA8.end());
+	return result;
+}
+
+
+static std::vector<unsigned char> runFill(size_t size)
+{
+	std::vector<unsigned char> memory(size + 128, 0xcd);
+	size_t address = reinterpret_cast<size_t>(&memory[0]);
+	unsigned char* dst = &memory[0] + (64 - address % 64) % 64;
+	unsigned char pattern[16];
+	for(int i=0; i<16; ++i)
+		pattern[i] = (unsigned char)(i*17 + 3);
+
+	SoftwareKernels::fill(dst, size, pattern);
+	return std::vector<unsigned char>(dst, dst + size + 64); // and the bytes after it
+}
+
+
+static void testKernels(SOFTWARE_KERNEL_LEVEL level)
+{
+	// every remainder of the 4 and 8 float, 16 and 32 byte vectors
+	for(size_t numPixels=0; numPixels<=67; ++numPixels)
+	{
+		for(size_t offset=0; offset<2; ++offset)
+		{
+			SoftwareKernels::setLevel(SKL_SCALAR);
+			std::vector<unsigned char> reference = runKernels(numPixels, offset);
+			SoftwareKernels::setLevel(level);
+			if(runKernels(numPixels, offset)!=reference)
+			{
+				std::cerr << "Error: " << SoftwareKernels::getLevelName(level) << " kernels differ from scalar for "
+					<< numPixels << " pixels at offset " << offset << "...\n";
+				++g_failures;
+			}
+		}
+	}
+	for(size_t size=0; size<=64*7; size+=64)
+	{
+		SoftwareKernels::setLevel(SKL_SCALAR);
+		std::vector<unsigned char> reference = runFill(size);
+		SoftwareKernels::setLevel(level);
+		if(runFill(size)!=reference)
+		{
+			std::cerr << "Error: " << SoftwareKernels::getLevelName(level) << " fill differs from scalar for "
+				<< size << " bytes...\n";
+			++g_failures;
+		}
+	}
+}
+
+//=========================================
+// Framebuffer
+//=========================================
+// writes, copies, downsamples, converts, clears and reads back a w x h set
+// of attachments and returns everything read
+static std::vector<unsigned char> runFramebuffer(GLsizei w, GLsizei h)
+{
+	SoftwareFramebuffer fb, half, same;
+	AttachmentHandle color = fb.attach2DTexture("color", TBT_COLOR, w, h, 0);
+	AttachmentHandle color32F = fb.attach2DTexture("color32F", TBT_COLOR, w, h, 0, 1, GL_RGBA32F);
+	AttachmentHandle red32F = fb.attach2DTexture("red32F", TBT_COLOR, w, h, 0, 2, GL_R32F);
+
+	std::vector<unsigned char> bytes(w*h*4);
+	std::vector<float> floats(w*h*4);
+	fillBytes(bytes, 5);
+	fillFloats(floats, 6);
+	check(fb.writePixels(color, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, &bytes[0])==FR_OK, "RGBA8 write");
+	check(fb.writePixels(color32F, 0, 0, w, h, GL_RGBA, GL_FLOAT, &floats[0])==FR_OK, "RGBA32F write");
+	check(fb.writePixels(red32F, 0, 0, w, h, GL_RED, GL_FLOAT, &floats[0])==FR_OK, "R32F write");
+
+	// half size with GL_LINEAR downsamples
+	AttachmentHandle halfColor = half.attach2DTexture("color", TBT_COLOR, w/2, h/2, 0);
+	AttachmentHandle halfColor32F = half.attach2DTexture("color32F", TBT_COLOR, w/2, h/2, 0, 1, GL_RGBA32F);
+	AttachmentHandle halfRed32F = half.attach2DTexture("red32F", TBT_COLOR, w/2, h/2, 0, 2, GL_R32F);
+	check(fb.copy(half, color, halfColor)==FR_OK, "RGBA8 downsample");
+	check(fb.copy(half, color32F, halfColor32F)==FR_OK, "RGBA32F downsample");
+	check(fb.copy(half, red32F, halfRed32F)==FR_OK, "R32F downsample");
+
+	// same size converts between RGBA8 and RGBA32F
+	AttachmentHandle sameColor32F = same.attach2DTexture("color32F", TBT_COLOR, w, h, 0, 0, GL_RGBA32F);
+	AttachmentHandle sameColor = same.attach2DTexture("color", TBT_COLOR, w, h, 0, 1, GL_RGBA8);
+	check(fb.copy(same, color, sameColor32F)==FR_OK, "RGBA8 to RGBA32F copy");
+	check(fb.copy(same, color32F, sameColor)==FR_OK, "RGBA32F to RGBA8 copy");
+
+	GLsizei halfW = w/2, halfH = h/2;
+	std::vector<unsigned char> result;
+	std::vector<unsigned char> data(w*h*16 + 4);
+	half.readPixels(halfColor, 0, 0, halfW, halfH, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
+	result.insert(result.end(), data.begin(), data.begin() + halfW*halfH*4);
+	half.readPixels(halfColor32F, 0, 0, halfW, halfH, GL_RGBA, GL_FLOAT, &data[0]);
+	result.insert(result.end(), data.begin(), data.begin() + halfW*halfH*16);
+	half.readPixels(halfRed32F, 0, 0, halfW, halfH, GL_RED, GL_FLOAT, &data[0]);
+	result.insert(result.end(), data.begin(), data.begin() + halfW*halfH*4);
+	same.readPixels(sameColor32F, 0, 0, w, h, GL_RGBA, GL_FLOAT, &data[0]);
+	result.insert(result.end(), data.begin(), data.begin() + w*h*16);
+	same.readPixels(sameColor, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
+	result.insert(result.end(), data.begin(), data.begin() + w*h*4);
+
+	// a window inside the attachment converts rows of odd length
+	if(w>8 && h>10)
+	{
+		same.readPixels(sameColor, 3, 5, w-7, h-9, GL_RGBA, GL_FLOAT, &data[0]);
+		result.insert(result.end(), data.begin(), data.begin() + (w-7)*(h-9)*16);
+	}
+
+	GLfloat clearColor[4] = {0.2f, 0.4f, 0.6f, 0.8f};
+	same.clear(clearColor);
+	same.readPixels(sameColor, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
+	result.insert(result.end(), data.begin(), data.begin() + w*h*4);
+	return result;
+}
+
+
+static void testRoundTrips(GLsizei w, GLsizei h)
+{
+	SoftwareFramebuffer source, half, converted;
+	AttachmentHandle color = source.createRenderBufferAndAttach("color", RBT_COLOR, GL_RGBA8, w, h);
+	AttachmentHandle halfColor = half.createRenderBufferAndAttach("color", RBT_COLOR, GL_RGBA8, w/2, h/2);
+	AttachmentHandle color32F = converted.createRenderBufferAndAttach("color", RBT_COLOR, GL_RGBA32F, w, h);
+
+	std::vector<unsigned char> bytes(w*h*4);
+	fillBytes(bytes, 7);
+	check(source.writePixels(color, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, &bytes[0])==FR_OK, "round trip write");
+
+	// write then read gives the same bytes
+	std::vector<unsigned char> read(w*h*4);
+	source.readPixels(color, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, &read[0]);
+	check(read==bytes, "RGBA8 write/read round trip");
+
+	// RGBA8 through RGBA32F and back is lossless
+	std::vector<unsigned char> back(w*h*4);
+	check(source.copy(converted, color, color32F)==FR_OK, "round trip conversion");
+	check(converted.copy(source, color32F, color)==FR_OK, "round trip conversion back");
+	source.readPixels(color, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, &back[0]);
+	check(back==bytes, "RGBA8/RGBA32F round trip");
+
+	// each downsampled pixel is the rounded average of its 2x2 block, odd
+	// sizes are not exactly half and sample the nearest pixel instead
+	std::vector<unsigned char> down((w/2)*(h/2)*4);
+	check(source.copy(half, color, halfColor)==FR_OK, "round trip downsample");
+	if(w%2 || h%2)
+		return;
+	half.readPixels(halfColor, 0, 0, w/2, h/2, GL_RGBA, GL_UNSIGNED_BYTE, &down[0]);
+	int mismatches = 0;
+	for(GLsizei y=0; y<h/2; ++y)
+		for(GLsizei x=0; x<w/2; ++x)
+			for(int k=0; k<4; ++k)
+			{
+				int sum = bytes[((2*y)*w + 2*x)*4 + k] + bytes[((2*y)*w + 2*x+1)*4 + k]
+					+ bytes[((2*y+1)*w + 2*x)*4 + k] + bytes[((2*y+1)*w + 2*x+1)*4 + k];
+				if(down[(y*(w/2) + x)*4 + k]!=(sum + 2)/4)
+					++mismatches;
+			}
+	check(mismatches==0, "RGBA8 downsample average");
+}
+
+
+static void testDepthStencil()
+{
+	SoftwareFramebuffer fb;
+	AttachmentHandle color = fb.createRenderBufferAndAttach("color", RBT_COLOR, GL_NONE, 100, 70);
+	AttachmentHandle depth = fb.createRenderBufferAndAttach("depth", RBT_DEPTH_AND_STENCIL, GL_NONE, 100, 70);
+	check(fb.getAttachmentFormat(depth)==GL_DEPTH24_STENCIL8, "default depth/stencil format");
+
+	GLfloat clearColor[4] = {1.0f, 0.5f, 0.0f, 1.0f};
+	fb.clear(clearColor, 0.25f, 7);
+	unsigned char pixel[4];
+	fb.readPixels(color, 99, 69, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+	check(pixel[0]==255 && pixel[1]==128 && pixel[2]==0 && pixel[3]==255, "color clear");
+
+	float depthValue;
+	unsigned char stencil = 9;
+	check(fb.writePixels(depth, 1, 1, 1, 1, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, &stencil)==FR_OK, "stencil write");
+	fb.readPixels(depth, 1, 1, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depthValue);
+	check(fabs(depthValue - 0.25f)<1e-6, "depth kept by a stencil write");
+	fb.readPixels(depth, 1, 1, 1, 1, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, &stencil);
+	check(stencil==9, "stencil write/read round trip");
+
+	SoftwareFramebuffer target;
+	AttachmentHandle targetDepth = target.createRenderBufferAndAttach("depth", RBT_DEPTH_AND_STENCIL, GL_NONE, 100, 70);
+	check(fb.copy(target, depth, targetDepth, GL_NEAREST)==FR_OK, "depth/stencil copy");
+	target.readPixels(targetDepth, 1, 1, 1, 1, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, &stencil);
+	check(stencil==9, "stencil copy");
+}
+
+//=========================================
+// main
+//=========================================
+int main()
+{
+	SOFTWARE_KERNEL_LEVEL supported = SoftwareKernels::getSupportedLevel();
+	std::cout << "kernels up to " << SoftwareKernels::getLevelName(supported) << ", "
+		<< TileWorkerPool::getInstance().getNumThreads() << " worker threads\n";
+
+	for(int level=SKL_SSE2; level<=SKL_AVX2; ++level)
+	{
+		if(level>supported)
+		{
+			std::cout << SoftwareKernels::getLevelName((SOFTWARE_KERNEL_LEVEL)level) << " not supported, skipped\n";
+			continue;
+		}
+		testKernels((SOFTWARE_KERNEL_LEVEL)level);
+	}
+
+	// odd sizes leave partial tiles and rows that are no multiple of a vector
+	static const GLsizei sizes[][2] = {{256, 256}, {130, 66}, {67, 129}, {2, 2}, {200, 2}, {3, 97}};
+	unsigned numThreads = TileWorkerPool::getInstance().getNumThreads();
+	for(size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); ++i)
+	{
+		GLsizei w = sizes[i][0], h = sizes[i][1];
+		SoftwareKernels::setLevel(SKL_SCALAR);
+		TileWorkerPool::getInstance().setNumThreads(1);
+		std::vector<unsigned char> reference = runFramebuffer(w, h);
+
+		for(int level=SKL_SCALAR; level<=supported; ++level)
+		{
+			for(unsigned threads=1; threads<=4; threads*=2)
+			{
+				SoftwareKernels::setLevel((SOFTWARE_KERNEL_LEVEL)level);
+				TileWorkerPool::getInstance().setNumThreads(threads);
+				if(runFramebuffer(w, h)!=reference)
+				{
+					std::cerr << "Error: " << w << "x" << h << " framebuffer differs from scalar with "
+						<< SoftwareKernels::getLevelName((SOFTWARE_KERNEL_LEVEL)level) << " on " << threads << " threads...\n";
+					++g_failures;
+				}
+			}
+			testRoundTrips(w, h);
+		}
+	}
+	TileWorkerPool::getInstance().setNumThreads(numThreads);
+	SoftwareKernels::setLevel(supported);
+	testDepthStencil();
+
+	if(g_failures)
+	{
+		std::cerr << "Error: " << g_failures << " software framebuffer checks failed...\n";
+		return 1;
+	}
+	std::cout << "all software framebuffer checks passed\n";
+	return 0;
+}
@@ -0,0 +1,688 @@
+// =================================================================
+//   File      : SoftwareFramebuffer.cpp
+//   Desc	   : Framebuffer kept entirely in CPU memory, for CI and
+//				 headless machines without a GL driver. Follows the
+//				 attachment, clear and copy interface of
+//				 FrameBufferObject. Attachments are stored in square
+//				 tiles aligned to cache lines, operations are split
+//				 across the TileWorkerPool by tile and the pixels are
+//				 processed with the SIMD kernels of SoftwareKernels.
+//				 Makes no GL calls and needs no GL headers.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "SoftwareFramebuffer.h"
+#include "SoftwareKernels.h"
+#include "TileWorkerPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static const GLsizei TILE = SOFTWARE_TILE_SIZE;
+static const size_t TILE_ALIGNMENT = 64;
+
+// Tiled addressing
+
+static unsigned char* getTileData(const SoftwareImage& image, GLsizei tileX, GLsizei tileY)
+{
+	// found again on every access, the memory may move with the image table
+	size_t address = reinterpret_cast<size_t>(&image.memory[0]);
+	unsigned char* base = const_cast<unsigned char*>(&image.memory[0]) + (TILE_ALIGNMENT - address % TILE_ALIGNMENT) % TILE_ALIGNMENT;
+	return base + ((size_t)tileY*image.tilesX + tileX)*TILE*TILE*image.pixelSize;
+}
+
+
+static unsigned char* getPixel(const SoftwareImage& image, GLint x, GLint y)
+{
+	return getTileData(image, x/TILE, y/TILE) + ((size_t)(y%TILE)*TILE + x%TILE)*image.pixelSize;
+}
+
+
+static size_t getTileBytes(const SoftwareImage& image)
+{
+	return (size_t)TILE*TILE*image.pixelSize;
+}
+
+// Pixel encoding
+// Pixels are decoded to four floats, red to alpha for the color formats
+// and depth, stencil for the depth and stencil formats.
+
+static GLfloat clamp01(GLfloat value)
+{
+	return std::min(std::max(value, 0.0f), 1.0f);
+}
+
+
+static GLbitfield getFormatMask(GLenum intFormat)
+{
+	switch(intFormat)
+	{
+		case GL_DEPTH_COMPONENT32F:	return GL_DEPTH_BUFFER_BIT;
+		case GL_STENCIL_INDEX8:		return GL_STENCIL_BUFFER_BIT;
+		case GL_DEPTH24_STENCIL8:	return GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT;
+		default:					return GL_COLOR_BUFFER_BIT;
+	}
+}
+
+
+static void encodePixel(GLenum intFormat, const GLfloat* value, unsigned char* pixel)
+{
+	switch(intFormat)
+	{
+		case GL_R8:
+			pixel[0] = (unsigned char)(int)(clamp01(value[0])*255.0f + 0.5f);
+			break;
+		case GL_RGBA8:
+			for(int i=0; i<4; ++i)
+				pixel[i] = (unsigned char)(int)(clamp01(value[i])*255.0f + 0.5f);
+			break;
+		case GL_R32F:
+			memcpy(pixel, value, sizeof(GLfloat));
+			break;
+		case GL_RGBA32F:
+			memcpy(pixel, value, 4*sizeof(GLfloat));
+			break;
+		case GL_DEPTH_COMPONENT32F:
+		{
+			GLfloat depth = clamp01(value[0]);
+			memcpy(pixel, &depth, sizeof(GLfloat));
+			break;
+		}
+		case GL_STENCIL_INDEX8:
+			pixel[0] = (unsigned char)((GLint)value[1] & 0xff);
+			break;
+		case GL_DEPTH24_STENCIL8:
+		{
+			GLuint packed = ((GLuint)(clamp01(value[0])*16777215.0 + 0.5) << 8) | ((GLint)value[1] & 0xff);
+			memcpy(pixel, &packed, sizeof(GLuint));
+			break;
+		}
+	}
+}
+
+
+static void decodePixel(GLenum intFormat, const unsigned char* pixel, GLfloat* value)
+{
+	value[0] = 0.0f; value[1] = 0.0f; value[2] = 0.0f; value[3] = 1.0f;
+	switch(intFormat)
+	{
+		case GL_R8:
+			value[0] = pixel[0] / 255.0f;
+			break;
+		case GL_RGBA8:
+			for(int i=0; i<4; ++i)
+				value[i] = pixel[i] / 255.0f;
+			break;
+		case GL_R32F:
+		case GL_DEPTH_COMPONENT32F:
+			memcpy(value, pixel, sizeof(GLfloat));
+			break;
+		case GL_RGBA32F:
+			memcpy(value, pixel, 4*sizeof(GLfloat));
+			break;
+		case GL_STENCIL_INDEX8:
+			value[1] = pixel[0];
+			break;
+		case GL_DEPTH24_STENCIL8:
+		{
+			GLuint packed;
+			memcpy(&packed, pixel, sizeof(GLuint));
+			value[0] = (GLfloat)((packed >> 8) / 16777215.0);
+			value[1] = (GLfloat)(packed & 0xff);
+			break;
+		}
+	}
+}
+
+
+// internal format laid out like the client pixels, GL_NONE if the pair is not supported
+static GLenum getClientFormat(GLenum format, GLenum type)
+{
+	if(type==GL_UNSIGNED_BYTE)
+	{
+		if(format==GL_RED) return GL_R8;
+		if(format==GL_RGBA) return GL_RGBA8;
+		if(format==GL_STENCIL_INDEX) return GL_STENCIL_INDEX8;
+	}
+	else if(type==GL_FLOAT)
+	{
+		if(format==GL_RED) return GL_R32F;
+		if(format==GL_RGBA) return GL_RGBA32F;
+		if(format==GL_DEPTH_COMPONENT) return GL_DEPTH_COMPONENT32F;
+	}
+	else if(type==GL_UNSIGNED_INT_24_8 && format==GL_DEPTH_STENCIL)
+		return GL_DEPTH24_STENCIL8;
+	return GL_NONE;
+}
+
+
+// converts a run of pixels, the kernels take the common RGBA8 <-> float cases
+static void convertSpan(GLenum srcFormat, const unsigned char* src, GLenum dstFormat, unsigned char* dst, size_t numPixels)
+{
+	if(srcFormat==dstFormat)
+		memcpy(dst, src, numPixels*SoftwareFramebuffer::getPixelSize(srcFormat));
+	else if(srcFormat==GL_RGBA8 && dstFormat==GL_RGBA32F)
+		SoftwareKernels::convertRGBA8ToFloat(src, reinterpret_cast<float*>(dst), numPixels);
+	else if(srcFormat==GL_RGBA32F && dstFormat==GL_RGBA8)
+		SoftwareKernels::convertFloatToRGBA8(reinterpret_cast<const float*>(src), dst, numPixels);
+	else
+	{
+		unsigned srcSize = SoftwareFramebuffer::getPixelSize(srcFormat);
+		unsigned dstSize = SoftwareFramebuffer::getPixelSize(dstFormat);
+		GLfloat value[4];
+		for(size_t i=0; i<numPixels; ++i)
+		{
+			decodePixel(srcFormat, src + i*srcSize, value);
+			encodePixel(dstFormat, value, dst + i*dstSize);
+		}
+	}
+}
+
+// Jobs
+// run by the TileWorkerPool, one task per tile or per band of tile rows
+
+struct FillJob {
+	const SoftwareImage* image;
+	unsigned char pattern[16];
+};
+
+static void fillTile(unsigned task, void* userData)
+{
+	const FillJob& job = *static_cast<const FillJob*>(userData);
+	const SoftwareImage& image = *job.image;
+	SoftwareKernels::fill(getTileData(image, task % image.tilesX, task / image.tilesX), getTileBytes(image), job.pattern);
+}
+
+
+struct CopyJob {
+	const SoftwareImage* source;
+	const SoftwareImage* destination;
+};
+
+// same size, the tiles line up
+static void copyTile(unsigned task, void* userData)
+{
+	const CopyJob& job = *static_cast<const CopyJob*>(userData);
+	const SoftwareImage& dst = *job.destination;
+	GLsizei tileX = task % dst.tilesX;
+	GLsizei tileY = task / dst.tilesX;
+	convertSpan(job.source->intFormat, getTileData(*job.source, tileX, tileY), dst.intFormat, getTileData(dst, tileX, tileY), (size_t)TILE*TILE);
+}
+
+
+// destination half the size of the source. a destination tile row
+// reads the left and right halves of two source tiles.
+static void downsampleTile(unsigned task, void* userData)
+{
+	const CopyJob& job = *static_cast<const CopyJob*>(userData);
+	const SoftwareImage& src = *job.source;
+	const SoftwareImage& dst = *job.destination;
+	GLsizei tileX = task % dst.tilesX;
+	GLsizei tileY = task / dst.tilesX;
+	GLint rowEnd = std::min((tileY+1)*TILE, dst.height);
+
+	for(GLint y=tileY*TILE; y<rowEnd; ++y)
+	{
+		for(GLint half=0; half<2; ++half)
+		{
+			GLint x = tileX*TILE + half*TILE/2;
+			if(x>=dst.width) break;
+			size_t count = std::min(TILE/2, dst.width - x);
+			const unsigned char* row0 = getPixel(src, 2*x, 2*y);
+			const unsigned char* row1 = getPixel(src, 2*x, 2*y+1);
+			unsigned char* out = getPixel(dst, x, y);
+
+			if(src.intFormat==dst.intFormat && src.intFormat==GL_RGBA8)
+				SoftwareKernels::downsampleRGBA8(row0, row1, out, count);
+			else if(src.intFormat==dst.intFormat && src.intFormat==GL_RGBA32F)
+				SoftwareKernels::downsampleRGBA32F(reinterpret_cast<const float*>(row0), reinterpret_cast<const float*>(row1), reinterpret_cast<float*>(out), count);
+			else if(src.intFormat==dst.intFormat && src.intFormat==GL_R32F)
+				SoftwareKernels::downsampleR32F(reinterpret_cast<const float*>(row0), reinterpret_cast<const float*>(row1), reinterpret_cast<float*>(out), count);
+			else
+			{
+				GLfloat value[4], sum[4];
+				for(size_t i=0; i<count; ++i)
+				{
+					std::fill(sum, sum+4, 0.0f);
+					for(unsigned n=0; n<4; ++n)
+					{
+						const unsigned char* row = (n<2) ? row0 : row1;
+						decodePixel(src.intFormat, row + (2*i + n%2)*src.pixelSize, value);
+						for(int c=0; c<4; ++c) sum[c] += value[c];
+					}
+					for(int c=0; c<4; ++c) sum[c] *= 0.25f;
+					encodePixel(dst.intFormat, sum, out + i*dst.pixelSize);
+				}
+			}
+		}
+	}
+}
+
+
+// any other size, the pixel centers are mapped as glBlitFramebuffer does
+static void sampleNearestTile(unsigned task, void* userData)
+{
+	const CopyJob& job = *static_cast<const CopyJob*>(userData);
+	const SoftwareImage& src = *job.source;
+	const SoftwareImage& dst = *job.destination;
+	GLsizei tileX = task % dst.tilesX;
+	GLsizei tileY = task / dst.tilesX;
+	GLint rowEnd = std::min((tileY+1)*TILE, dst.height);
+	GLint columnEnd = std::min((tileX+1)*TILE, dst.width);
+
+	for(GLint y=tileY*TILE; y<rowEnd; ++y)
+	{
+		GLint srcY = (GLint)(((long long)(2*y+1)*src.height) / (2*dst.height));
+		for(GLint x=tileX*TILE; x<columnEnd; ++x)
+		{
+			GLint srcX = (GLint)(((long long)(2*x+1)*src.width) / (2*dst.width));
+			convertSpan(src.intFormat, getPixel(src, srcX, srcY), dst.intFormat, getPixel(dst, x, y), 1);
+		}
+	}
+}
+
+
+struct TransferJob {
+	const SoftwareImage* image;
+	GLint x, y;
+	GLsizei width, height;
+	GLenum clientFormat; // internal format matching the client pixels
+	unsigned clientPixelSize;
+	unsigned char* data;
+	bool write;
+};
+
+// the rows of the region inside one tile row, split at the tile columns
+static void transferTileRow(unsigned task, void* userData)
+{
+	const TransferJob& job = *static_cast<const TransferJob*>(userData);
+	const SoftwareImage& image = *job.image;
+	GLint rowBegin = std::max(job.y, (GLint)((job.y/TILE + (GLint)task)*TILE));
+	GLint rowEnd = std::min(job.y + job.height, (job.y/TILE + (GLint)task + 1)*TILE);
+
+	for(GLint y=rowBegin; y<rowEnd; ++y)
+	{
+		unsigned char* row = job.data + (size_t)(y - job.y)*job.width*job.clientPixelSize;
+		for(GLint x=job.x; x<job.x + job.width; )
+		{
+			GLint spanEnd = std::min(job.x + job.width, (x/TILE + 1)*TILE);
+			unsigned char* client = row + (size_t)(x - job.x)*job.clientPixelSize;
+			if(job.write)
+				convertSpan(job.clientFormat, client, image.intFormat, getPixel(image, x, y), spanEnd - x);
+			else
+				convertSpan(image.intFormat, getPixel(image, x, y), job.clientFormat, client, spanEnd - x);
+			x = spanEnd;
+		}
+	}
+}
+
+
+SoftwareFramebuffer::SoftwareFramebuffer()
+{
+}
+
+
+SoftwareFramebuffer::~SoftwareFramebuffer()
+{
+}
+
+// Attachments
+
+AttachmentHandle SoftwareFramebuffer::createRenderBufferAndAttach(const std::string& name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei width, GLsizei height, GLuint colorSlot)
+{
+	if(internalFormat==GL_NONE) internalFormat = getDefaultFormat(type);
+	return attach(name, getAttachmentPoint(type, colorSlot), internalFormat, width, height);
+}
+
+
+AttachmentHandle SoftwareFramebuffer::attach2DTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLsizei height, GLint level, GLuint colorSlot, GLenum internalFormat)
+{
+	if(level!=0)
+	{
+		std::cerr << "Error: software texture " << name << " has no mip levels...\n";
+		return AttachmentHandle();
+	}
+	if(internalFormat==GL_NONE) internalFormat = getDefaultFormat(tbtype);
+	return attach(name, getAttachmentPoint(tbtype, colorSlot), internalFormat, width, height);
+}
+
+
+FBO_RESULT SoftwareFramebuffer::deleteAttachment(AttachmentHandle handle)
+{
+	SoftwareImage* image = getImage(handle);
+	if(!image) return FR_INVALID_HANDLE;
+
+	std::vector<unsigned char>().swap(image->memory);
+	image->name.clear();
+	image->used = false;
+	m_freeImages.push_back(handle.index);
+	return FR_OK;
+}
+
+
+FBO_RESULT SoftwareFramebuffer::findAttachment(const std::string& name, AttachmentHandle& handle)const
+{
+	for(std::vector<SoftwareImage>::const_iterator it = m_images.begin(); it != m_images.end(); ++it)
+	{
+		if(it->used && it->name==name)
+		{
+			handle.index = (unsigned short)(it - m_images.begin());
+			handle.generation = it->generation;
+			return FR_OK;
+		}
+	}
+	return FR_NOT_FOUND;
+}
+
+// Clears
+
+FBO_RESULT SoftwareFramebuffer::clearColor(AttachmentHandle handle, GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+	SoftwareImage* image = getImage(handle);
+	if(!image) return FR_INVALID_HANDLE;
+	if(getFormatMask(image->intFormat)!=GL_COLOR_BUFFER_BIT) return FR_UNSUPPORTED;
+
+	const GLfloat value[4] = {r, g, b, a};
+	clearImage(*image, value);
+	return FR_OK;
+}
+
+
+FBO_RESULT SoftwareFramebuffer::clearDepthStencil(AttachmentHandle handle, GLfloat depth, GLint stencil)
+{
+	SoftwareImage* image = getImage(handle);
+	if(!image) return FR_INVALID_HANDLE;
+	if(getFormatMask(image->intFormat)==GL_COLOR_BUFFER_BIT) return FR_UNSUPPORTED;
+
+	const GLfloat value[4] = {depth, (GLfloat)stencil, 0.0f, 1.0f};
+	clearImage(*image, value);
+	return FR_OK;
+}
+
+
+FBO_RESULT SoftwareFramebuffer::clear(const GLfloat* color, GLfloat depth, GLint stencil)
+{
+	const GLfloat depthStencil[4] = {depth, (GLfloat)stencil, 0.0f, 1.0f};
+	for(std::vector<SoftwareImage>::iterator it = m_images.begin(); it != m_images.end(); ++it)
+	{
+		if(!it->used) continue;
+		if(getFormatMask(it->intFormat)!=GL_COLOR_BUFFER_BIT)
+			clearImage(*it, depthStencil);
+		else if(color)
+			clearImage(*it, color);
+	}
+	return FR_OK;
+}
+
+// Copies
+
+FBO_RESULT SoftwareFramebuffer::copy(SoftwareFramebuffer& target, AttachmentHandle source, AttachmentHandle destination, GLenum filter)
+{
+	const SoftwareImage* src = getImage(source);
+	SoftwareImage* dst = target.getImage(destination);
+	if(!src || !dst) return FR_INVALID_HANDLE;
+	if(src==dst) return FR_UNSUPPORTED;
+
+	GLbitfield mask = getFormatMask(src->intFormat);
+	if(mask!=GL_COLOR_BUFFER_BIT)
+	{
+		// depth and stencil are copied as they are, as by glBlitFramebuffer
+		if(src->intFormat!=dst->intFormat || filter!=GL_NEAREST) return FR_UNSUPPORTED;
+	}
+	else if(getFormatMask(dst->intFormat)!=GL_COLOR_BUFFER_BIT)
+		return FR_UNSUPPORTED;
+
+	CopyJob job;
+	job.source = src;
+	job.destination = dst;
+	unsigned numTiles = dst->tilesX*dst->tilesY;
+
+	if(src->width==dst->width && src->height==dst->height)
+		TileWorkerPool::getInstance().run(numTiles, copyTile, &job);
+	else if(filter==GL_LINEAR && mask==GL_COLOR_BUFFER_BIT && src->width==2*dst->width && src->height==2*dst->height)
+		TileWorkerPool::getInstance().run(numTiles, downsampleTile, &job);
+	else
+		TileWorkerPool::getInstance().run(numTiles, sampleNearestTile, &job);
+	return FR_OK;
+}
+
+// Pixel transfer
+
+FBO_RESULT SoftwareFramebuffer::readPixels(AttachmentHandle handle, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* data)const
+{
+	const SoftwareImage* image = getImage(handle);
+	if(!image) return FR_INVALID_HANDLE;
+
+	GLenum clientFormat = getClientFormat(format, type);
+	if(clientFormat==GL_NONE || (getFormatMask(clientFormat) & ~getFormatMask(image->intFormat))) return FR_UNSUPPORTED;
+	if(x<0 || y<0 || width<=0 || height<=0 || x + width>image->width || y + height>image->height) return FR_UNSUPPORTED;
+
+	TransferJob job;
+	job.image = image;
+	job.x = x; job.y = y;
+	job.width = width; job.height = height;
+	job.clientFormat = clientFormat;
+	job.clientPixelSize = getPixelSize(clientFormat);
+	job.data = static_cast<unsigned char*>(data);
+	job.write = false;
+	TileWorkerPool::getInstance().run((y + height - 1)/TILE - y/TILE + 1, transferTileRow, &job);
+	return FR_OK;
+}
+
+
+FBO_RESULT SoftwareFramebuffer::writePixels(AttachmentHandle handle, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* data)
+{
+	SoftwareImage* image = getImage(handle);
+	if(!image) return FR_INVALID_HANDLE;
+
+	GLenum clientFormat = getClientFormat(format, type);
+	if(clientFormat==GL_NONE || (getFormatMask(clientFormat) & ~getFormatMask(image->intFormat))) return FR_UNSUPPORTED;
+	if(x<0 || y<0 || width<=0 || height<=0 || x + width>image->width || y + height>image->height) return FR_UNSUPPORTED;
+
+	// a stencil write keeps the depth of a packed pixel, and the other way round
+	if(clientFormat!=image->intFormat && image->intFormat==GL_DEPTH24_STENCIL8)
+	{
+		GLfloat value[4];
+		const unsigned char* client = static_cast<const unsigned char*>(data);
+		unsigned clientSize = getPixelSize(clientFormat);
+		for(GLint j=0; j<height; ++j)
+		{
+			for(GLint i=0; i<width; ++i, client += clientSize)
+			{
+				unsigned char* pixel = getPixel(*image, x+i, y+j);
+				decodePixel(image->intFormat, pixel, value);
+				if(clientFormat==GL_DEPTH_COMPONENT32F)
+					memcpy(&value[0], client, sizeof(GLfloat));
+				else
+					value[1] = client[0];
+				encodePixel(image->intFormat, value, pixel);
+			}
+		}
+		return FR_OK;
+	}
+
+	TransferJob job;
+	job.image = image;
+	job.x = x; job.y = y;
+	job.width = width; job.height = height;
+	job.clientFormat = clientFormat;
+	job.clientPixelSize = getPixelSize(clientFormat);
+	job.data = const_cast<unsigned char*>(static_cast<const unsigned char*>(data));
+	job.write = true;
+	TileWorkerPool::getInstance().run((y + height - 1)/TILE - y/TILE + 1, transferTileRow, &job);
+	return FR_OK;
+}
+
+// Tiles
+
+unsigned char* SoftwareFramebuffer::getTile(AttachmentHandle handle, GLsizei tileX, GLsizei tileY)
+{
+	SoftwareImage* image = getImage(handle);
+	if(!image || tileX<0 || tileY<0 || tileX>=image->tilesX || tileY>=image->tilesY) return NULL;
+	return getTileData(*image, tileX, tileY);
+}
+
+// Accessors
+
+FBO_RESULT SoftwareFramebuffer::getAttachmentSize(AttachmentHandle handle, GLsizei& width, GLsizei& height)const
+{
+	const SoftwareImage* image = getImage(handle);
+	if(!image) return FR_INVALID_HANDLE;
+	width = image->width;
+	height = image->height;
+	return FR_OK;
+}
+
+
+GLenum SoftwareFramebuffer::getAttachmentFormat(AttachmentHandle handle)const
+{
+	const SoftwareImage* image = getImage(handle);
+	return image ? image->intFormat : GL_NONE;
+}
+
+
+unsigned SoftwareFramebuffer::getNumAttachments()const
+{
+	return m_images.size() - m_freeImages.size();
+}
+
+
+unsigned SoftwareFramebuffer::getPixelSize(GLenum internalFormat)
+{
+	switch(internalFormat)
+	{
+		case GL_R8:					return 1;
+		case GL_RGBA8:				return 4;
+		case GL_R32F:				return 4;
+		case GL_RGBA32F:			return 16;
+		case GL_DEPTH_COMPONENT32F:	return 4;
+		case GL_STENCIL_INDEX8:		return 1;
+		case GL_DEPTH24_STENCIL8:	return 4;
+		default:					return 0;
+	}
+}
+
+// Private
+
+AttachmentHandle SoftwareFramebuffer::attach(const std::string& name, GLenum attachmentPoint, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	unsigned pixelSize = getPixelSize(internalFormat);
+	if(pixelSize==0)
+	{
+		std::cerr << "Error: format of software attachment " << name << " is not supported...\n";
+		return AttachmentHandle();
+	}
+	if(width<=0 || height<=0)
+	{
+		std::cerr << "Error: software attachment " << name << " has no pixels...\n";
+		return AttachmentHandle();
+	}
+
+	GLbitfield mask = getFormatMask(internalFormat);
+	bool colorPoint = attachmentPoint!=GL_DEPTH_ATTACHMENT && attachmentPoint!=GL_STENCIL_ATTACHMENT && attachmentPoint!=GL_DEPTH_STENCIL_ATTACHMENT;
+	if(colorPoint != (mask==GL_COLOR_BUFFER_BIT))
+	{
+		std::cerr << "Error: format of software attachment " << name << " does not match its attachment point...\n";
+		return AttachmentHandle();
+	}
+
+	// replaces the attachment at the same point
+	for(std::vector<SoftwareImage>::iterator it = m_images.begin(); it != m_images.end(); ++it)
+	{
+		if(it->used && it->attachmentPoint==attachmentPoint)
+		{
+			AttachmentHandle old;
+			old.index = (unsigned short)(it - m_images.begin());
+			old.generation = it->generation;
+			deleteAttachment(old);
+			break;
+		}
+	}
+
+	AttachmentHandle handle;
+	if(!m_freeImages.empty())
+	{
+		handle.index = m_freeImages.back();
+		m_freeImages.pop_back();
+	}
+	else
+	{
+		handle.index = (unsigned short)m_images.size();
+		m_images.push_back(SoftwareImage());
+		m_images.back().generation = 0;
+		m_images.back().used = false;
+	}
+
+	SoftwareImage& image = m_images[handle.index];
+	image.name = name;
+	image.attachmentPoint = attachmentPoint;
+	image.intFormat = internalFormat;
+	image.width = width;
+	image.height = height;
+	image.pixelSize = pixelSize;
+	image.tilesX = (width + TILE - 1)/TILE;
+	image.tilesY = (height + TILE - 1)/TILE;
+	image.memory.assign((size_t)image.tilesX*image.tilesY*TILE*TILE*pixelSize + TILE_ALIGNMENT, 0);
+
+	// generation 0 is reserved for invalid handles
+	image.generation = (unsigned short)(image.generation + 1);
+	if(image.generation==0) image.generation = 1;
+	image.used = true;
+	handle.generation = image.generation;
+	return handle;
+}
+
+
+SoftwareImage* SoftwareFramebuffer::getImage(AttachmentHandle handle)
+{
+	if(!handle.isValid() || handle.index>=m_images.size() || !m_images[handle.index].used || m_images[handle.index].generation!=handle.generation) return NULL;
+	return &m_images[handle.index];
+}
+
+
+const SoftwareImage* SoftwareFramebuffer::getImage(AttachmentHandle handle)const
+{
+	if(!handle.isValid() || handle.index>=m_images.size() || !m_images[handle.index].used || m_images[handle.index].generation!=handle.generation) return NULL;
+	return &m_images[handle.index];
+}
+
+
+void SoftwareFramebuffer::clearImage(SoftwareImage& image, const GLfloat* value)
+{
+	// the pattern holds 16/pixelSize pixels, the padding is cleared along
+	FillJob job;
+	job.image = &image;
+	for(unsigned i=0; i<sizeof(job.pattern); i += image.pixelSize)
+		encodePixel(image.intFormat, value, job.pattern + i);
+	TileWorkerPool::getInstance().run(image.tilesX*image.tilesY, fillTile, &job);
+}
+
+
+GLenum SoftwareFramebuffer::getAttachmentPoint(unsigned type, GLuint colorSlot)
+{
+	GLenum attachmentType;
+	switch(type)
+	{
+		case RBT_COLOR: attachmentType=GL_COLOR_ATTACHMENT0 + colorSlot;break;
+		case RBT_DEPTH: attachmentType=GL_DEPTH_ATTACHMENT;break;
+		case RBT_STENCIL: attachmentType=GL_STENCIL_ATTACHMENT;break;
+		case RBT_DEPTH_AND_STENCIL: attachmentType=GL_DEPTH_STENCIL_ATTACHMENT;break;
+		default: attachmentType=GL_COLOR_ATTACHMENT0 + colorSlot;break;
+	}
+	return attachmentType;
+}
+
+
+GLenum SoftwareFramebuffer::getDefaultFormat(unsigned type)
+{
+	switch(type)
+	{
+		case RBT_DEPTH:				return GL_DEPTH_COMPONENT32F;
+		case RBT_STENCIL:			return GL_STENCIL_INDEX8;
+		case RBT_DEPTH_AND_STENCIL:	return GL_DEPTH24_STENCIL8;
+		default:					return GL_RGBA8;
+	}
+}
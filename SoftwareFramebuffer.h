@@ -0,0 +1,160 @@
+// =================================================================
+//   File      : SoftwareFramebuffer.h
+//   Desc	   : Framebuffer kept entirely in CPU memory, for CI and
+//				 headless machines without a GL driver. Follows the
+//				 attachment, clear and copy interface of
+//				 FrameBufferObject. Attachments are stored in square
+//				 tiles aligned to cache lines, operations are split
+//				 across the TileWorkerPool by tile and the pixels are
+//				 processed with the SIMD kernels of SoftwareKernels.
+//				 Makes no GL calls and needs no GL headers, the GL
+//				 types and enums it takes are declared here when no
+//				 GL header was included before.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef SOFTWAREFRAMEBUFFER_H
+#define SOFTWAREFRAMEBUFFER_H
+
+#include <string>
+#include <vector>
+#include "FBOTypes.h"
+
+// the subset of GL the interface uses, spelled as in gl.h and glext.h so
+// a GL header included afterwards redefines them without a clash
+#if !defined(__gl_h_) && !defined(__GL_H__) && !defined(__glew_h__)
+typedef unsigned int	GLenum;
+typedef unsigned int	GLbitfield;
+typedef int		GLint;
+typedef unsigned int	GLuint;
+typedef int		GLsizei;
+typedef float		GLfloat;
+
+#define GL_NONE					0
+#define GL_COLOR_BUFFER_BIT			0x00004000
+#define GL_DEPTH_BUFFER_BIT			0x00000100
+#define GL_STENCIL_BUFFER_BIT			0x00000400
+#define GL_NEAREST				0x2600
+#define GL_LINEAR				0x2601
+#define GL_RED					0x1903
+#define GL_RGBA					0x1908
+#define GL_DEPTH_COMPONENT			0x1902
+#define GL_STENCIL_INDEX			0x1901
+#define GL_UNSIGNED_BYTE			0x1401
+#define GL_FLOAT				0x1406
+#define GL_RGBA8				0x8058
+#endif
+// a GL 1.1 header leaves out the GL 3.0 tokens
+#ifndef GL_DEPTH_STENCIL_ATTACHMENT
+#define GL_DEPTH_STENCIL                  0x84F9
+#define GL_UNSIGNED_INT_24_8              0x84FA
+#define GL_R8                             0x8229
+#define GL_R32F                           0x822E
+#define GL_RGBA32F                        0x8814
+#define GL_DEPTH_COMPONENT32F             0x8CAC
+#define GL_STENCIL_INDEX8                 0x8D48
+#define GL_DEPTH24_STENCIL8               0x88F0
+#define GL_COLOR_ATTACHMENT0              0x8CE0
+#define GL_DEPTH_ATTACHMENT               0x8D00
+#define GL_STENCIL_ATTACHMENT             0x8D20
+#define GL_DEPTH_STENCIL_ATTACHMENT       0x821A
+#endif
+
+// pixels per tile side, a tile of any format is a multiple of 64 bytes
+static const GLsizei SOFTWARE_TILE_SIZE = 64;
+
+// attachment in tiled memory, tiles are stored row by row from the
+// bottom left one and padded to full size at the right and top edges
+struct SoftwareImage {
+	std::string name;
+	GLenum attachmentPoint;
+	GLenum intFormat;
+	GLsizei width;
+	GLsizei height;
+	unsigned pixelSize;
+	GLsizei tilesX;
+	GLsizei tilesY;
+	std::vector<unsigned char> memory; // tiles start at the first cache line boundary
+	unsigned short generation; // bumped whenever the entry is reused
+	bool used;
+};
+
+
+class SoftwareFramebuffer
+{
+public:
+
+	 // Constructor/Destructor
+	 SoftwareFramebuffer();
+	~SoftwareFramebuffer();
+
+	// Attachments
+	// Renderbuffers and textures are stored alike, both forms are kept so
+	// code written against FrameBufferObject carries over. Supported
+	// formats are R8, RGBA8, R32F, RGBA32F, DEPTH_COMPONENT32F,
+	// STENCIL_INDEX8 and DEPTH24_STENCIL8. GL_NONE picks RGBA8 for color,
+	// DEPTH_COMPONENT32F for depth, STENCIL_INDEX8 for stencil and
+	// DEPTH24_STENCIL8 for both. Attaching to an occupied point replaces
+	// the attachment there.
+	AttachmentHandle createRenderBufferAndAttach(const std::string& name, RBUFFER_TYPE type, GLenum internalFormat, GLsizei width, GLsizei height, GLuint colorSlot=0);
+	AttachmentHandle attach2DTexture(const std::string& name, TEXTURE_BUFFER_TYPE tbtype, GLsizei width, GLsizei height, GLint level, GLuint colorSlot=0, GLenum internalFormat=GL_NONE);
+	FBO_RESULT deleteAttachment(AttachmentHandle handle);
+	FBO_RESULT findAttachment(const std::string& name, AttachmentHandle& handle)const;
+
+	// Clears
+	// clear() covers every attachment, color may be NULL to leave the
+	// color attachments alone
+	FBO_RESULT clearColor(AttachmentHandle handle, GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+	FBO_RESULT clearDepthStencil(AttachmentHandle handle, GLfloat depth, GLint stencil);
+	FBO_RESULT clear(const GLfloat* color, GLfloat depth=1.0f, GLint stencil=0);
+
+	// Copies
+	// Same rules as FrameBufferObject::copy(). Same size and format is a
+	// plain copy, RGBA8 and RGBA32F convert into each other. A target half
+	// the size of the source with GL_LINEAR averages 2x2 blocks, every
+	// other scaled copy samples the nearest pixel. Depth and stencil
+	// only copy with GL_NEAREST.
+	FBO_RESULT copy(SoftwareFramebuffer& target, AttachmentHandle source, AttachmentHandle destination, GLenum filter=GL_LINEAR);
+
+	// Pixel transfer
+	// Rows bottom up and tightly packed, as glReadPixels and glTexSubImage2D
+	// with an alignment of 1. The client formats are GL_RED and GL_RGBA
+	// with GL_UNSIGNED_BYTE or GL_FLOAT, GL_DEPTH_COMPONENT with GL_FLOAT,
+	// GL_STENCIL_INDEX with GL_UNSIGNED_BYTE and GL_DEPTH_STENCIL with
+	// GL_UNSIGNED_INT_24_8. Float and packed pixels are 4 byte aligned.
+	FBO_RESULT readPixels(AttachmentHandle handle, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* data)const;
+	FBO_RESULT writePixels(AttachmentHandle handle, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* data);
+
+	// Tiles
+	// direct access for software rasterizers. tile (0,0) holds the bottom
+	// left pixels, rows are SOFTWARE_TILE_SIZE pixels apart. NULL if the
+	// handle is stale or the tile is outside the attachment.
+	unsigned char* getTile(AttachmentHandle handle, GLsizei tileX, GLsizei tileY);
+
+	// Accessors
+			FBO_RESULT	getAttachmentSize(AttachmentHandle handle, GLsizei& width, GLsizei& height)const;
+			GLenum		getAttachmentFormat(AttachmentHandle handle)const; // GL_NONE if the handle is stale
+			unsigned	getNumAttachments()const;
+	static	unsigned	getPixelSize(GLenum internalFormat); // bytes, 0 if the format is not supported
+
+private:
+
+	SoftwareFramebuffer(const SoftwareFramebuffer&);
+	SoftwareFramebuffer& operator=(const SoftwareFramebuffer&);
+
+	AttachmentHandle attach(const std::string& name, GLenum attachmentPoint, GLenum internalFormat, GLsizei width, GLsizei height);
+	SoftwareImage* getImage(AttachmentHandle handle);
+	const SoftwareImage* getImage(AttachmentHandle handle)const;
+	void clearImage(SoftwareImage& image, const GLfloat* value);
+
+	static GLenum getAttachmentPoint(unsigned type, GLuint colorSlot);
+	static GLenum getDefaultFormat(unsigned type);
+
+	std::vector<SoftwareImage>	m_images;
+	std::vector<unsigned short>	m_freeImages;
+
+};
+
+#endif
@@ -0,0 +1,409 @@
+// =================================================================
+//   File      : SoftwareKernels.cpp
+//   Desc	   : Pixel kernels of the software framebuffer: fill,
+//				 2x2 box downsample and RGBA8 <-> float conversion.
+//				 Each kernel has a scalar, an SSE2 and an AVX2 form,
+//				 the best one the CPU supports is picked at startup.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "SoftwareKernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SOFTWARE_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_SSE2
+#define TARGET_AVX2
+#else
+// compiled for the instruction set without the flag for the whole file,
+// only called once the CPU reports support
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// the kernels of one level
+struct KernelTable {
+	void (*fill)(void* dst, size_t size, const unsigned char* pattern);
+	void (*downsampleRGBA8)(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, size_t numPixels);
+	void (*downsampleRGBA32F)(const float* row0, const float* row1, float* dst, size_t numPixels);
+	void (*downsampleR32F)(const float* row0, const float* row1, float* dst, size_t numPixels);
+	void (*convertRGBA8ToFloat)(const unsigned char* src, float* dst, size_t numPixels);
+	void (*convertFloatToRGBA8)(const float* src, unsigned char* dst, size_t numPixels);
+};
+
+static const float UNORM8_SCALE = 1.0f / 255.0f;
+
+//=========================================
+// Scalar
+//=========================================
+// the vector forms add both rows first, the scalar ones do the same so
+// all levels give identical results
+static void fillScalar(void* dst, size_t size, const unsigned char* pattern)
+{
+	unsigned char* out = (unsigned char*)dst;
+	for(size_t i=0; i<size; i+=16)
+		memcpy(out + i, pattern, 16);
+}
+
+static void downsampleRGBA8Scalar(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, size_t numPixels)
+{
+	for(size_t i=0; i<numPixels*4; ++i)
+	{
+		size_t left = (i/4)*8 + i%4;
+		dst[i] = (unsigned char)((row0[left] + row1[left] + row0[left+4] + row1[left+4] + 2) >> 2);
+	}
+}
+
+static void downsampleRGBA32FScalar(const float* row0, const float* row1, float* dst, size_t numPixels)
+{
+	for(size_t i=0; i<numPixels*4; ++i)
+	{
+		size_t left = (i/4)*8 + i%4;
+		dst[i] = ((row0[left] + row1[left]) + (row0[left+4] + row1[left+4])) * 0.25f;
+	}
+}
+
+static void downsampleR32FScalar(const float* row0, const float* row1, float* dst, size_t numPixels)
+{
+	for(size_t i=0; i<numPixels; ++i)
+		dst[i] = ((row0[2*i] + row1[2*i]) + (row0[2*i+1] + row1[2*i+1])) * 0.25f;
+}
+
+static void convertRGBA8ToFloatScalar(const unsigned char* src, float* dst, size_t numPixels)
+{
+	for(size_t i=0; i<numPixels*4; ++i)
+		dst[i] = src[i] * UNORM8_SCALE;
+}
+
+static void convertFloatToRGBA8Scalar(const float* src, unsigned char* dst, size_t numPixels)
+{
+	for(size_t i=0; i<numPixels*4; ++i)
+		dst[i] = (unsigned char)(int)(std::min(std::max(src[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+static const KernelTable g_scalarKernels = {
+	fillScalar, downsampleRGBA8Scalar, downsampleRGBA32FScalar, downsampleR32FScalar, convertRGBA8ToFloatScalar, convertFloatToRGBA8Scalar
+};
+
+#if defined(SOFTWARE_KERNELS_X86)
+//=========================================
+// SSE2
+//=========================================
+TARGET_SSE2 static void fillSSE2(void* dst, size_t size, const unsigned char* pattern)
+{
+	__m128i value = _mm_loadu_si128((const __m128i*)pattern);
+	for(unsigned char* out = (unsigned char*)dst; size>0; out+=64, size-=64)
+	{
+		_mm_store_si128((__m128i*)out, value);
+		_mm_store_si128((__m128i*)(out+16), value);
+		_mm_store_si128((__m128i*)(out+32), value);
+		_mm_store_si128((__m128i*)(out+48), value);
+	}
+}
+
+TARGET_SSE2 static void downsampleRGBA8SSE2(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, size_t numPixels)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16(2);
+	size_t i = 0;
+	for(; i+2<=numPixels; i+=2)
+	{
+		// four source pixels of each row widened to 16 bits, rows added
+		__m128i a = _mm_loadu_si128((const __m128i*)(row0 + i*8));
+		__m128i b = _mm_loadu_si128((const __m128i*)(row1 + i*8));
+		__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+		__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+		// neighbouring pixels added
+		__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+		sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+		_mm_storel_epi64((__m128i*)(dst + i*4), _mm_packus_epi16(sum, sum));
+	}
+	downsampleRGBA8Scalar(row0 + i*8, row1 + i*8, dst + i*4, numPixels - i);
+}
+
+TARGET_SSE2 static void downsampleRGBA32FSSE2(const float* row0, const float* row1, float* dst, size_t numPixels)
+{
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	for(size_t i=0; i<numPixels; ++i)
+	{
+		__m128 left = _mm_add_ps(_mm_loadu_ps(row0 + i*8), _mm_loadu_ps(row1 + i*8));
+		__m128 right = _mm_add_ps(_mm_loadu_ps(row0 + i*8 + 4), _mm_loadu_ps(row1 + i*8 + 4));
+		_mm_storeu_ps(dst + i*4, _mm_mul_ps(_mm_add_ps(left, right), quarter));
+	}
+}
+
+TARGET_SSE2 static void downsampleR32FSSE2(const float* row0, const float* row1, float* dst, size_t numPixels)
+{
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	size_t i = 0;
+	for(; i+4<=numPixels; i+=4)
+	{
+		__m128 first = _mm_add_ps(_mm_loadu_ps(row0 + i*2), _mm_loadu_ps(row1 + i*2));
+		__m128 second = _mm_add_ps(_mm_loadu_ps(row0 + i*2 + 4), _mm_loadu_ps(row1 + i*2 + 4));
+		__m128 even = _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 odd = _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1));
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_add_ps(even, odd), quarter));
+	}
+	downsampleR32FScalar(row0 + i*2, row1 + i*2, dst + i, numPixels - i);
+}
+
+TARGET_SSE2 static void convertRGBA8ToFloatSSE2(const unsigned char* src, float* dst, size_t numPixels)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(UNORM8_SCALE);
+	size_t i = 0;
+	for(; i+4<=numPixels; i+=4)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(src + i*4));
+		__m128i lo = _mm_unpacklo_epi8(bytes, zero);
+		__m128i hi = _mm_unpackhi_epi8(bytes, zero);
+		float* out = dst + i*4;
+		_mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+		_mm_storeu_ps(out + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+		_mm_storeu_ps(out + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+		_mm_storeu_ps(out + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+	}
+	convertRGBA8ToFloatScalar(src + i*4, dst + i*4, numPixels - i);
+}
+
+TARGET_SSE2 static __m128i quantizeSSE2(const float* src)
+{
+	__m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+TARGET_SSE2 static void convertFloatToRGBA8SSE2(const float* src, unsigned char* dst, size_t numPixels)
+{
+	size_t i = 0;
+	for(; i+4<=numPixels; i+=4)
+	{
+		const float* in = src + i*4;
+		__m128i lo = _mm_packs_epi32(quantizeSSE2(in), quantizeSSE2(in + 4));
+		__m128i hi = _mm_packs_epi32(quantizeSSE2(in + 8), quantizeSSE2(in + 12));
+		_mm_storeu_si128((__m128i*)(dst + i*4), _mm_packus_epi16(lo, hi));
+	}
+	convertFloatToRGBA8Scalar(src + i*4, dst + i*4, numPixels - i);
+}
+
+static const KernelTable g_sse2Kernels = {
+	fillSSE2, downsampleRGBA8SSE2, downsampleRGBA32FSSE2, downsampleR32FSSE2, convertRGBA8ToFloatSSE2, convertFloatToRGBA8SSE2
+};
+
+//=========================================
+// AVX2
+//=========================================
+TARGET_AVX2 static void fillAVX2(void* dst, size_t size, const unsigned char* pattern)
+{
+	__m256i value = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)pattern));
+	for(unsigned char* out = (unsigned char*)dst; size>0; out+=64, size-=64)
+	{
+		_mm256_store_si256((__m256i*)out, value);
+		_mm256_store_si256((__m256i*)(out+32), value);
+	}
+}
+
+TARGET_AVX2 static void downsampleRGBA8AVX2(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, size_t numPixels)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i two = _mm256_set1_epi16(2);
+	size_t i = 0;
+	for(; i+4<=numPixels; i+=4)
+	{
+		// the same steps as SSE2 in both 128 bit lanes
+		__m256i a = _mm256_loadu_si256((const __m256i*)(row0 + i*8));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(row1 + i*8));
+		__m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+		__m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+		__m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+		sum = _mm256_srli_epi16(_mm256_add_epi16(sum, two), 2);
+		// two result pixels per lane, gathered into the low lane
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128((__m128i*)(dst + i*4), _mm256_castsi256_si128(packed));
+	}
+	downsampleRGBA8SSE2(row0 + i*8, row1 + i*8, dst + i*4, numPixels - i);
+}
+
+TARGET_AVX2 static void downsampleRGBA32FAVX2(const float* row0, const float* row1, float* dst, size_t numPixels)
+{
+	const __m256 quarter = _mm256_set1_ps(0.25f);
+	size_t i = 0;
+	for(; i+2<=numPixels; i+=2)
+	{
+		// first holds the rows added for source pixels 0 and 1, second for 2 and 3
+		__m256 first = _mm256_add_ps(_mm256_loadu_ps(row0 + i*8), _mm256_loadu_ps(row1 + i*8));
+		__m256 second = _mm256_add_ps(_mm256_loadu_ps(row0 + i*8 + 8), _mm256_loadu_ps(row1 + i*8 + 8));
+		__m256 left = _mm256_permute2f128_ps(first, second, 0x20);
+		__m256 right = _mm256_permute2f128_ps(first, second, 0x31);
+		_mm256_storeu_ps(dst + i*4, _mm256_mul_ps(_mm256_add_ps(left, right), quarter));
+	}
+	downsampleRGBA32FSSE2(row0 + i*8, row1 + i*8, dst + i*4, numPixels - i);
+}
+
+TARGET_AVX2 static void downsampleR32FAVX2(const float* row0, const float* row1, float* dst, size_t numPixels)
+{
+	const __m256 quarter = _mm256_set1_ps(0.25f);
+	size_t i = 0;
+	for(; i+8<=numPixels; i+=8)
+	{
+		__m256 first = _mm256_add_ps(_mm256_loadu_ps(row0 + i*2), _mm256_loadu_ps(row1 + i*2));
+		__m256 second = _mm256_add_ps(_mm256_loadu_ps(row0 + i*2 + 8), _mm256_loadu_ps(row1 + i*2 + 8));
+		__m256 even = _mm256_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+		__m256 odd = _mm256_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1));
+		// the lanes hold results 0,1,4,5 and 2,3,6,7
+		__m256 sum = _mm256_mul_ps(_mm256_add_ps(even, odd), quarter);
+		sum = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sum), _MM_SHUFFLE(3, 1, 2, 0)));
+		_mm256_storeu_ps(dst + i, sum);
+	}
+	downsampleR32FSSE2(row0 + i*2, row1 + i*2, dst + i, numPixels - i);
+}
+
+TARGET_AVX2 static void convertRGBA8ToFloatAVX2(const unsigned char* src, float* dst, size_t numPixels)
+{
+	const __m256 scale = _mm256_set1_ps(UNORM8_SCALE);
+	size_t i = 0;
+	for(; i+2<=numPixels; i+=2)
+	{
+		__m256i values = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i*4)));
+		_mm256_storeu_ps(dst + i*4, _mm256_mul_ps(_mm256_cvtepi32_ps(values), scale));
+	}
+	convertRGBA8ToFloatScalar(src + i*4, dst + i*4, numPixels - i);
+}
+
+TARGET_AVX2 static __m256i quantizeAVX2(const float* src)
+{
+	__m256 value = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+}
+
+TARGET_AVX2 static void convertFloatToRGBA8AVX2(const float* src, unsigned char* dst, size_t numPixels)
+{
+	// packing works per lane, which leaves the pixels in the order 0,2,4,6,1,3,5,7
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	size_t i = 0;
+	for(; i+8<=numPixels; i+=8)
+	{
+		const float* in = src + i*4;
+		__m256i lo = _mm256_packs_epi32(quantizeAVX2(in), quantizeAVX2(in + 8));
+		__m256i hi = _mm256_packs_epi32(quantizeAVX2(in + 16), quantizeAVX2(in + 24));
+		__m256i packed = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), order);
+		_mm256_storeu_si256((__m256i*)(dst + i*4), packed);
+	}
+	convertFloatToRGBA8SSE2(src + i*4, dst + i*4, numPixels - i);
+}
+
+static const KernelTable g_avx2Kernels = {
+	fillAVX2, downsampleRGBA8AVX2, downsampleRGBA32FAVX2, downsampleR32FAVX2, convertRGBA8ToFloatAVX2, convertFloatToRGBA8AVX2
+};
+#endif
+
+//=========================================
+// Dispatch
+//=========================================
+static const KernelTable* getKernelTable(SOFTWARE_KERNEL_LEVEL level)
+{
+#if defined(SOFTWARE_KERNELS_X86)
+	if(level==SKL_AVX2) return &g_avx2Kernels;
+	if(level==SKL_SSE2) return &g_sse2Kernels;
+#endif
+	return &g_scalarKernels;
+}
+
+static SOFTWARE_KERNEL_LEVEL g_level = SoftwareKernels::getSupportedLevel();
+static const KernelTable* g_kernels = getKernelTable(g_level);
+
+
+void SoftwareKernels::fill(void* dst, size_t size, const unsigned char* pattern)
+{
+	g_kernels->fill(dst, size, pattern);
+}
+
+
+void SoftwareKernels::downsampleRGBA8(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, size_t numPixels)
+{
+	g_kernels->downsampleRGBA8(row0, row1, dst, numPixels);
+}
+
+
+void SoftwareKernels::downsampleRGBA32F(const float* row0, const float* row1, float* dst, size_t numPixels)
+{
+	g_kernels->downsampleRGBA32F(row0, row1, dst, numPixels);
+}
+
+
+void SoftwareKernels::downsampleR32F(const float* row0, const float* row1, float* dst, size_t numPixels)
+{
+	g_kernels->downsampleR32F(row0, row1, dst, numPixels);
+}
+
+
+void SoftwareKernels::convertRGBA8ToFloat(const unsigned char* src, float* dst, size_t numPixels)
+{
+	g_kernels->convertRGBA8ToFloat(src, dst, numPixels);
+}
+
+
+void SoftwareKernels::convertFloatToRGBA8(const float* src, unsigned char* dst, size_t numPixels)
+{
+	g_kernels->convertFloatToRGBA8(src, dst, numPixels);
+}
+
+
+void SoftwareKernels::setLevel(SOFTWARE_KERNEL_LEVEL level)
+{
+	g_level = std::min(level, getSupportedLevel());
+	g_kernels = getKernelTable(g_level);
+}
+
+
+SOFTWARE_KERNEL_LEVEL SoftwareKernels::getLevel()
+{
+	return g_level;
+}
+
+
+SOFTWARE_KERNEL_LEVEL SoftwareKernels::getSupportedLevel()
+{
+#if defined(SOFTWARE_KERNELS_X86)
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1<<26))!=0;
+	// the OS has to save the ymm registers as well
+	bool avx = (info[2] & (1<<27)) && (info[2] & (1<<28)) && (_xgetbv(0) & 6)==6;
+	bool avx2 = false;
+	if(avx && maxLeaf>=7)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1<<5))!=0;
+	}
+#else
+	__builtin_cpu_init();
+	bool sse2 = __builtin_cpu_supports("sse2");
+	bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+	if(avx2) return SKL_AVX2;
+	if(sse2) return SKL_SSE2;
+#endif
+	return SKL_SCALAR;
+}
+
+
+const char* SoftwareKernels::getLevelName(SOFTWARE_KERNEL_LEVEL level)
+{
+	switch(level)
+	{
+		case SKL_SSE2: return "sse2";
+		case SKL_AVX2: return "avx2";
+		default:	   return "scalar";
+	}
+}
@@ -0,0 +1,47 @@
+// =================================================================
+//   File      : SoftwareKernels.h
+//   Desc	   : Pixel kernels of the software framebuffer: fill,
+//				 2x2 box downsample and RGBA8 <-> float conversion.
+//				 Each kernel has a scalar, an SSE2 and an AVX2 form,
+//				 the best one the CPU supports is picked at startup.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef SOFTWAREKERNELS_H
+#define SOFTWAREKERNELS_H
+
+#include <cstddef>
+
+// instruction sets the kernels are written for
+enum SOFTWARE_KERNEL_LEVEL {SKL_SCALAR=0, SKL_SSE2, SKL_AVX2};
+
+
+class SoftwareKernels
+{
+public:
+
+	// fills size bytes with a 16 byte pattern. dst is 64 byte aligned and
+	// size a multiple of 64, as tiles are.
+	static void fill(void* dst, size_t size, const unsigned char* pattern);
+
+	// dst[i] is the average of the pixels 2i and 2i+1 of both source rows
+	static void downsampleRGBA8(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, size_t numPixels);
+	static void downsampleRGBA32F(const float* row0, const float* row1, float* dst, size_t numPixels);
+	static void downsampleR32F(const float* row0, const float* row1, float* dst, size_t numPixels);
+
+	// unsigned normalized bytes to floats and back, floats are clamped to [0,1]
+	static void convertRGBA8ToFloat(const unsigned char* src, float* dst, size_t numPixels);
+	static void convertFloatToRGBA8(const float* src, unsigned char* dst, size_t numPixels);
+
+	// the level is clamped to what the CPU supports. not thread safe, set
+	// it while no kernel runs.
+	static void setLevel(SOFTWARE_KERNEL_LEVEL level);
+	static SOFTWARE_KERNEL_LEVEL getLevel();
+	static SOFTWARE_KERNEL_LEVEL getSupportedLevel();
+	static const char* getLevelName(SOFTWARE_KERNEL_LEVEL level);
+
+};
+
+#endif
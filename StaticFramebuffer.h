@@ -0,0 +1,402 @@
+// =================================================================
+//   File      : StaticFramebuffer.h
+//   Desc	   : Framebuffer whose target mode and attachment layout
+//				 are template parameters. Targets, attachment points
+//				 and draw buffers are resolved when the code compiles,
+//				 the attachments live in a fixed-size array and a
+//				 layout with a format that does not fit its buffer,
+//				 with two attachments on the same point or with mixed
+//				 sample counts is rejected by the compiler. For fbos
+//				 whose layout never changes; use FrameBufferObject
+//				 when it has to change at runtime.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef STATICFRAMEBUFFER_H
+#define STATICFRAMEBUFFER_H
+
+#include <tuple>
+#include "FrameBufferObject.h"
+
+// Usage
+//
+//   typedef StaticFramebuffer<BTM_WRITE,
+//       TextureLayout<TBT_COLOR, GL_RGBA16F, 0>,
+//       TextureLayout<TBT_COLOR, GL_RGBA8, 1>,
+//       RenderBufferLayout<RBT_DEPTH_AND_STENCIL, GL_DEPTH24_STENCIL8> > GBuffer;
+//
+//   GBuffer gbuffer(1280, 720);
+//   gbuffer.bind();
+//   GLuint normals = gbuffer.getAttachmentID<1>();
+
+// GL guarantees this many color attachments, layouts stay within it
+static const GLuint STATIC_MAX_COLOR_SLOTS = 8;
+
+// buffer types are passed as their index, RBUFFER_TYPE and
+// TEXTURE_BUFFER_TYPE share the order color, depth, stencil, depth-stencil
+constexpr GLenum getLayoutAttachmentPoint(unsigned type, GLuint colorSlot)
+{
+	return type==TBT_DEPTH ? GL_DEPTH_ATTACHMENT :
+		type==TBT_STENCIL ? GL_STENCIL_ATTACHMENT :
+		type==TBT_DEPTH_AND_STENCIL ? GL_DEPTH_STENCIL_ATTACHMENT :
+		GL_COLOR_ATTACHMENT0 + colorSlot;
+}
+
+constexpr GLbitfield getLayoutBufferMask(unsigned type)
+{
+	return type==TBT_DEPTH ? GL_DEPTH_BUFFER_BIT :
+		type==TBT_STENCIL ? GL_STENCIL_BUFFER_BIT :
+		type==TBT_DEPTH_AND_STENCIL ? GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT :
+		GL_COLOR_BUFFER_BIT;
+}
+
+// same mapping as FrameBufferObject::getFormatMask()
+constexpr GLbitfield getLayoutFormatMask(GLenum intFormat)
+{
+	return intFormat==GL_DEPTH_COMPONENT16 || intFormat==GL_DEPTH_COMPONENT24 || intFormat==GL_DEPTH_COMPONENT32 || intFormat==GL_DEPTH_COMPONENT32F ? GL_DEPTH_BUFFER_BIT :
+		intFormat==GL_DEPTH24_STENCIL8 || intFormat==GL_DEPTH32F_STENCIL8 ? GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT :
+		intFormat==GL_STENCIL_INDEX1 || intFormat==GL_STENCIL_INDEX4 || intFormat==GL_STENCIL_INDEX8 || intFormat==GL_STENCIL_INDEX16 ? GL_STENCIL_BUFFER_BIT :
+		GL_COLOR_BUFFER_BIT;
+}
+
+// immutable storage takes sized formats only
+constexpr bool isLayoutFormatSized(GLenum intFormat)
+{
+	return intFormat!=GL_NONE && intFormat!=GL_RED && intFormat!=GL_RG && intFormat!=GL_RGB && intFormat!=GL_RGBA &&
+		intFormat!=GL_DEPTH_COMPONENT && intFormat!=GL_DEPTH_STENCIL && intFormat!=GL_STENCIL_INDEX;
+}
+
+// bit per attachment point, depth-stencil takes both the depth and the stencil bit
+constexpr unsigned getLayoutPointBits(unsigned type, GLuint colorSlot)
+{
+	return type==TBT_DEPTH ? 1u :
+		type==TBT_STENCIL ? 2u :
+		type==TBT_DEPTH_AND_STENCIL ? 3u :
+		4u << colorSlot;
+}
+
+
+// attachment of a layout, a texture or renderbuffer of the fbo size
+template<unsigned Type, GLenum InternalFormat, GLuint ColorSlot, GLsizei Samples, bool IsRenderBuffer>
+struct AttachmentLayout
+{
+	static_assert(isLayoutFormatSized(InternalFormat), "attachment layout needs a sized internal format");
+	static_assert((getLayoutFormatMask(InternalFormat) & getLayoutBufferMask(Type))==getLayoutBufferMask(Type), "internal format does not fit the attachment point");
+	static_assert(Type!=TBT_COLOR || ColorSlot<STATIC_MAX_COLOR_SLOTS, "color slot exceeds the guaranteed number of color attachments");
+	static_assert(Samples>=0, "negative sample count");
+
+	static constexpr bool isRenderBuffer = IsRenderBuffer;
+	static constexpr GLenum attachmentPoint = getLayoutAttachmentPoint(Type, ColorSlot);
+	static constexpr GLenum intFormat = InternalFormat;
+	static constexpr GLsizei samples = Samples;
+	static constexpr unsigned pointBits = getLayoutPointBits(Type, ColorSlot);
+	static constexpr unsigned colorBits = Type==TBT_COLOR ? 1u << ColorSlot : 0u;
+};
+
+template<TEXTURE_BUFFER_TYPE Type, GLenum InternalFormat, GLuint ColorSlot=0, GLsizei Samples=0>
+struct TextureLayout : AttachmentLayout<Type, InternalFormat, ColorSlot, Samples, false> {};
+
+template<RBUFFER_TYPE Type, GLenum InternalFormat, GLuint ColorSlot=0, GLsizei Samples=0>
+struct RenderBufferLayout : AttachmentLayout<Type, InternalFormat, ColorSlot, Samples, true> {};
+
+
+// attachment points and color slots of a whole layout
+template<class... Layouts>
+struct LayoutPoints
+{
+	static constexpr unsigned pointBits = 0u;
+	static constexpr unsigned colorBits = 0u;
+	static constexpr bool disjoint = true;
+	static constexpr bool multisampleTextures = false;
+	static constexpr GLsizei samples = -1; // no attachment to compare with
+	static constexpr bool sameSamples = true;
+};
+
+template<class First, class... Rest>
+struct LayoutPoints<First, Rest...>
+{
+	static constexpr unsigned pointBits = First::pointBits | LayoutPoints<Rest...>::pointBits;
+	static constexpr unsigned colorBits = First::colorBits | LayoutPoints<Rest...>::colorBits;
+	static constexpr bool disjoint = (First::pointBits & LayoutPoints<Rest...>::pointBits)==0u && LayoutPoints<Rest...>::disjoint;
+	static constexpr bool multisampleTextures = (!First::isRenderBuffer && First::samples>0) || LayoutPoints<Rest...>::multisampleTextures;
+	// a framebuffer mixing sample counts is never complete
+	static constexpr GLsizei samples = First::samples;
+	static constexpr bool sameSamples = (LayoutPoints<Rest...>::samples<0 || First::samples==LayoutPoints<Rest...>::samples) && LayoutPoints<Rest...>::sameSamples;
+};
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+class StaticFramebuffer
+{
+public:
+
+	static_assert(sizeof...(Layouts)>0, "static framebuffer without attachments");
+	static_assert(LayoutPoints<Layouts...>::disjoint, "two attachments of the layout share an attachment point");
+	static_assert(LayoutPoints<Layouts...>::sameSamples, "attachments of the layout have different sample counts");
+
+	static constexpr GLenum TARGET = Mode==BTM_READ ? GL_READ_FRAMEBUFFER : Mode==BTM_WRITE ? GL_DRAW_FRAMEBUFFER : GL_FRAMEBUFFER;
+	static constexpr unsigned NUM_ATTACHMENTS = sizeof...(Layouts);
+
+	 // Constructor/Destructor
+	 // allocates every attachment with immutable storage and checks the
+	 // status once, see isComplete()
+	 StaticFramebuffer(GLsizei width, GLsizei height);
+	~StaticFramebuffer();
+
+	// binds to the target of the mode, the cache of the current context is
+	// looked up unless it is passed in
+	void bind()const;
+	void bind(BindingCache& cache)const;
+	// discards the contents of every attachment
+	FBO_RESULT invalidate();
+
+	// Accessors
+	template<unsigned Index> GLuint getAttachmentID()const;
+	template<unsigned Index> static constexpr GLenum getAttachmentPoint();
+	GLuint	getID()const;
+	GLsizei	getWidth()const;
+	GLsizei	getHeight()const;
+	bool	isComplete()const;
+
+private:
+
+	StaticFramebuffer(const StaticFramebuffer&);
+	StaticFramebuffer& operator=(const StaticFramebuffer&);
+
+	// layout flattened for the construction loop
+	struct Entry {
+		bool isRenderBuffer;
+		GLenum attachmentPoint;
+		GLenum intFormat;
+		GLsizei samples;
+	};
+
+	static constexpr Entry s_layout[NUM_ATTACHMENTS] = {{Layouts::isRenderBuffer, Layouts::attachmentPoint, Layouts::intFormat, Layouts::samples}...};
+	static constexpr GLenum s_attachmentPoints[NUM_ATTACHMENTS] = {Layouts::attachmentPoint...};
+
+	GLuint	m_fbo;
+	GLuint	m_ids[NUM_ATTACHMENTS];
+	GLsizei	m_width;
+	GLsizei	m_height;
+	bool	m_complete;
+
+};
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+constexpr typename StaticFramebuffer<Mode, Layouts...>::Entry StaticFramebuffer<Mode, Layouts...>::s_layout[StaticFramebuffer<Mode, Layouts...>::NUM_ATTACHMENTS];
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+constexpr GLenum StaticFramebuffer<Mode, Layouts...>::s_attachmentPoints[StaticFramebuffer<Mode, Layouts...>::NUM_ATTACHMENTS];
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+StaticFramebuffer<Mode, Layouts...>::StaticFramebuffer(GLsizei width, GLsizei height) : m_fbo(0), m_width(width), m_height(height), m_complete(false)
+{
+	for(unsigned i=0; i<NUM_ATTACHMENTS; ++i)
+		m_ids[i] = 0;
+
+	if(!(GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) ||
+		(LayoutPoints<Layouts...>::multisampleTextures && !(GLEW_VERSION_4_3 || GLEW_ARB_texture_storage_multisample)))
+	{
+		std::cerr << "Error: static framebuffer requires immutable texture storage...\n";
+		return;
+	}
+
+	// color slots in ascending order, like FrameBufferObject derives them
+	GLenum drawBuffers[STATIC_MAX_COLOR_SLOTS];
+	GLsizei numDrawBuffers = 0;
+	for(GLuint slot=0; slot<STATIC_MAX_COLOR_SLOTS; ++slot)
+	{
+		if(LayoutPoints<Layouts...>::colorBits & (1u << slot)) drawBuffers[numDrawBuffers++] = GL_COLOR_ATTACHMENT0 + slot;
+	}
+
+	GLenum status;
+	if(FrameBufferObject::isDirectStateAccessEnabled())
+	{
+		glCreateFramebuffers(1, &m_fbo);
+		for(unsigned i=0; i<NUM_ATTACHMENTS; ++i)
+		{
+			const Entry& entry = s_layout[i];
+			if(entry.isRenderBuffer)
+			{
+				glCreateRenderbuffers(1, &m_ids[i]);
+				if(entry.samples>0)
+					glNamedRenderbufferStorageMultisample(m_ids[i], entry.samples, entry.intFormat, width, height);
+				else
+					glNamedRenderbufferStorage(m_ids[i], entry.intFormat, width, height);
+				glNamedFramebufferRenderbuffer(m_fbo, entry.attachmentPoint, GL_RENDERBUFFER, m_ids[i]);
+			}
+			else
+			{
+				glCreateTextures(entry.samples>0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, 1, &m_ids[i]);
+				if(entry.samples>0)
+					glTextureStorage2DMultisample(m_ids[i], entry.samples, entry.intFormat, width, height, GL_TRUE);
+				else
+					glTextureStorage2D(m_ids[i], 1, entry.intFormat, width, height);
+				glNamedFramebufferTexture(m_fbo, entry.attachmentPoint, m_ids[i], 0);
+			}
+		}
+
+		// draw buffer state belongs to the fbo, read-only fbos do not need it
+		if(Mode!=BTM_READ)
+		{
+			if(numDrawBuffers>0)
+				glNamedFramebufferDrawBuffers(m_fbo, numDrawBuffers, drawBuffers);
+			else
+				glNamedFramebufferDrawBuffer(m_fbo, GL_NONE);
+		}
+		status = glCheckNamedFramebufferStatus(m_fbo, TARGET);
+	}
+	else
+	{
+		BindingCache& cache = BindingCache::current();
+		glGenFramebuffers(1, &m_fbo);
+		cache.bindFramebuffer(TARGET, m_fbo);
+		for(unsigned i=0; i<NUM_ATTACHMENTS; ++i)
+		{
+			const Entry& entry = s_layout[i];
+			if(entry.isRenderBuffer)
+			{
+				glGenRenderbuffers(1, &m_ids[i]);
+				cache.bindRenderbuffer(m_ids[i]);
+				if(entry.samples>0)
+					glRenderbufferStorageMultisample(GL_RENDERBUFFER, entry.samples, entry.intFormat, width, height);
+				else
+					glRenderbufferStorage(GL_RENDERBUFFER, entry.intFormat, width, height);
+				glFramebufferRenderbuffer(TARGET, entry.attachmentPoint, GL_RENDERBUFFER, m_ids[i]);
+			}
+			else
+			{
+				GLenum textureTarget = entry.samples>0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+				glGenTextures(1, &m_ids[i]);
+				cache.bindTexture(textureTarget, m_ids[i]);
+				if(entry.samples>0)
+					glTexStorage2DMultisample(textureTarget, entry.samples, entry.intFormat, width, height, GL_TRUE);
+				else
+					glTexStorage2D(textureTarget, 1, entry.intFormat, width, height);
+				glFramebufferTexture2D(TARGET, entry.attachmentPoint, textureTarget, m_ids[i], 0);
+			}
+		}
+
+		if(Mode!=BTM_READ)
+		{
+			if(numDrawBuffers>0)
+				glDrawBuffers(numDrawBuffers, drawBuffers);
+			else
+				glDrawBuffer(GL_NONE);
+		}
+		status = glCheckFramebufferStatus(TARGET);
+	}
+
+	m_complete = status==GL_FRAMEBUFFER_COMPLETE;
+	if(!m_complete)
+		std::cerr << "Error: static framebuffer is incomplete: " << FrameBufferObject::getStatusString(status) << "...\n";
+}
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+StaticFramebuffer<Mode, Layouts...>::~StaticFramebuffer()
+{
+	BindingCache& cache = BindingCache::current();
+	if(m_fbo)
+	{
+		glDeleteFramebuffers(1, &m_fbo);
+		cache.onFramebufferDeleted(m_fbo);
+	}
+
+	for(unsigned i=0; i<NUM_ATTACHMENTS; ++i)
+	{
+		if(m_ids[i]==0) continue;
+
+		if(s_layout[i].isRenderBuffer)
+		{
+			glDeleteRenderbuffers(1, &m_ids[i]);
+			cache.onRenderbufferDeleted(m_ids[i]);
+		}
+		else
+		{
+			glDeleteTextures(1, &m_ids[i]);
+			cache.onTextureDeleted(m_ids[i]);
+		}
+	}
+}
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+inline void StaticFramebuffer<Mode, Layouts...>::bind()const
+{
+	BindingCache::current().bindFramebuffer(TARGET, m_fbo);
+}
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+inline void StaticFramebuffer<Mode, Layouts...>::bind(BindingCache& cache)const
+{
+	cache.bindFramebuffer(TARGET, m_fbo);
+}
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+FBO_RESULT StaticFramebuffer<Mode, Layouts...>::invalidate()
+{
+	if(!FrameBufferObject::isInvalidationSupported()) return FR_UNSUPPORTED;
+
+	if(FrameBufferObject::isDirectStateAccessEnabled())
+		glInvalidateNamedFramebufferData(m_fbo, NUM_ATTACHMENTS, s_attachmentPoints);
+	else
+	{
+		BindingCache::current().bindFramebuffer(TARGET, m_fbo);
+		glInvalidateFramebuffer(TARGET, NUM_ATTACHMENTS, s_attachmentPoints);
+	}
+	return FR_OK;
+}
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+template<unsigned Index>
+inline GLuint StaticFramebuffer<Mode, Layouts...>::getAttachmentID()const
+{
+	static_assert(Index<NUM_ATTACHMENTS, "attachment index out of the layout");
+	return m_ids[Index];
+}
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+template<unsigned Index>
+constexpr GLenum StaticFramebuffer<Mode, Layouts...>::getAttachmentPoint()
+{
+	return std::tuple_element<Index, std::tuple<Layouts...> >::type::attachmentPoint;
+}
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+inline GLuint StaticFramebuffer<Mode, Layouts...>::getID()const
+{
+	return m_fbo;
+}
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+inline GLsizei StaticFramebuffer<Mode, Layouts...>::getWidth()const
+{
+	return m_width;
+}
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+inline GLsizei StaticFramebuffer<Mode, Layouts...>::getHeight()const
+{
+	return m_height;
+}
+
+
+template<BUFFER_TARGET_MODE Mode, class... Layouts>
+inline bool StaticFramebuffer<Mode, Layouts...>::isComplete()const
+{
+	return m_complete;
+}
+
+#endif
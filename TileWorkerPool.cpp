@@ -0,0 +1,145 @@
+// =================================================================
+//   File      : TileWorkerPool.cpp
+//   Desc	   : Persistent worker threads that split a job into
+//				 tasks, one per tile or band of tiles. The calling
+//				 thread works on the job as well and run() returns
+//				 once every task is done, so kernels can be run in
+//				 parallel without any extra synchronization.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "TileWorkerPool.h"
+
+#include <algorithm>
+
+TileWorkerPool& TileWorkerPool::getInstance()
+{
+	static TileWorkerPool pool;
+	return pool;
+}
+
+
+TileWorkerPool::TileWorkerPool(unsigned numThreads) : m_func(NULL), m_userData(NULL), m_numTasks(0), m_nextTask(0), m_numDone(0), m_numActive(0), m_job(0), m_stopping(false)
+{
+	startWorkers(numThreads);
+}
+
+
+TileWorkerPool::~TileWorkerPool()
+{
+	stopWorkers();
+}
+
+
+void TileWorkerPool::run(unsigned numTasks, TileTaskFunc func, void* userData)
+{
+	if(numTasks==0) return;
+
+	// nothing to share
+	if(numTasks==1 || m_workers.empty())
+	{
+		for(unsigned task=0; task<numTasks; ++task)
+			func(task, userData);
+		return;
+	}
+
+	std::lock_guard<std::mutex> runLock(m_runMutex);
+	{
+		// workers still leaving the previous job read its state
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_finished.wait(lock, [this]{ return m_numActive==0; });
+		m_func = func;
+		m_userData = userData;
+		m_numTasks = numTasks;
+		m_nextTask = 0;
+		m_numDone = 0;
+		++m_job;
+	}
+	m_started.notify_all();
+
+	runTasks(false);
+
+	// a worker that woke up late must not outlive the job it picked up
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_finished.wait(lock, [this]{ return m_numDone==m_numTasks && m_numActive==0; });
+}
+
+
+void TileWorkerPool::setNumThreads(unsigned numThreads)
+{
+	std::lock_guard<std::mutex> runLock(m_runMutex);
+	stopWorkers();
+	startWorkers(numThreads);
+}
+
+
+unsigned TileWorkerPool::getNumThreads()const
+{
+	return m_workers.size() + 1;
+}
+
+
+void TileWorkerPool::startWorkers(unsigned numThreads)
+{
+	if(numThreads==0) numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	m_stopping = false;
+	for(unsigned i=1; i<numThreads; ++i)
+		m_workers.push_back(std::thread(&TileWorkerPool::workerLoop, this));
+}
+
+
+void TileWorkerPool::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_started.notify_all();
+	for(std::vector<std::thread>::iterator it = m_workers.begin(); it != m_workers.end(); ++it)
+		it->join();
+	m_workers.clear();
+}
+
+
+void TileWorkerPool::workerLoop()
+{
+	unsigned long job = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		job = m_job;
+	}
+
+	for(;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_started.wait(lock, [&]{ return m_stopping || m_job!=job; });
+			if(m_stopping) return;
+
+			job = m_job;
+			++m_numActive;
+		}
+		runTasks(true);
+	}
+}
+
+
+void TileWorkerPool::runTasks(bool worker)
+{
+	unsigned numDone = 0;
+	for(unsigned task = m_nextTask++; task<m_numTasks; task = m_nextTask++)
+	{
+		m_func(task, m_userData);
+		++numDone;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_numDone += numDone;
+		if(worker) --m_numActive;
+	}
+	m_finished.notify_all();
+}
@@ -0,0 +1,76 @@
+// =================================================================
+//   File      : TileWorkerPool.h
+//   Desc	   : Persistent worker threads that split a job into
+//				 tasks, one per tile or band of tiles. The calling
+//				 thread works on the job as well and run() returns
+//				 once every task is done, so kernels can be run in
+//				 parallel without any extra synchronization.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef TILEWORKERPOOL_H
+#define TILEWORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// processes one task of a job, called concurrently for different tasks
+typedef void (*TileTaskFunc)(unsigned task, void* userData);
+
+
+class TileWorkerPool
+{
+public:
+
+	// pool shared by the software framebuffers
+	static TileWorkerPool& getInstance();
+
+	 // Constructor/Destructor
+	 // numThreads counts the calling thread, 0 uses every hardware thread
+	 TileWorkerPool(unsigned numThreads=0);
+	~TileWorkerPool();
+
+	// runs func for the tasks 0..numTasks-1 and returns when all are done.
+	// jobs from several threads are run one after the other.
+	void run(unsigned numTasks, TileTaskFunc func, void* userData);
+	// joins the workers and starts numThreads-1 new ones, 0 for every hardware thread
+	void setNumThreads(unsigned numThreads);
+
+	// Accessors
+	unsigned getNumThreads()const; // including the calling thread
+
+private:
+
+	TileWorkerPool(const TileWorkerPool&);
+	TileWorkerPool& operator=(const TileWorkerPool&);
+
+	void startWorkers(unsigned numThreads);
+	void stopWorkers();
+	void workerLoop();
+	// pulls tasks of the current job until none is left
+	void runTasks(bool worker);
+
+	std::vector<std::thread>	m_workers;
+	std::mutex					m_runMutex; // one job at a time
+	std::mutex					m_mutex;
+	std::condition_variable		m_started; // signalled for the workers
+	std::condition_variable		m_finished; // signalled for run()
+
+	// current job
+	TileTaskFunc				m_func;
+	void*						m_userData;
+	unsigned					m_numTasks;
+	std::atomic<unsigned>		m_nextTask;
+	unsigned					m_numDone;
+	unsigned					m_numActive; // workers inside runTasks()
+	unsigned long				m_job; // bumped for every job
+	bool						m_stopping;
+
+};
+
+#endif
@@ -0,0 +1,271 @@
+// =================================================================
+//   File      : TiledRenderer.cpp
+//   Desc	   : Renders offscreen images of any size, beyond the
+//				 render target limits of the driver, one tile at a
+//				 time into a single reused fbo. Tiles are read back
+//				 asynchronously and stitched into a preallocated,
+//				 memory mapped output file, so GPU memory stays at one
+//				 tile and the readback of a tile overlaps the next one.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "TiledRenderer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// upper bound of the automatic tile size, larger tiles only cost memory
+static const GLsizei MAX_TILE_SIZE = 2048;
+
+TiledRenderer::TiledRenderer() : m_fbo(NULL), m_tileWidth(0), m_tileHeight(0), m_requestedWidth(0), m_requestedHeight(0), m_depthStencil(true), m_numTiles(0),
+	m_headerSize(0), m_pixelSize(4), m_readFormat(GL_RGBA)
+{
+	m_clearColor[0] = m_clearColor[1] = m_clearColor[2] = 0.0f;
+	m_clearColor[3] = 1.0f;
+}
+
+
+TiledRenderer::~TiledRenderer()
+{
+	release();
+}
+
+
+void TiledRenderer::setTileSize(GLsizei width, GLsizei height)
+{
+	m_requestedWidth = width;
+	m_requestedHeight = height;
+}
+
+
+void TiledRenderer::setDepthStencil(bool enable)
+{
+	if(enable!=m_depthStencil) release();
+	m_depthStencil = enable;
+}
+
+
+void TiledRenderer::setClearColor(float r, float g, float b, float a)
+{
+	m_clearColor[0] = r;
+	m_clearColor[1] = g;
+	m_clearColor[2] = b;
+	m_clearColor[3] = a;
+}
+
+
+bool TiledRenderer::render(GLsizei width, GLsizei height, const std::string& path, TILED_OUTPUT_FORMAT format, TileRenderFunc func, void* userData)
+{
+	if(width<=0 || height<=0) return false;
+
+	// the tile has to fit both the texture and the renderbuffer limits
+	GLint maxTexture = MAX_TILE_SIZE, maxRenderbuffer = MAX_TILE_SIZE;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTexture);
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbuffer);
+	GLsizei maxSize = std::min(maxTexture, maxRenderbuffer);
+	GLsizei tileWidth = std::min(m_requestedWidth>0 ? m_requestedWidth : std::min(maxSize, MAX_TILE_SIZE), maxSize);
+	GLsizei tileHeight = std::min(m_requestedHeight>0 ? m_requestedHeight : std::min(maxSize, MAX_TILE_SIZE), maxSize);
+	// no tile larger than the image
+	tileWidth = std::min(tileWidth, width);
+	tileHeight = std::min(tileHeight, height);
+
+	if(!createTarget(tileWidth, tileHeight)) return false;
+
+	// the output is allocated up front, tiles land in it in any order
+	char header[64];
+	m_headerSize = 0;
+	m_pixelSize = 4;
+	m_readFormat = GL_RGBA;
+	if(format==TOF_PPM)
+	{
+		m_headerSize = (size_t)snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+		m_pixelSize = 3;
+		m_readFormat = GL_RGB;
+	}
+
+	size_t size = m_headerSize + (size_t)width * height * m_pixelSize;
+	if(!m_output.open(path)) return false;
+	if(!m_output.reserve(size))
+	{
+		m_output.close();
+		return false;
+	}
+	if(m_headerSize)
+	{
+		MappedView view;
+		if(!m_output.map(0, m_headerSize, view))
+		{
+			m_output.close();
+			return false;
+		}
+		memcpy(view.data, header, m_headerSize);
+		MappedFile::unmap(view);
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	GLsizei columns = (width + tileWidth - 1) / tileWidth;
+	GLsizei rows = (height + tileHeight - 1) / tileHeight;
+	m_numTiles = columns * rows;
+
+	TileInfo tile;
+	tile.imageWidth = width;
+	tile.imageHeight = height;
+	tile.scale[0] = (float)width / tileWidth;
+	tile.scale[1] = (float)height / tileHeight;
+	for(GLsizei row=0; row<rows; ++row)
+	{
+		for(GLsizei column=0; column<columns; ++column)
+		{
+			tile.index = row * columns + column;
+			tile.x = column * tileWidth;
+			tile.y = row * tileHeight;
+			tile.width = std::min(tileWidth, width - tile.x);
+			tile.height = std::min(tileHeight, height - tile.y);
+			tile.offset[0] = (float)(width - 2*tile.x - tileWidth) / tileWidth;
+			tile.offset[1] = (float)(height - 2*tile.y - tileHeight) / tileHeight;
+
+			m_fbo->bind();
+			glViewport(0, 0, tileWidth, tileHeight);
+			m_fbo->clear(m_clearColor);
+
+			if(func) func(*this, tile, userData);
+
+			// the ring holds a few tiles, only a full ring waits for the oldest
+			FBO_RESULT result;
+			while((result = m_fbo->queueReadback(m_color, m_readFormat, GL_UNSIGNED_BYTE))==FR_BUSY && collectTiles(true));
+			if(result==FR_OK)
+				m_pending.push_back(tile);
+			else
+				std::cerr << "Error: tile " << tile.index << " could not be read back...\n";
+
+			// depth and stencil never leave the chip
+			m_fbo->invalidate();
+			collectTiles(false);
+		}
+	}
+
+	while(!m_pending.empty() && collectTiles(true));
+
+	BindingCache::current().bindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	m_output.close(size);
+	return true;
+}
+
+
+void TiledRenderer::release()
+{
+	delete m_fbo;
+	m_fbo = NULL;
+	m_tileWidth = m_tileHeight = 0;
+}
+
+
+void TiledRenderer::getTileProjection(const TileInfo& tile, const float* projection, float* result)
+{
+	// scale and offset applied to the x and y rows of the column major matrix
+	for(unsigned column=0; column<4; ++column)
+	{
+		const float* in = projection + column*4;
+		float* out = result + column*4;
+		float w = in[3];
+		out[0] = in[0] * tile.scale[0] + w * tile.offset[0];
+		out[1] = in[1] * tile.scale[1] + w * tile.offset[1];
+		out[2] = in[2];
+		out[3] = w;
+	}
+}
+
+
+GLsizei TiledRenderer::getTileWidth()const
+{
+	return m_tileWidth;
+}
+
+
+GLsizei TiledRenderer::getTileHeight()const
+{
+	return m_tileHeight;
+}
+
+
+unsigned TiledRenderer::getNumTiles()const
+{
+	return m_numTiles;
+}
+
+
+bool TiledRenderer::createTarget(GLsizei width, GLsizei height)
+{
+	if(m_fbo && width==m_tileWidth && height==m_tileHeight) return true;
+	release();
+
+	m_fbo = new FrameBufferObject(BTM_READ_WRITE);
+	m_color = m_fbo->attach2DTexture("color", TBT_COLOR, width, height, 0, 0, GL_RGBA8);
+	if(m_depthStencil)
+	{
+		AttachmentHandle depth = m_fbo->createRenderBufferAndAttach("depth", RBT_DEPTH_AND_STENCIL, GL_DEPTH24_STENCIL8, width, height);
+		m_fbo->setTransient(depth, true);
+	}
+
+	if(!m_fbo->isComplete())
+	{
+		std::cerr << "Error: tile of " << width << "x" << height << " is incomplete...\n";
+		release();
+		return false;
+	}
+
+	m_fbo->createReadbackRing(3);
+	m_tileWidth = width;
+	m_tileHeight = height;
+	return true;
+}
+
+
+bool TiledRenderer::collectTiles(bool wait)
+{
+	bool collected = false;
+	ReadbackFrame frame;
+	while(!m_pending.empty() && m_fbo->mapReadback(frame, wait))
+	{
+		stitch(frame, m_pending.front());
+		m_fbo->unmapReadback();
+		m_pending.pop_front();
+		collected = true;
+
+		// one finished tile is enough to free the ring
+		if(wait) break;
+	}
+	return collected;
+}
+
+
+void TiledRenderer::stitch(const ReadbackFrame& frame, const TileInfo& tile)
+{
+	// the band of output rows the tile covers, the output starts at the top
+	size_t imageRow = (size_t)tile.imageWidth * m_pixelSize;
+	size_t tileRow = (size_t)tile.width * m_pixelSize;
+	GLint firstRow = tile.imageHeight - tile.y - tile.height;
+	size_t offset = m_headerSize + (size_t)firstRow * imageRow + (size_t)tile.x * m_pixelSize;
+	size_t length = (size_t)(tile.height-1) * imageRow + tileRow;
+
+	MappedView view;
+	if(!m_output.map(offset, length, view))
+	{
+		std::cerr << "Error: tile " << tile.index << " could not be written to " << m_output.getPath() << "...\n";
+		return;
+	}
+
+	// GL rows start at the bottom
+	const unsigned char* src = (const unsigned char*)frame.data;
+	for(GLsizei row=0; row<tile.height; ++row)
+		memcpy(view.data + (size_t)(tile.height-1-row) * imageRow, src + (size_t)row * frame.rowStride, tileRow);
+
+	MappedFile::unmap(view);
+}
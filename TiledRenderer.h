@@ -0,0 +1,107 @@
+// =================================================================
+//   File      : TiledRenderer.h
+//   Desc	   : Renders offscreen images of any size, beyond the
+//				 render target limits of the driver, one tile at a
+//				 time into a single reused fbo. Tiles are read back
+//				 asynchronously and stitched into a preallocated,
+//				 memory mapped output file, so GPU memory stays at one
+//				 tile and the readback of a tile overlaps the next one.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef TILEDRENDERER_H
+#define TILEDRENDERER_H
+
+#include <deque>
+#include <string>
+#include "FrameBufferObject.h"
+#include "MappedFile.h"
+
+// output of a tiled render
+// TOF_RAW	RGBA8 rows, top row first, no header
+// TOF_PPM	binary PPM
+enum TILED_OUTPUT_FORMAT {TOF_RAW=0, TOF_PPM};
+
+class TiledRenderer;
+
+// the part of the image a tile covers
+struct TileInfo {
+	unsigned index; // row major from the bottom left tile
+	GLint x; // of the bottom left pixel in the image, GL convention
+	GLint y;
+	GLsizei width; // pixels of the image in the tile, smaller at the edges
+	GLsizei height;
+	GLsizei imageWidth;
+	GLsizei imageHeight;
+	// maps the clip space of the whole image onto the tile,
+	// x' = x*scale[0] + w*offset[0], see getTileProjection()
+	float scale[2];
+	float offset[2];
+};
+
+// draws the whole image with the tile's projection, the tile fbo is
+// bound, the viewport covers it and color and depth are cleared
+typedef void (*TileRenderFunc)(TiledRenderer& renderer, const TileInfo& tile, void* userData);
+
+
+class TiledRenderer
+{
+public:
+
+	 // Constructor/Destructor
+	 TiledRenderer();
+	~TiledRenderer();
+
+	// 0 picks the largest size the driver supports, up to 2048
+	void setTileSize(GLsizei width, GLsizei height);
+	// a DEPTH24_STENCIL8 buffer is attached to the tile by default
+	void setDepthStencil(bool enable);
+	void setClearColor(float r, float g, float b, float a);
+
+	// renders the image tile by tile and writes it to path, returns false
+	// if the output could not be created
+	bool render(GLsizei width, GLsizei height, const std::string& path, TILED_OUTPUT_FORMAT format, TileRenderFunc func, void* userData=NULL);
+	// releases the tile fbo
+	void release();
+
+	// projection of the tile from the column major projection of the whole
+	// image, result may alias projection
+	static void getTileProjection(const TileInfo& tile, const float* projection, float* result);
+
+	// Accessors
+	GLsizei		getTileWidth()const; // of the last render
+	GLsizei		getTileHeight()const;
+	unsigned	getNumTiles()const;
+
+private:
+
+	TiledRenderer(const TiledRenderer&);
+	TiledRenderer& operator=(const TiledRenderer&);
+
+	bool createTarget(GLsizei width, GLsizei height);
+	// copies the finished readbacks into the output, true if there were any
+	bool collectTiles(bool wait);
+	void stitch(const ReadbackFrame& frame, const TileInfo& tile);
+
+	FrameBufferObject*		m_fbo; // the tile, reused for every one of them
+	AttachmentHandle		m_color;
+	GLsizei					m_tileWidth;
+	GLsizei					m_tileHeight;
+	GLsizei					m_requestedWidth; // 0 for the driver limit
+	GLsizei					m_requestedHeight;
+	bool					m_depthStencil;
+	float					m_clearColor[4];
+	unsigned				m_numTiles;
+
+	// output of the current render
+	MappedFile				m_output;
+	size_t					m_headerSize;
+	GLsizei					m_pixelSize; // bytes in the output
+	GLenum					m_readFormat;
+	std::deque<TileInfo>	m_pending; // tiles in the readback ring, oldest first
+
+};
+
+#endif
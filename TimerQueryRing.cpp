@@ -0,0 +1,158 @@
+// =================================================================
+//   File      : TimerQueryRing.cpp
+//   Desc	   : N-deep ring of GL_TIMESTAMP query pairs that times
+//				 GPU work between a begin and an end marker. Results
+//				 are collected a few frames later once the GPU has
+//				 written them, so timing never stalls the pipeline.
+//				 Completed samples feed rolling statistics.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "TimerQueryRing.h"
+
+#include <algorithm>
+
+TimerQueryRing::TimerQueryRing(unsigned depth, unsigned window) : m_head(0), m_tail(0), m_numPending(0), m_open(false), m_window(window ? window : 1), m_nextSample(0), m_lastSample(0.0), m_numDropped(0)
+{
+	if(depth==0) depth = 1;
+
+	m_slots.resize(depth);
+	for(unsigned i=0; i<depth; ++i)
+	{
+		glGenQueries(2, m_slots[i].queries);
+		m_slots[i].pending = false;
+	}
+	m_samples.reserve(m_window);
+}
+
+
+TimerQueryRing::~TimerQueryRing()
+{
+	for(unsigned i=0; i<m_slots.size(); ++i)
+		glDeleteQueries(2, m_slots[i].queries);
+}
+
+
+bool TimerQueryRing::begin()
+{
+	// make room first, then give up rather than wait for the GPU
+	collect();
+
+	Slot& slot = m_slots[m_head];
+	if(slot.pending || m_open)
+	{
+		++m_numDropped;
+		return false;
+	}
+
+	glQueryCounter(slot.queries[0], GL_TIMESTAMP);
+	m_open = true;
+	return true;
+}
+
+
+void TimerQueryRing::end()
+{
+	if(!m_open) return;
+
+	Slot& slot = m_slots[m_head];
+	glQueryCounter(slot.queries[1], GL_TIMESTAMP);
+	slot.pending = true;
+	m_open = false;
+
+	m_head = (m_head+1) % m_slots.size();
+	++m_numPending;
+}
+
+
+void TimerQueryRing::collect()
+{
+	while(m_numPending>0)
+	{
+		// results become available in submission order
+		Slot& slot = m_slots[m_tail];
+		GLint available = 0;
+		glGetQueryObjectiv(slot.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(!available) break;
+
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(slot.queries[0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(slot.queries[1], GL_QUERY_RESULT, &end);
+
+		m_lastSample = end>begin ? (end-begin) / 1000000.0 : 0.0;
+		if(m_samples.size()<m_window)
+			m_samples.push_back(m_lastSample);
+		else
+			m_samples[m_nextSample] = m_lastSample;
+		m_nextSample = (m_nextSample+1) % m_window;
+
+		slot.pending = false;
+		m_tail = (m_tail+1) % m_slots.size();
+		--m_numPending;
+	}
+}
+
+
+void TimerQueryRing::getStatistics(TimingStatistics& statistics)const
+{
+	statistics.numSamples = m_samples.size();
+	statistics.last = m_lastSample;
+	statistics.numDropped = m_numDropped;
+	statistics.min = statistics.mean = statistics.p95 = 0.0;
+	if(m_samples.empty()) return;
+
+	std::vector<double> sorted(m_samples);
+	std::sort(sorted.begin(), sorted.end());
+
+	double sum = 0.0;
+	for(unsigned i=0; i<sorted.size(); ++i)
+		sum += sorted[i];
+
+	statistics.min = sorted.front();
+	statistics.mean = sum / sorted.size();
+	statistics.p95 = sorted[(sorted.size()-1) * 95 / 100];
+}
+
+
+void TimerQueryRing::resetStatistics()
+{
+	m_samples.clear();
+	m_nextSample = 0;
+	m_lastSample = 0.0;
+	m_numDropped = 0;
+}
+
+
+void TimerQueryRing::writeCSVHeader(std::ostream& out)
+{
+	out << "label,samples,last_ms,min_ms,mean_ms,p95_ms,dropped\n";
+}
+
+
+void TimerQueryRing::writeCSV(std::ostream& out, const std::string& label)const
+{
+	TimingStatistics statistics;
+	getStatistics(statistics);
+	out << label << "," << statistics.numSamples << "," << statistics.last << "," << statistics.min << ","
+		<< statistics.mean << "," << statistics.p95 << "," << statistics.numDropped << "\n";
+}
+
+
+unsigned TimerQueryRing::getDepth()const
+{
+	return m_slots.size();
+}
+
+
+unsigned TimerQueryRing::getNumPending()const
+{
+	return m_numPending;
+}
+
+
+bool TimerQueryRing::isSupported()
+{
+	return GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+}
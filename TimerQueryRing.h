@@ -0,0 +1,83 @@
+// =================================================================
+//   File      : TimerQueryRing.h
+//   Desc	   : N-deep ring of GL_TIMESTAMP query pairs that times
+//				 GPU work between a begin and an end marker. Results
+//				 are collected a few frames later once the GPU has
+//				 written them, so timing never stalls the pipeline.
+//				 Completed samples feed rolling statistics.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef TIMERQUERYRING_H
+#define TIMERQUERYRING_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+// rolling statistics over the most recent samples, in milliseconds
+struct TimingStatistics {
+	unsigned numSamples; // samples in the window
+	double last;
+	double min;
+	double mean;
+	double p95;
+	unsigned long numDropped; // markers skipped because the ring was full
+};
+
+
+class TimerQueryRing
+{
+public:
+
+	 // Constructor/Destructor
+	 TimerQueryRing(unsigned depth, unsigned window=128);
+	~TimerQueryRing();
+
+	// timestamps rather than GL_TIME_ELAPSED, so the markers of different
+	// rings may nest and overlap. begin() returns false and drops the
+	// sample if the oldest pair is still in flight.
+	bool begin();
+	void end();
+
+	// moves every available result into the statistics, never blocks
+	void collect();
+
+	void getStatistics(TimingStatistics& statistics)const;
+	void resetStatistics();
+
+	// one line per ring: label,samples,last,min,mean,p95,dropped
+	static void writeCSVHeader(std::ostream& out);
+	void writeCSV(std::ostream& out, const std::string& label)const;
+
+	// Accessors
+	unsigned getDepth()const;
+	unsigned getNumPending()const;
+	static bool isSupported();
+
+private:
+
+	// begin and end timestamp of one marker pair
+	struct Slot {
+		GLuint queries[2];
+		bool pending;
+	};
+
+	std::vector<Slot>	m_slots;
+	unsigned			m_head; // next slot to begin
+	unsigned			m_tail; // oldest pending slot
+	unsigned			m_numPending;
+	bool				m_open; // begin() issued, end() outstanding
+
+	unsigned			m_window; // samples kept for the statistics
+	std::vector<double>	m_samples; // circular window of results in ms
+	unsigned			m_nextSample;
+	double				m_lastSample;
+	unsigned long		m_numDropped;
+
+};
+
+#endif
@@ -0,0 +1,290 @@
+// =================================================================
+//   File      : UploadRing.cpp
+//   Desc	   : N-deep ring of slices in one pixel unpack buffer that
+//				 is mapped persistently and coherently, so producer
+//				 threads write CPU pixels straight into GL memory and
+//				 the rendering thread only issues the texture update.
+//				 Every update is guarded by a fence and its slice is
+//				 handed out again once the GPU has consumed it.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#include "UploadRing.h"
+#include "FrameBufferObject.h"
+
+// slices start at offsets every pixel type and most drivers' dma engines accept
+static const GLsizeiptr SLICE_ALIGNMENT = 256;
+
+UploadRing::UploadRing(unsigned depth, GLsizeiptr sliceSize) : m_numPending(0), m_pbo(0), m_mapped(NULL)
+{
+	if(depth==0) depth = 1;
+	m_sliceSize = (sliceSize + SLICE_ALIGNMENT - 1) / SLICE_ALIGNMENT * SLICE_ALIGNMENT;
+
+	m_slots.resize(depth);
+	for(unsigned i=0; i<depth; ++i)
+	{
+		m_slots[i].fence = 0;
+		m_slots[i].state = SS_FREE;
+		m_free.push_back(depth-1-i);
+	}
+
+	GLsizeiptr size = m_sliceSize * depth;
+	if(isSupported())
+	{
+		// mapped for the lifetime of the ring, coherent writes need no flush
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &m_pbo);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+		m_mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		if(m_mapped) return;
+
+		std::cerr << "Error: upload ring of " << size << " bytes could not be mapped...\n";
+		glDeleteBuffers(1, &m_pbo);
+		m_pbo = 0;
+	}
+
+	m_clientMemory.resize(size);
+	m_mapped = &m_clientMemory[0];
+}
+
+
+UploadRing::~UploadRing()
+{
+	for(std::vector<Slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it)
+	{
+		if(it->fence) glDeleteSync(it->fence);
+	}
+
+	if(m_pbo)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &m_pbo);
+	}
+}
+
+
+bool UploadRing::acquire(UploadSlice& slice, bool wait)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if(m_free.empty())
+	{
+		if(!wait) return false;
+		m_freed.wait(lock, [this]{ return !m_free.empty(); });
+	}
+
+	unsigned index = m_free.back();
+	m_free.pop_back();
+	m_slots[index].state = SS_WRITING;
+
+	slice.data = m_mapped + m_sliceSize * index;
+	slice.capacity = m_sliceSize;
+	slice.slot = index;
+	return true;
+}
+
+
+bool UploadRing::commit(const UploadSlice& slice, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(slice.slot>=m_slots.size() || m_slots[slice.slot].state!=SS_WRITING) return false;
+
+	// the slice stays with the producer if the pixels do not fit
+	GLsizeiptr size = (GLsizeiptr)ReadbackRing::getPixelSize(format, type) * width * height;
+	if(size<=0 || size>m_sliceSize) return false;
+
+	Slot& slot = m_slots[slice.slot];
+	slot.state = SS_READY;
+	slot.x = x;
+	slot.y = y;
+	slot.width = width;
+	slot.height = height;
+	slot.format = format;
+	slot.type = type;
+	m_ready.push_back(slice.slot);
+	return true;
+}
+
+
+void UploadRing::cancel(const UploadSlice& slice)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(slice.slot>=m_slots.size() || m_slots[slice.slot].state!=SS_WRITING) return;
+
+		m_slots[slice.slot].state = SS_FREE;
+		m_free.push_back(slice.slot);
+	}
+	m_freed.notify_one();
+}
+
+
+unsigned UploadRing::submit(GLuint texture, GLenum target, GLint level, GLint layer)
+{
+	retire();
+
+	// committed slices are not touched by the producers any more, the
+	// updates are issued without holding the lock
+	std::deque<unsigned> ready;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		ready.swap(m_ready);
+	}
+	if(ready.empty()) return 0;
+
+	// rows are tightly packed
+	GLint alignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	// with an unpack buffer bound the pointer is an offset, the copy into
+	// the texture runs on the GPU
+	if(m_pbo) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo);
+	for(std::deque<unsigned>::const_iterator it = ready.begin(); it != ready.end(); ++it)
+	{
+		Slot& slot = m_slots[*it];
+		GLsizeiptr offset = m_sliceSize * *it;
+		upload(slot, m_pbo ? (const void*)offset : (const void*)(m_mapped + offset), texture, target, level, layer);
+		if(m_pbo) slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	if(m_pbo) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+	// client memory has been copied by the driver already
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for(std::deque<unsigned>::const_iterator it = ready.begin(); it != ready.end(); ++it)
+		{
+			if(m_pbo)
+			{
+				m_slots[*it].state = SS_PENDING;
+				++m_numPending;
+			}
+			else
+			{
+				m_slots[*it].state = SS_FREE;
+				m_free.push_back(*it);
+			}
+		}
+	}
+	if(!m_pbo) m_freed.notify_all();
+
+	return ready.size();
+}
+
+
+void UploadRing::retire()
+{
+	// the producers change slot states under the lock, only the pending
+	// slots and their fences are taken from it
+	std::vector<unsigned> pending;
+	std::vector<GLsync> fences;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(m_numPending==0) return;
+
+		for(unsigned i=0; i<m_slots.size(); ++i)
+		{
+			if(m_slots[i].state!=SS_PENDING) continue;
+			pending.push_back(i);
+			fences.push_back(m_slots[i].fence);
+		}
+	}
+
+	// poll the fences, the flush bit makes sure they eventually signal
+	std::vector<unsigned> retired;
+	for(unsigned i=0; i<pending.size(); ++i)
+	{
+		GLenum result = glClientWaitSync(fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if(result==GL_TIMEOUT_EXPIRED || result==GL_WAIT_FAILED) continue;
+
+		glDeleteSync(fences[i]);
+		retired.push_back(pending[i]);
+	}
+	if(retired.empty()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for(std::vector<unsigned>::const_iterator it = retired.begin(); it != retired.end(); ++it)
+		{
+			m_slots[*it].fence = 0;
+			m_slots[*it].state = SS_FREE;
+			m_free.push_back(*it);
+		}
+		m_numPending -= retired.size();
+	}
+	m_freed.notify_all();
+}
+
+
+unsigned UploadRing::getDepth()const
+{
+	return m_slots.size();
+}
+
+
+GLsizeiptr UploadRing::getSliceSize()const
+{
+	return m_sliceSize;
+}
+
+
+unsigned UploadRing::getNumReady()const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_ready.size();
+}
+
+
+unsigned UploadRing::getNumPending()const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numPending;
+}
+
+
+bool UploadRing::isPersistent()const
+{
+	return m_pbo!=0;
+}
+
+
+bool UploadRing::isSupported()
+{
+	return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+
+void UploadRing::upload(const Slot& slot, const void* pixels, GLuint texture, GLenum target, GLint level, GLint layer)
+{
+	if(FrameBufferObject::isDirectStateAccessEnabled())
+	{
+		// cube faces are layers of the named texture
+		if(target==GL_TEXTURE_2D)
+			glTextureSubImage2D(texture, level, slot.x, slot.y, slot.width, slot.height, slot.format, slot.type, pixels);
+		else
+			glTextureSubImage3D(texture, level, slot.x, slot.y, layer, slot.width, slot.height, 1, slot.format, slot.type, pixels);
+		return;
+	}
+
+	BindingCache::current().bindTexture(target, texture);
+	switch(target)
+	{
+		case GL_TEXTURE_2D:
+			glTexSubImage2D(GL_TEXTURE_2D, level, slot.x, slot.y, slot.width, slot.height, slot.format, slot.type, pixels);
+			break;
+		case GL_TEXTURE_CUBE_MAP:
+			glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + layer, level, slot.x, slot.y, slot.width, slot.height, slot.format, slot.type, pixels);
+			break;
+		default:
+			glTexSubImage3D(target, level, slot.x, slot.y, layer, slot.width, slot.height, 1, slot.format, slot.type, pixels);
+			break;
+	}
+}
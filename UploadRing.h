@@ -0,0 +1,99 @@
+// =================================================================
+//   File      : UploadRing.h
+//   Desc	   : N-deep ring of slices in one pixel unpack buffer that
+//				 is mapped persistently and coherently, so producer
+//				 threads write CPU pixels straight into GL memory and
+//				 the rendering thread only issues the texture update.
+//				 Every update is guarded by a fence and its slice is
+//				 handed out again once the GPU has consumed it.
+//   Version   : 1.0
+//   Author    : Berk Atabek - Copyright 2012
+//
+//==================================================================
+
+#ifndef UPLOADRING_H
+#define UPLOADRING_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <GL/glew.h>
+
+// slice handed to a producer
+struct UploadSlice {
+	void* data; // write the pixels here, rows bottom up and tightly packed
+	GLsizeiptr capacity; // bytes of the slice
+	unsigned slot;
+};
+
+
+class UploadRing
+{
+public:
+
+	 // Constructor/Destructor
+	 UploadRing(unsigned depth, GLsizeiptr sliceSize);
+	~UploadRing();
+
+	// Producer side, any thread, no GL context needed
+	// acquire() returns false if every slice is in use, unless wait is
+	// set in which case it blocks until the rendering thread frees one.
+	// A committed slice is uploaded by the next submit() in commit order.
+	bool acquire(UploadSlice& slice, bool wait=false);
+	bool commit(const UploadSlice& slice, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type);
+	void cancel(const UploadSlice& slice);
+
+	// Rendering thread
+	// uploads every committed slice into the level of the texture, layer
+	// is the face of a cube map or the slice of an array or 3D texture
+	// and ignored for GL_TEXTURE_2D. returns the number of updates.
+	unsigned submit(GLuint texture, GLenum target, GLint level, GLint layer);
+	// frees the slices the GPU has finished reading, never blocks
+	void retire();
+
+	// Accessors
+	unsigned	getDepth()const;
+	GLsizeiptr	getSliceSize()const;
+	unsigned	getNumReady()const;
+	unsigned	getNumPending()const;
+	bool		isPersistent()const; // false: client memory, the driver copies on submit()
+	static bool	isSupported();
+
+private:
+
+	UploadRing(const UploadRing&);
+	UploadRing& operator=(const UploadRing&);
+
+	enum SLOT_STATE {SS_FREE=0, SS_WRITING, SS_READY, SS_PENDING};
+
+	// one slice of the ring and the update written into it
+	struct Slot {
+		GLsync fence;
+		SLOT_STATE state;
+		GLint x;
+		GLint y;
+		GLsizei width;
+		GLsizei height;
+		GLenum format;
+		GLenum type;
+	};
+
+	void upload(const Slot& slot, const void* pixels, GLuint texture, GLenum target, GLint level, GLint layer);
+
+	std::vector<Slot>		m_slots;
+	std::vector<unsigned>	m_free;
+	std::deque<unsigned>	m_ready; // in commit order
+	unsigned				m_numPending;
+	GLsizeiptr				m_sliceSize; // rounded up so every slice starts aligned
+
+	GLuint					m_pbo; // 0 without buffer storage
+	unsigned char*			m_mapped; // the whole ring, mapped once
+	std::vector<unsigned char>	m_clientMemory; // stands in for the pbo
+
+	mutable std::mutex		m_mutex;
+	std::condition_variable	m_freed;
+
+};
+
+#endif